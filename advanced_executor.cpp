@@ -258,11 +258,34 @@ ExecutionResult AdvancedExecutor::executeWithPlan(const TaskPlan &plan)
     overall_result.error_message = "";
     overall_result.execution_time = 0.0;
 
-    for (const auto &task : plan.tasks)
+    for (const auto &planned_task : plan.tasks)
     {
+        // Generated content for this task may still be in flight; wait for it only now,
+        // so later generations overlap the execution of earlier tasks
+        Task task = planned_task;
+        TaskPlanner::resolveGeneratedContent(task);
+        if (task.status == TaskStatus::FAILED)
+        {
+            overall_result.success = false;
+            overall_result.error_message += "Task '" + task.description + "' failed: " + task.error_message + "; ";
+            continue;
+        }
+
         json task_data = {
             {"type", "powershell_script"},
             {"script", task.commands}};
+        if (task.metadata.value("task_type_for_executor", "") == "vision_task" && !task.commands.empty())
+        {
+            json vision_step = json::parse(task.commands[0], nullptr, false);
+            std::string objective = vision_step.is_object() ? vision_step.value("objective", task.description) : task.description;
+            if (vision_step.is_object() && vision_step.contains("text_to_type"))
+            {
+                objective += "\nText to type: " + vision_step["text_to_type"].get<std::string>();
+            }
+            task_data = {
+                {"type", "vision_task"},
+                {"task", objective}};
+        }
 
         ExecutionResult task_result = execute(task_data);
         overall_result.execution_time += task_result.execution_time;
@@ -369,7 +392,7 @@ ExecutionResult AdvancedExecutor::callExternalAPI(const std::string &api_name, c
 }
 
 // TODO: Unit Test: Add tests for executeVisionTask, mocking VisionGuidedExecutor and verifying correct parameter passing and result handling.
-ExecutionResult AdvancedExecutor::executeVisionTask(const json &task_data)
+ExecutionResult AdvancedExecutor::executeVisionTask(const json &task_data, std::shared_ptr<ExecutionContext> context)
 {
     auto start_time = std::chrono::high_resolution_clock::now();
     ExecutionResult result;
@@ -396,6 +419,8 @@ ExecutionResult AdvancedExecutor::executeVisionTask(const json &task_data)
         if (!vision_executor && !ai_api_key.empty())
         {
             vision_executor = std::make_unique<VisionGuidedExecutor>(ai_api_key);
+            vision_executor->setContextWindowSettings(context_window_settings);
+            vision_executor->setVisionCaptureSettings(vision_capture_settings);
         }
 
         if (!vision_executor)
@@ -407,7 +432,7 @@ ExecutionResult AdvancedExecutor::executeVisionTask(const json &task_data)
 
         // Execute vision task
         std::cout << "🎯 Executing vision task: " << task << std::endl;
-        VisionTaskExecution execution = vision_executor->executeVisionTask(task);
+        VisionTaskExecution execution = vision_executor->executeVisionTask(task, context);
 
         result.success = execution.overall_success;
         result.output = execution.final_result; // Contains success or failure summary
@@ -429,6 +454,7 @@ ExecutionResult AdvancedExecutor::executeVisionTask(const json &task_data)
             {"task_type", "vision"},
             {"steps_executed", execution.steps.size()},
             {"total_time", execution.total_time},
+            {"context", execution.metadata.value("context", json::object())},
             {"step_details", json::array()}};
 
         // Add step details
@@ -437,7 +463,8 @@ ExecutionResult AdvancedExecutor::executeVisionTask(const json &task_data)
             json step_json = {
                 {"description", step.description},
                 {"success", step.success},
-                {"execution_time", step.execution_time}};
+                {"execution_time", step.execution_time},
+                {"prompt_tokens", step.prompt_tokens}};
             if (!step.error_message.empty())
             {
                 step_json["error"] = step.error_message;
@@ -475,6 +502,8 @@ ExecutionResult AdvancedExecutor::executeUIAutomation(const json &automation_dat
         if (!vision_executor && !ai_api_key.empty())
         {
             vision_executor = std::make_unique<VisionGuidedExecutor>(ai_api_key);
+            vision_executor->setContextWindowSettings(context_window_settings);
+            vision_executor->setVisionCaptureSettings(vision_capture_settings);
         }
 
         if (!vision_executor)
@@ -583,13 +612,13 @@ bool AdvancedExecutor::isVisionTaskSafe(const std::string &task)
     return safety_rules.value("allow_vision_tasks", true);
 }
 
-ExecutionResult AdvancedExecutor::executeNaturalLanguageTask(const std::string &task)
+ExecutionResult AdvancedExecutor::executeNaturalLanguageTask(const std::string &task, std::shared_ptr<ExecutionContext> context)
 {
     json task_data = {
         {"task", task},
         {"type", "vision_task"}};
 
-    return executeVisionTask(task_data);
+    return executeVisionTask(task_data, context);
 }
 
 void AdvancedExecutor::setAIApiKey(const std::string &api_key)
@@ -600,6 +629,26 @@ void AdvancedExecutor::setAIApiKey(const std::string &api_key)
     if (!api_key.empty())
     {
         vision_executor = std::make_unique<VisionGuidedExecutor>(api_key);
+        vision_executor->setContextWindowSettings(context_window_settings);
+        vision_executor->setVisionCaptureSettings(vision_capture_settings);
         std::cout << "✅ Vision capabilities enabled with AI API" << std::endl;
     }
 }
+
+void AdvancedExecutor::setContextWindowSettings(const ContextWindowSettings &settings)
+{
+    context_window_settings = settings;
+    if (vision_executor)
+    {
+        vision_executor->setContextWindowSettings(settings);
+    }
+}
+
+void AdvancedExecutor::setVisionCaptureSettings(const VisionCaptureSettings &settings)
+{
+    vision_capture_settings = settings;
+    if (vision_executor)
+    {
+        vision_executor->setVisionCaptureSettings(settings);
+    }
+}
@@ -34,13 +34,15 @@ private:
     std::vector<std::string> dangerous_commands;
     std::unique_ptr<VisionGuidedExecutor> vision_executor;
     std::string ai_api_key;
+    ContextWindowSettings context_window_settings;
+    VisionCaptureSettings vision_capture_settings;
       bool isCommandSafe(const std::string& command);
     bool requiresConfirmation(const std::string& command);
     ExecutionResult executeWindowsCommand(const std::string& command);
     ExecutionResult executePowerShellScript(const std::vector<std::string>& commands);
     
     // Vision-related execution methods
-    ExecutionResult executeVisionTask(const json& task_data);
+    ExecutionResult executeVisionTask(const json& task_data, std::shared_ptr<ExecutionContext> context = nullptr);
     ExecutionResult executeUIAutomation(const json& automation_data);
     bool isVisionTaskSafe(const std::string& task);
     
@@ -78,8 +80,11 @@ public:
     ExecutionResult callExternalAPI(const std::string& api_name, const json& parameters);
     
     // Vision task execution
-    ExecutionResult executeNaturalLanguageTask(const std::string& task);
+    // context carries facts already computed for this request (intent, screen) into the vision executor
+    ExecutionResult executeNaturalLanguageTask(const std::string& task, std::shared_ptr<ExecutionContext> context = nullptr);
     void setAIApiKey(const std::string& api_key);
+    void setContextWindowSettings(const ContextWindowSettings& settings);
+    void setVisionCaptureSettings(const VisionCaptureSettings& settings);
 };
 
 #endif // ADVANCED_EXECUTOR_H
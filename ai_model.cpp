@@ -1,77 +1,199 @@
 #include "ai_model.h"
+#include "llm_client.h"
+#include "llm_backend.h"
+#include "llm_response.h"
+#include "llm_schema.h"
+#include "llm_metrics.h"
 #include <iostream>
 #include <string>
 #include <memory>
-#include <curl/curl.h>
+#include <mutex>
+#include <condition_variable>
 
-// Callback function to write response data
-size_t WriteCallback(void *contents, size_t size, size_t nmemb, std::string *output)
+namespace
 {
-    size_t total_size = size * nmemb;
-    output->append((char *)contents, total_size);
-    return total_size;
-}
+    const char *kChatCompletionsUrl = "https://openrouter.ai/api/v1/chat/completions";
 
-// TODO: Unit Test: Add unit tests for extractJsonFromString with various valid and invalid JSON strings (direct parse, markdown, malformed, empty).
-// Helper function to extract JSON from a string
-json extractJsonFromString(const std::string &text_response)
-{
-    try
+    // Built for OpenRouter, then pointed at a local backend if the call type is routed to one
+    LLMRequest makeChatRequest(LLMCallType call_type, const std::string &api_key, json request_body)
+    {
+        LLMRequest request;
+        request.url = kChatCompletionsUrl;
+        request.api_key = api_key;
+        request.call_type = call_type;
+        LLMBackendRouter::instance().apply(request_body, request);
+        request.body = request_body.dump();
+        return request;
+    }
+
+    // Common first stage of every parser: transport errors, unparseable bodies and
+    // provider error objects are logged once here, and reasoning is dropped when
+    // the call type's profile strips it. True when content is present.
+    bool readCompletion(const LLMResponse &llm_response, LLMCallType call_type, const char *what, CompletionResult &completion)
+    {
+        if (!llm_response.transport_ok)
+        {
+            std::cerr << what << " request failed: " << llm_response.error << std::endl;
+            return false;
+        }
+        if (!parseCompletion(llm_response.body, completion))
+        {
+            std::cerr << "Failed to parse the " << what << " API response (HTTP " << llm_response.http_status << ", "
+                      << llm_response.body.size() << " bytes)" << std::endl;
+            return false;
+        }
+        if (!completion.has_content)
+        {
+            std::cerr << "Unexpected response format from " << what << " API (HTTP " << llm_response.http_status << ")";
+            if (!completion.error_message.empty())
+            {
+                std::cerr << ": " << completion.error_message;
+            }
+            std::cerr << std::endl;
+            return false;
+        }
+        if (LLMBackendRouter::instance().profileFor(call_type).strip_reasoning)
+        {
+            stripReasoningBlocks(completion.content);
+            completion.reasoning.clear();
+        }
+        return true;
+    }
+
+    // response_format schemas. Planning stays non-strict because its shape depends on "type".
+    const JsonSchema &planSchema()
     {
-        // Attempt direct parsing
-        return json::parse(text_response);
+        static const JsonSchema schema("agent_plan", json::parse(R"({
+            "type": "object",
+            "properties": {
+                "type": {"type": "string", "enum": ["powershell_script", "vision_task", "generate_content_and_execute", "multi_step_plan", "text"]},
+                "script": {"type": "array", "items": {"type": "string"}},
+                "initial_action": {"type": ["string", "null"]},
+                "target_app": {"type": ["string", "null"]},
+                "objective": {"type": "string"},
+                "content_generation_prompt": {"type": "string"},
+                "subsequent_action": {"type": "object"},
+                "steps": {"type": "array", "items": {"type": "object"}},
+                "content": {"type": "string"},
+                "explanation": {"type": "string"},
+                "confidence": {"type": "number"}
+            },
+            "required": ["type"]
+        })"), false);
+        return schema;
     }
-    catch (const json::parse_error &e)
+
+    const JsonSchema &visionActionSchema()
+    {
+        static const JsonSchema schema("vision_action", json::parse(R"({
+            "type": "object",
+            "properties": {
+                "action_type": {"type": "string", "enum": ["click", "type", "scroll", "wait", "complete"]},
+                "target_description": {"type": "string"},
+                "value": {"type": "string"},
+                "explanation": {"type": "string"},
+                "confidence": {"type": "number"}
+            },
+            "required": ["action_type", "target_description", "value", "explanation", "confidence"],
+            "additionalProperties": false
+        })"), true);
+        return schema;
+    }
+
+    const JsonSchema &intentSchema()
     {
-        // Log the direct parsing error
-        std::cerr << "Direct JSON parsing failed: " << e.what() << std::endl;
-        std::cerr << "Raw response for direct parsing failure: " << text_response << std::endl;
+        static const JsonSchema schema("intent_analysis", json::parse(R"({
+            "type": "object",
+            "properties": {
+                "is_vision_task": {"type": "boolean"},
+                "requires_app_launch": {"type": "boolean"},
+                "target_application": {"type": ["string", "null"]},
+                "app_name": {"type": ["string", "null"]},
+                "requires_typing": {"type": "boolean"},
+                "text_to_type": {"type": ["string", "null"]},
+                "requires_interaction": {"type": "boolean"},
+                "interaction_target": {"type": ["string", "null"]},
+                "requires_navigation": {"type": "boolean"},
+                "navigation_target": {"type": ["string", "null"]},
+                "task_type": {"type": "string", "enum": ["web", "messaging", "file", "system", "text", "calculation", "other"]},
+                "confidence": {"type": "number"}
+            },
+            "required": ["is_vision_task", "requires_app_launch", "target_application", "app_name", "requires_typing", "text_to_type",
+                         "requires_interaction", "interaction_target", "requires_navigation", "navigation_target", "task_type", "confidence"],
+            "additionalProperties": false
+        })"), true);
+        return schema;
+    }
 
-        // If direct parsing fails, try to extract JSON from markdown code blocks
-        size_t json_start = text_response.find("```json");
-        if (json_start != std::string::npos)
+    // The whole content when the backend honoured response_format, otherwise the
+    // first embedded JSON span that matches the schema. Validated while parsing.
+    bool extractStructured(const std::string &text, const JsonSchema &schema, LLMCallType call_type, json &out)
+    {
+        std::string error;
+        bool repaired = false;
+        if (extractEmbeddedJson(text, out, [&schema, &error](const char *begin, const char *end, json &parsed)
+                                { return schema.parse(begin, end, parsed, error); },
+                                &repaired))
         {
-            json_start += 7; // Skip "```json"
-            size_t json_end = text_response.find("```", json_start);
-            if (json_end != std::string::npos)
+            if (repaired)
             {
-                std::string json_content = text_response.substr(json_start, json_end - json_start);
-                // Trim whitespace
-                json_content.erase(0, json_content.find_first_not_of(" \t\n\r"));
-                json_content.erase(json_content.find_last_not_of(" \t\n\r") + 1);
-                try
-                {
-                    return json::parse(json_content);
-                }
-                catch (const json::parse_error &e_markdown)
-                {
-                    // Log the markdown parsing error
-                    std::cerr << "Markdown JSON parsing failed: " << e_markdown.what() << std::endl;
-                    std::cerr << "Raw content from markdown for parsing failure: " << json_content << std::endl;
-                }
+                std::cout << "🩹 Repaired malformed " << llmCallTypeName(call_type) << " JSON from the model" << std::endl;
+                LLMMetrics::instance().recordJsonRepair(call_type);
             }
+            return true;
         }
+        if (!error.empty())
+        {
+            std::cerr << "Model output does not match its schema: " << error << std::endl;
+        }
+        return false;
     }
-    // If all attempts fail, log and return an empty json object
-    std::cerr << "Failed to extract JSON from response: " << text_response << std::endl;
-    return json::object();
-}
 
-// TODO: Unit Test: Add integration tests for these functions, mocking curl calls and verifying prompt construction and response parsing.
-json callAIModel(const std::string &api_key, const std::string &user_prompt)
-{
-    CURL *curl;
-    CURLcode res;
-    std::string response_data;
+    // Submits the request right away but defers parsing to whoever calls get(),
+    // so parsing never runs on the client's event thread and no thread is spawned.
+    template <typename Result, typename Parser>
+    std::future<Result> submitChatRequest(LLMRequest request, Parser parser)
+    {
+        std::future<LLMResponse> pending = LLMBackendRouter::instance().submit(std::move(request));
+        return std::async(std::launch::deferred,
+                          [pending = std::move(pending), parser]() mutable
+                          { return parser(pending.get()); });
+    }
+} // namespace
 
-    // Initialize curl
-    curl = curl_easy_init();
-    if (!curl)
+static json parseAIModelResponse(const LLMResponse &llm_response)
+{
+    CompletionResult completion;
+    if (!readCompletion(llm_response, LLMCallType::PLANNING, "AI model", completion))
     {
-        std::cerr << "Failed to initialize curl" << std::endl;
         return json::object();
-    } // Create the request URL for OpenRouter DeepSeek API
-    std::string url = "https://openrouter.ai/api/v1/chat/completions";
+    }
+    const std::string &deepseek_text = completion.content;
+
+    // The schema guarantees a known "type"
+    json parsed_json;
+    if (extractStructured(deepseek_text, planSchema(), LLMCallType::PLANNING, parsed_json))
+    {
+        if (parsed_json["type"] != "text")
+        {
+            return parsed_json; // These are valid structured responses
+        }
+        if (parsed_json.contains("content"))
+        {
+            return json{{"type", "text"}, {"content", parsed_json["content"]}};
+        }
+    }
+    else
+    {
+        LLMMetrics::instance().recordParseFailure(LLMCallType::PLANNING);
+    }
+    // Fallback: plain text, or JSON that is not a valid plan
+    return json{{"type", "text"}, {"content", deepseek_text}};
+}
+
+// TODO: Unit Test: Add integration tests for these functions, mocking curl calls and verifying prompt construction and response parsing.
+std::future<json> callAIModelAsync(const std::string &api_key, const std::string &user_prompt)
+{
     // TODO: Reinforce in the prompt that if the AI decides on a structured command,
     // the JSON output should be the ONLY content in its response and must be valid JSON.
     // For example, add: "If returning JSON, ensure it is the sole content of your response and strictly adheres to the defined schema."
@@ -127,110 +249,56 @@ json callAIModel(const std::string &api_key, const std::string &user_prompt)
                                   "- For `vision_task`, be precise about the `objective`.\n"
                                   "- For `generate_content_and_execute`, the `content_generation_prompt` should be specific for an LLM, and `subsequent_action` must be a valid action type.\n"
                                   "- For `multi_step_plan`, each item in `steps` must be a complete and valid JSON action definition.\n"
-                                  "- Never hardcode user-specific paths. Use general methods.\n\n"
+                                  "- Never hardcode user-specific paths. Use general methods.\n"
+                                  "- If the request needs no action, reply with {\"type\": \"text\", \"content\": \"your answer\"}.\n\n"
                                   "User task: " +
                                   user_prompt;
     json request_body = {
         {"model", "deepseek/deepseek-r1-0528-qwen3-8b:free"}, // Consider updating model if needed for complex planning
-        {"messages", {{{"role", "user"}, {"content", enhanced_prompt}}}}};
-
-    std::string json_string = request_body.dump();
-
-    // Set curl options
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_string.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_data);
-    // Set headers
-    struct curl_slist *headers = nullptr;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    std::string auth_header = "Authorization: Bearer " + api_key;
-    headers = curl_slist_append(headers, auth_header.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-    // Perform the request
-    res = curl_easy_perform(curl);
-
-    // Cleanup
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
-
-    if (res != CURLE_OK)
-    {
-        std::cerr << "curl_easy_perform() failed: " << curl_easy_strerror(res) << std::endl;
-        return json::object();
-    }
+        {"messages", {{{"role", "user"}, {"content", enhanced_prompt}}}},
+        {"response_format", planSchema().responseFormat()}};
+
+    return submitChatRequest<json>(makeChatRequest(LLMCallType::PLANNING, api_key, request_body), parseAIModelResponse);
+}
+
+json callAIModel(const std::string &api_key, const std::string &user_prompt)
+{
+    return callAIModelAsync(api_key, user_prompt).get();
+}
 
-    // Parse the response
-    try
+static json parseVisionAIModelResponse(const LLMResponse &llm_response)
+{
+    CompletionResult completion;
+    if (readCompletion(llm_response, LLMCallType::VISION_STEP, "Vision AI", completion))
     {
-        json response = json::parse(response_data);
-        // Extract the text from OpenRouter/DeepSeek response structure
-        if (response.contains("choices") && !response["choices"].empty())
+        // DeepSeek R1 may put the action in content or leave it in its reasoning; try content first
+        json extracted_json;
+        if (extractStructured(completion.content, visionActionSchema(), LLMCallType::VISION_STEP, extracted_json) ||
+            (!completion.reasoning.empty() && extractStructured(completion.reasoning, visionActionSchema(), LLMCallType::VISION_STEP, extracted_json)))
         {
-            auto &choice = response["choices"][0];
-            if (choice.contains("message") && choice["message"].contains("content"))
-            {
-                std::string deepseek_text = choice["message"]["content"];
-                json parsed_json = extractJsonFromString(deepseek_text);
-
-                if (!parsed_json.empty() && parsed_json.contains("type"))
-                {
-                    std::string response_main_type = parsed_json["type"].get<std::string>();
-                    if (response_main_type == "powershell_script" ||
-                        response_main_type == "vision_task" ||
-                        response_main_type == "generate_content_and_execute" ||
-                        response_main_type == "multi_step_plan")
-                    {
-                        return parsed_json; // These are valid structured responses
-                    }
-                    // If type is something else, but it's still valid JSON, it might be an error or unexpected.
-                    std::cerr << "callAIModel: Received valid JSON but with an unrecognized primary type: "
-                              << response_main_type << ". Response: " << parsed_json.dump(2) << std::endl;
-                }
-                else if (parsed_json.empty())
-                {
-                    std::cerr << "callAIModel: extractJsonFromString returned empty JSON. Original text: " << deepseek_text << std::endl;
-                }
-                else
-                { // Not empty, but no "type" field
-                    std::cerr << "callAIModel: Parsed JSON is missing 'type' field. Original text: " << deepseek_text
-                              << ". Parsed JSON: " << parsed_json.dump(2) << std::endl;
-                }
-                // Fallback: if not a recognized structured type, if "type" is missing, or if JSON parsing failed (parsed_json is empty)
-                return json{{"type", "text"}, {"content", deepseek_text}};
-            }
+            // The AI is expected to return ONLY the JSON object for the action.
+            return extracted_json;
         }
-        std::cerr << "Unexpected response format from AI API (missing choices or content field)" << std::endl;
-        std::cerr << "Full API response: " << response.dump(2) << std::endl;
-        return json::object(); // Return empty JSON if the expected structure (choices[0].message.content) is not there
-    }
-    catch (const json::parse_error &e) // This catch block is for the initial parsing of the *entire* API response
-    {
-        std::cerr << "Failed to parse the main AI API response JSON: " << e.what() << std::endl;
-        std::cerr << "Raw API response data: " << response_data << std::endl;
-        return json::object(); // Return empty JSON on parsing failure
+        std::cerr << "JSON extraction in callVisionAIModel failed or result did not match the action schema." << std::endl;
+        LLMMetrics::instance().recordParseFailure(LLMCallType::VISION_STEP);
     }
+
+    // If the call failed, content is missing, or extracted JSON is not valid, generate a fallback JSON
+    std::cout << "⚠️  JSON processing failed in callVisionAIModel, generating fallback action..." << std::endl;
+    json fallback_action = {
+        {"action_type", "wait"},
+        {"target_description", "interface"},
+        {"value", "2000"},
+        {"explanation", "Fallback action - JSON processing failed"},
+        {"confidence", 0.2}};
+    // This function, unlike callAIModel, is expected to return the action JSON directly, not wrapped.
+    return fallback_action;
 }
 
 // TODO: Unit Test: Add integration tests for these functions, mocking curl calls and verifying prompt construction and response parsing.
 // Vision-specific AI model call that returns vision action JSON
-json callVisionAIModel(const std::string &api_key, const std::string &vision_prompt)
+std::future<json> callVisionAIModelAsync(const std::string &api_key, const std::string &vision_prompt)
 {
-    CURL *curl;
-    CURLcode res;
-    std::string response_data;
-
-    // Initialize curl
-    curl = curl_easy_init();
-    if (!curl)
-    {
-        std::cerr << "Failed to initialize curl for vision AI call" << std::endl;
-        return json::object();
-    }
-
-    // Create the request URL for OpenRouter DeepSeek API
-    std::string url = "https://openrouter.ai/api/v1/chat/completions";
     // TODO: The prompt already asks for "ONLY a JSON object" and "Always end with valid JSON".
     // Review if this can be made stricter or if alternative phrasings could improve LLM adherence.
     // For example, "Your entire response must be a single, valid JSON object, with no surrounding text or explanations."
@@ -238,7 +306,7 @@ json callVisionAIModel(const std::string &api_key, const std::string &vision_pro
                                        "CRITICAL: Always end with valid JSON. Use this exact format:\n"
                                        "{\n"
                                        "  \"action_type\": \"click|type|scroll|wait|complete\",\n"
-                                       "  \"target_description\": \"element to interact with\",\n"
+                                       "  \"target_description\": \"id of the element to interact with (e.g. e3), or a description if it is not listed\",\n"
                                        "  \"value\": \"text to type or scroll direction\",\n"
                                        "  \"explanation\": \"brief action description\",\n"
                                        "  \"confidence\": 0.8\n"
@@ -249,125 +317,37 @@ json callVisionAIModel(const std::string &api_key, const std::string &vision_pro
         {"model", "deepseek/deepseek-r1-0528-qwen3-8b:free"},
         {"messages", {{{"role", "system"}, {"content", vision_system_prompt}}, {{"role", "user"}, {"content", vision_prompt}}}},
         {"temperature", 0.0}, // Zero temperature for maximum consistency
-        {"max_tokens", 2500}  // Higher token limit to avoid cutoff
-    };
-
-    std::string json_string = request_body.dump();
-
-    // Set curl options
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_string.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_data);
+        {"max_tokens", 2500}, // Higher token limit to avoid cutoff
+        {"response_format", visionActionSchema().responseFormat()}};
 
-    // Set headers
-    struct curl_slist *headers = nullptr;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    std::string auth_header = "Authorization: Bearer " + api_key;
-    headers = curl_slist_append(headers, auth_header.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-    // Perform the request
-    res = curl_easy_perform(curl);
+    return submitChatRequest<json>(makeChatRequest(LLMCallType::VISION_STEP, api_key, request_body), parseVisionAIModelResponse);
+}
 
-    // Cleanup
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+json callVisionAIModel(const std::string &api_key, const std::string &vision_prompt)
+{
+    return callVisionAIModelAsync(api_key, vision_prompt).get();
+}
 
-    if (res != CURLE_OK)
-    {
-        std::cerr << "curl_easy_perform() failed for vision AI: " << curl_easy_strerror(res) << std::endl;
-        return json::object();
-    } // Parse the response - handle DeepSeek R1's reasoning format
-    try
+static json parseIntentAIResponse(const LLMResponse &llm_response)
+{
+    CompletionResult completion;
+    json extracted_json;
+    if (!readCompletion(llm_response, LLMCallType::INTENT, "Intent analysis", completion))
     {
-        json response = json::parse(response_data);
-
-        // Enhanced parsing for DeepSeek R1 format
-        if (response.contains("choices") && !response["choices"].empty())
-        {
-            auto &choice = response["choices"][0];
-            if (choice.contains("message"))
-            {
-                auto &message = choice["message"];
-                std::string full_text = "";
-
-                // DeepSeek R1 format: check both reasoning and content fields
-                if (message.contains("reasoning") && !message["reasoning"].get<std::string>().empty())
-                {
-                    full_text = message["reasoning"].get<std::string>();
-                }
-
-                if (message.contains("content") && !message["content"].get<std::string>().empty())
-                {
-                    if (!full_text.empty())
-                        full_text += "\n\n";
-                    full_text += message["content"].get<std::string>();
-                }
-
-                // If we have text, try to extract JSON from it
-                if (!full_text.empty())
-                {
-                    json extracted_json = extractJsonFromString(full_text);
-                    // Check if the extracted JSON is valid and contains the expected structure
-                    if (!extracted_json.empty() && extracted_json.contains("action_type"))
-                    {
-                        // The AI is expected to return ONLY the JSON object for the action.
-                        // So, we return the extracted_json directly.
-                        return extracted_json;
-                    }
-                    // Log if full_text was present but JSON extraction failed or was invalid
-                    std::cerr << "JSON extraction from full_text in callVisionAIModel failed or result was invalid." << std::endl;
-                    // extractJsonFromString already logs the full_text if parsing fails.
-                }
-            }
-        }
-
-        // If parsing fails, content is missing, or extracted JSON is not valid, generate a fallback JSON
-        std::cout << "⚠️  JSON processing failed in callVisionAIModel, generating fallback action..." << std::endl;
-        // The raw full_text (if available and parsing attempted) would have been logged by extractJsonFromString.
-
-        json fallback_action = {
-            {"action_type", "wait"},
-            {"target_description", "interface"},
-            {"value", "2000"},
-            {"explanation", "Fallback action - JSON processing failed"},
-            {"confidence", 0.2}};
-        // This function, unlike callAIModel, is expected to return the action JSON directly, not wrapped.
-        return fallback_action;
+        return json::object(); // Callers treat an empty object as "fall back to keywords"
     }
-    catch (const std::exception &e) // This catch block is for the initial parsing of the whole API response
+    if (extractStructured(completion.content, intentSchema(), LLMCallType::INTENT, extracted_json))
     {
-        std::cerr << "Failed to parse the main vision API response: " << e.what() << std::endl;
-        std::cerr << "Raw vision API response: " << response_data << std::endl;
-        // Return a fallback action in case of major API response parsing failure
-        json fallback_action = {
-            {"action_type", "wait"},
-            {"target_description", "interface"},
-            {"value", "2000"},
-            {"explanation", "Fallback action - Main API response parsing failed"},
-            {"confidence", 0.1}};
-        return fallback_action;
+        return extracted_json;
     }
+    LLMMetrics::instance().recordParseFailure(LLMCallType::INTENT);
+    return json::object();
 }
 
 // TODO: Unit Test: Add integration tests for these functions, mocking curl calls and verifying prompt construction and response parsing.
 // Dynamic Intent Analysis Functions - Replace Hardcoded Logic with AI
-json callIntentAI(const std::string &api_key, const std::string &user_request)
+std::future<json> callIntentAIAsync(const std::string &api_key, const std::string &user_request)
 {
-    CURL *curl;
-    CURLcode res;
-    std::string response_data;
-
-    curl = curl_easy_init();
-    if (!curl)
-    {
-        std::cerr << "Failed to initialize curl for intent analysis" << std::endl;
-        return json::object();
-    }
-
-    std::string url = "https://openrouter.ai/api/v1/chat/completions";
-
     // TODO: Review the effectiveness of this prompt. Consider adding a line like:
     // "Ensure the entire response is a single, valid JSON object with no additional text or explanations."
     std::string intent_prompt =
@@ -403,77 +383,39 @@ json callIntentAI(const std::string &api_key, const std::string &user_request)
 
     json request_body = {
         {"model", "deepseek/deepseek-r1-0528-qwen3-8b:free"},
-        {"messages", {{{"role", "user"}, {"content", intent_prompt}}}}};
-
-    std::string json_string = request_body.dump();
+        {"messages", {{{"role", "user"}, {"content", intent_prompt}}}},
+        {"response_format", intentSchema().responseFormat()}};
 
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_string.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_data);
-
-    struct curl_slist *headers = nullptr;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    std::string auth_header = "Authorization: Bearer " + api_key;
-    headers = curl_slist_append(headers, auth_header.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-    res = curl_easy_perform(curl);
+    return submitChatRequest<json>(makeChatRequest(LLMCallType::INTENT, api_key, request_body), parseIntentAIResponse);
+}
 
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+json callIntentAI(const std::string &api_key, const std::string &user_request)
+{
+    return callIntentAIAsync(api_key, user_request).get();
+}
 
-    if (res != CURLE_OK)
+static std::string parseLLMForTextGenerationResponse(const LLMResponse &llm_response)
+{
+    if (!llm_response.transport_ok)
     {
-        std::cerr << "Intent analysis API call failed: " << curl_easy_strerror(res) << std::endl;
-        return json::object();
+        std::cerr << "Text generation request failed: " << llm_response.error << std::endl;
+        return "Error: LLM call failed (" + llm_response.error + ")";
     }
-
-    try
+    CompletionResult completion;
+    if (!readCompletion(llm_response, LLMCallType::CONTENT_GENERATION, "Text generation", completion))
     {
-        json response = json::parse(response_data);
-        if (response.contains("choices") && !response["choices"].empty())
-        {
-            auto &choice = response["choices"][0];
-            if (choice.contains("message") && choice["message"].contains("content"))
-            {
-                std::string content = choice["message"]["content"];
-                json extracted_json = extractJsonFromString(content);
-                // If extraction fails, extractJsonFromString logs and returns empty json::object(),
-                // which is the desired behavior for callIntentAI on failure.
-                // If content was present but parsing failed, extractJsonFromString already logged it.
-                return extracted_json;
-            }
-        }
-        std::cerr << "Unexpected response format from Intent AI API" << std::endl;
-        // Log the raw response if the structure is unexpected.
-        std::cerr << "Full Intent AI response: " << response.dump(2) << std::endl;
+        return "Error: Could not extract content from LLM response.";
     }
-    catch (const std::exception &e) // This catch block is for the initial parsing of the whole API response
+    if (completion.finish_reason == "length")
     {
-        std::cerr << "Failed to parse the main Intent API response: " << e.what() << std::endl;
-        std::cerr << "Raw Intent API response: " << response_data << std::endl;
+        std::cerr << "⚠️ Generated content was cut off at the token limit" << std::endl;
     }
-
-    return json::object(); // Default return if other paths fail
+    return completion.content;
 }
 
 // Function to get plain text responses from the LLM, suitable for content generation
-std::string callLLMForTextGeneration(const std::string &api_key, const std::string &text_generation_prompt)
+std::future<std::string> callLLMForTextGenerationAsync(const std::string &api_key, const std::string &text_generation_prompt)
 {
-    CURL *curl;
-    CURLcode res;
-    std::string response_data;
-
-    curl = curl_easy_init();
-    if (!curl)
-    {
-        std::cerr << "Failed to initialize curl for text generation" << std::endl;
-        return "Error: Curl initialization failed.";
-    }
-
-    std::string url = "https://openrouter.ai/api/v1/chat/completions";
-
     // System prompt tailored for direct text generation
     std::string system_prompt_text_gen = "You are a helpful AI assistant. Please directly respond to the following request for text generation. Provide only the generated text as your response, without any additional explanations, conversational filler, or JSON formatting.";
 
@@ -484,67 +426,28 @@ std::string callLLMForTextGeneration(const std::string &api_key, const std::stri
         {"temperature", 0.7} // Adjust temperature for creativity as needed
     };
 
-    std::string json_string = request_body.dump();
-
-    struct curl_slist *headers = nullptr;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    std::string auth_header = "Authorization: Bearer " + api_key;
-    headers = curl_slist_append(headers, auth_header.c_str());
-
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_string.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_data);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-    res = curl_easy_perform(curl);
-
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
-
-    if (res != CURLE_OK)
-    {
-        std::cerr << "curl_easy_perform() failed for text generation: " << curl_easy_strerror(res) << std::endl;
-        return "Error: LLM call failed (" + std::string(curl_easy_strerror(res)) + ")";
-    }
-
-    try
-    {
-        json response_json = json::parse(response_data);
-        if (response_json.contains("choices") && !response_json["choices"].empty())
-        {
-            const auto &choice = response_json["choices"][0];
-            if (choice.contains("message") && choice["message"].contains("content"))
-            {
-                return choice["message"]["content"].get<std::string>();
-            }
-        }
-        std::cerr << "Error: Unexpected JSON structure in LLM response for text generation. Full response: " << response_json.dump(2) << std::endl;
-        return "Error: Could not extract content from LLM response.";
-    }
-    catch (const json::parse_error &e)
-    {
-        std::cerr << "Error: Failed to parse LLM response JSON for text generation: " << e.what() << std::endl;
-        std::cerr << "Raw response data: " << response_data << std::endl;
-        return "Error: Failed to parse LLM response.";
-    }
+    return submitChatRequest<std::string>(makeChatRequest(LLMCallType::CONTENT_GENERATION, api_key, request_body), parseLLMForTextGenerationResponse);
 }
 
-json callVisionAI(const std::string &api_key, const std::string &task, const std::string &screen_description, const std::vector<std::string> &available_elements)
+std::string callLLMForTextGeneration(const std::string &api_key, const std::string &text_generation_prompt)
 {
-    CURL *curl;
-    CURLcode res;
-    std::string response_data;
+    return callLLMForTextGenerationAsync(api_key, text_generation_prompt).get();
+}
 
-    curl = curl_easy_init();
-    if (!curl)
+static json parseVisionAIResponse(const LLMResponse &llm_response)
+{
+    // Unlike callVisionAIModel this returns the direct action JSON, or an empty object on failure
+    CompletionResult completion;
+    json extracted_json;
+    if (readCompletion(llm_response, LLMCallType::VISION_STEP, "Vision AI (callVisionAI)", completion) && extractEmbeddedJson(completion.content, extracted_json))
     {
-        std::cerr << "Failed to initialize curl for vision AI" << std::endl;
-        return json::object();
+        return extracted_json;
     }
+    return json::object();
+}
 
-    std::string url = "https://openrouter.ai/api/v1/chat/completions";
-
+std::future<json> callVisionAIAsync(const std::string &api_key, const std::string &task, const std::string &screen_description, const std::vector<std::string> &available_elements)
+{
     // Build elements list
     std::string elements_str = "";
     for (size_t i = 0; i < available_elements.size() && i < 20; ++i) // Limit to first 20 elements
@@ -584,57 +487,171 @@ json callVisionAI(const std::string &api_key, const std::string &task, const std
         {"model", "deepseek/deepseek-r1-0528-qwen3-8b:free"},
         {"messages", {{{"role", "user"}, {"content", vision_prompt}}}}};
 
-    std::string json_string = request_body.dump();
+    return submitChatRequest<json>(makeChatRequest(LLMCallType::VISION_STEP, api_key, request_body), parseVisionAIResponse);
+}
 
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_string.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_data);
+json callVisionAI(const std::string &api_key, const std::string &task, const std::string &screen_description, const std::vector<std::string> &available_elements)
+{
+    return callVisionAIAsync(api_key, task, screen_description, available_elements).get();
+}
 
-    struct curl_slist *headers = nullptr;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    std::string auth_header = "Authorization: Bearer " + api_key;
-    headers = curl_slist_append(headers, auth_header.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+namespace
+{
+    const size_t kChatHistoryMessages = 20; // Older turns are dropped to keep the prompt small
 
-    res = curl_easy_perform(curl);
+    const char *kChatSystemPrompt = "You are a helpful AI assistant in chatbot mode. Answer conversationally and concisely. "
+                                    "You cannot run commands or control this computer in this mode; if asked to, explain how it could be done.";
 
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+    // Handed from the client's event thread, which appends streamed bytes and
+    // finally the response, to the thread waiting in callChatAI, which parses them
+    struct ChatStream
+    {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::string bytes; // Received but not parsed yet
+        bool finished = false;
+        LLMResponse response;
+    };
+} // namespace
 
-    if (res != CURLE_OK)
+json callChatAI(const std::string &api_key, const json &conversation, const std::function<void(const std::string &)> &on_delta)
+{
+    json messages = json::array({{{"role", "system"}, {"content", kChatSystemPrompt}}});
+    size_t turns = conversation.is_array() ? conversation.size() : 0;
+    for (size_t i = turns > kChatHistoryMessages ? turns - kChatHistoryMessages : 0; i < turns; ++i)
     {
-        std::cerr << "Vision AI API call failed: " << curl_easy_strerror(res) << std::endl;
-        return json::object();
+        const json &message = conversation[i];
+        if (!message.is_object() || !message.contains("content") || !message["content"].is_string())
+        {
+            continue;
+        }
+        std::string role = message.value("role", "");
+        if (role == "user" || role == "assistant")
+        {
+            messages.push_back({{"role", role}, {"content", message["content"]}});
+        }
+    }
+
+    json request_body = {
+        {"model", "deepseek/deepseek-r1-0528-qwen3-8b:free"},
+        {"messages", messages}};
+    if (on_delta)
+    {
+        request_body["stream"] = true;
     }
+    LLMRequest request = makeChatRequest(LLMCallType::CHAT, api_key, request_body);
 
-    try
+    auto stream = std::make_shared<ChatStream>();
+    if (on_delta)
     {
-        json response = json::parse(response_data);
-        if (response.contains("choices") && !response["choices"].empty())
+        request.on_body_data = [stream](const char *data, size_t length)
         {
-            auto &choice = response["choices"][0];
-            if (choice.contains("message") && choice["message"].contains("content"))
+            std::lock_guard<std::mutex> lock(stream->mutex);
+            stream->bytes.append(data, length);
+            stream->changed.notify_one();
+        };
+    }
+    LLMBackendRouter::instance().clientFor(LLMCallType::CHAT).submit(std::move(request), [stream](LLMResponse response)
+                                                                     {
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        stream->response = std::move(response);
+        stream->finished = true;
+        stream->changed.notify_one(); });
+
+    bool strip_reasoning = LLMBackendRouter::instance().profileFor(LLMCallType::CHAT).strip_reasoning;
+    ChatStreamParser parser;
+    std::string shown; // Reply text already passed to on_delta
+    auto forward = [&](const std::string &delta, const std::string &reply)
+    {
+        if (!on_delta)
+        {
+            return;
+        }
+        if (!strip_reasoning)
+        {
+            if (!delta.empty())
             {
-                std::string content = choice["message"]["content"];
-
-                // This function `callVisionAI` seems to have a different JSON structure expectation
-                // than `callVisionAIModel`. It expects the direct action JSON.
-                json extracted_json = extractJsonFromString(content);
-                // If extraction fails, extractJsonFromString logs and returns empty json::object()
-                // If content was present but parsing failed, extractJsonFromString already logged it.
-                return extracted_json; // Return the parsed JSON or an empty object on failure
+                on_delta(delta);
             }
+            return;
+        }
+        // Send only what is left once <think> blocks are gone; a reply that may
+        // still turn out to open with <think> is held back until it can't
+        std::string visible = reply;
+        size_t start = visible.find_first_not_of(" \t\r\n");
+        if (start != std::string::npos && visible.size() - start < 7 && std::string("<think>").compare(0, visible.size() - start, visible, start, std::string::npos) == 0)
+        {
+            return;
+        }
+        stripReasoningBlocks(visible);
+        if (visible.size() > shown.size() && visible.compare(0, shown.size(), shown) == 0)
+        {
+            on_delta(visible.substr(shown.size()));
+            shown = std::move(visible);
+        }
+    };
+
+    bool streamed = false;
+    LLMResponse response;
+    for (bool finished = false; !finished;)
+    {
+        std::string bytes;
+        {
+            std::unique_lock<std::mutex> lock(stream->mutex);
+            stream->changed.wait(lock, [&stream]
+                                 { return stream->finished || !stream->bytes.empty(); });
+            bytes.swap(stream->bytes);
+            finished = stream->finished;
+            if (finished)
+            {
+                response = std::move(stream->response);
+            }
+        }
+        if (!bytes.empty())
+        {
+            streamed = true;
+            std::string delta;
+            parser.feed(bytes.data(), bytes.size(), delta);
+            forward(delta, parser.result.content);
         }
-        std::cerr << "Unexpected response format from Vision AI API (callVisionAI)" << std::endl;
-        // Log the raw response if the structure is unexpected.
-        std::cerr << "Full Vision AI response (callVisionAI): " << response.dump(2) << std::endl;
     }
-    catch (const std::exception &e) // This catch block is for the initial parsing of the whole API response
+
+    // Nothing came through on_body_data: not streamed, or replayed from a cassette
+    if (!streamed && response.transport_ok)
+    {
+        std::string delta;
+        parser.feed(response.body.data(), response.body.size(), delta);
+        forward(delta, parser.result.content);
+    }
+    CompletionResult completion = parser.result;
+    if (!parser.saw_event && response.transport_ok)
     {
-        std::cerr << "Failed to parse the main Vision AI API response (callVisionAI): " << e.what() << std::endl;
-        std::cerr << "Raw Vision AI response (callVisionAI): " << response_data << std::endl;
+        // A plain completion: "stream" was not asked for, ignored by the backend, or refused with an error object
+        completion = CompletionResult();
+        parseCompletion(response.body, completion);
+        forward(completion.content, completion.content);
+    }
+    if (strip_reasoning)
+    {
+        stripReasoningBlocks(completion.content);
     }
 
-    return json::object(); // Default return if other paths fail
+    json result = json::object();
+    if (completion.has_content)
+    {
+        result["content"] = completion.content;
+    }
+    if (!response.transport_ok || !completion.has_content || !completion.error_message.empty())
+    {
+        std::string error = !response.transport_ok         ? response.error
+                            : !completion.error_message.empty() ? completion.error_message
+                                                                 : "HTTP " + std::to_string(response.http_status) + " without a reply";
+        std::cerr << "Chat request failed: " << error << std::endl;
+        result["error"] = error;
+    }
+    else if (completion.finish_reason == "length")
+    {
+        std::cerr << "⚠️ Chat reply was cut off at the token limit" << std::endl;
+    }
+    return result;
 }
@@ -3,22 +3,42 @@
 
 #include "include/json.hpp"
 #include <string>
+#include <vector>
+#include <future>
+#include <functional>
 
 using json = nlohmann::json;
 
+// Each call has a blocking form and an *Async form. The async form puts the request
+// on the wire immediately (see LLMClient) and parses the response when get() is called,
+// so independent calls can overlap without a thread per request.
+
 // Sends the user prompt to DeepSeek via OpenRouter and returns the parsed JSON response
 json callAIModel(const std::string &api_key, const std::string &user_prompt);
+std::future<json> callAIModelAsync(const std::string &api_key, const std::string &user_prompt);
 
 // Vision-specific AI model call that returns vision action JSON format
 json callVisionAIModel(const std::string &api_key, const std::string &vision_prompt);
+std::future<json> callVisionAIModelAsync(const std::string &api_key, const std::string &vision_prompt);
 
 // Dynamic intent analysis - replaces hardcoded task parsing with AI
 json callIntentAI(const std::string &api_key, const std::string &user_request);
+std::future<json> callIntentAIAsync(const std::string &api_key, const std::string &user_request);
 
 // Dynamic vision analysis - AI-driven element selection and action planning
 json callVisionAI(const std::string &api_key, const std::string &task, const std::string &screen_description, const std::vector<std::string> &available_elements);
+std::future<json> callVisionAIAsync(const std::string &api_key, const std::string &task, const std::string &screen_description, const std::vector<std::string> &available_elements);
 
 // Function to get plain text responses from the LLM, suitable for content generation
 std::string callLLMForTextGeneration(const std::string &api_key, const std::string &text_generation_prompt);
+std::future<std::string> callLLMForTextGenerationAsync(const std::string &api_key, const std::string &text_generation_prompt);
+
+// Chatbot mode: a short system prompt and the conversation as real chat messages
+// ([{"role": "user"|"assistant", "content": "..."}], oldest first, ending with the
+// new user message), with no JSON schema and no JSON extraction. Blocking only:
+// with on_delta the reply is streamed and each new piece of text is passed to
+// on_delta on the calling thread as it arrives. Returns {"content": reply}, or
+// {"error": why} (plus any partial "content") when the call failed.
+json callChatAI(const std::string &api_key, const json &conversation, const std::function<void(const std::string &)> &on_delta = nullptr);
 
-#endif // AI_MODEL_H
\ No newline at end of file
+#endif // AI_MODEL_H
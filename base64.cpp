@@ -0,0 +1,221 @@
+#include "base64.h"
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BASE64_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC allows any intrinsic in any function; GCC and Clang need the ISA per function
+#if defined(__GNUC__) || defined(__clang__)
+#define BASE64_TARGET(isa) __attribute__((target(isa)))
+#else
+#define BASE64_TARGET(isa)
+#endif
+
+namespace
+{
+    const char kBase64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    using EncodeFunction = void (*)(const unsigned char *, size_t, char *);
+
+    void encodeScalar(const unsigned char *in, size_t length, char *out)
+    {
+        size_t i = 0;
+        for (; i + 3 <= length; i += 3)
+        {
+            uint32_t triple = (uint32_t(in[i]) << 16) | (uint32_t(in[i + 1]) << 8) | in[i + 2];
+            *out++ = kBase64Chars[(triple >> 18) & 0x3f];
+            *out++ = kBase64Chars[(triple >> 12) & 0x3f];
+            *out++ = kBase64Chars[(triple >> 6) & 0x3f];
+            *out++ = kBase64Chars[triple & 0x3f];
+        }
+        if (i < length)
+        {
+            uint32_t triple = uint32_t(in[i]) << 16;
+            if (i + 1 < length)
+            {
+                triple |= uint32_t(in[i + 1]) << 8;
+            }
+            *out++ = kBase64Chars[(triple >> 18) & 0x3f];
+            *out++ = kBase64Chars[(triple >> 12) & 0x3f];
+            *out++ = (i + 1 < length) ? kBase64Chars[(triple >> 6) & 0x3f] : '=';
+            *out++ = '=';
+        }
+    }
+
+#ifdef BASE64_X86
+    // Both kernels follow Muła and Lemire, "Faster Base64 Encoding and Decoding
+    // Using AVX2 Instructions" (2018). Per 16-byte lane: spread 12 input bytes
+    // over four 32-bit words, cut each word into four 6-bit indices with two
+    // multiplies, then map indices to ASCII by adding a per-range offset looked
+    // up with pshufb. Each lane reads 16 bytes to use 12, so the loops stop
+    // while at least 4 spare input bytes remain and the scalar loop finishes.
+
+    BASE64_TARGET("ssse3")
+    void encodeSsse3(const unsigned char *in, size_t length, char *out)
+    {
+        const __m128i shuffle = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+        const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                              '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                              '/' - 63, 'A', 0, 0);
+        size_t i = 0;
+        for (; length - i >= 16; i += 12, out += 16)
+        {
+            __m128i bytes = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)), shuffle);
+            __m128i high = _mm_mulhi_epu16(_mm_and_si128(bytes, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+            __m128i low = _mm_mullo_epi16(_mm_and_si128(bytes, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+            __m128i indices = _mm_or_si128(high, low);
+
+            // 0 for a-z, 1..10 for digits, 11 for '+', 12 for '/', 13 for A-Z
+            __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+            range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices), _mm_set1_epi8(13)));
+            __m128i chars = _mm_add_epi8(indices, _mm_shuffle_epi8(offsets, range));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), chars);
+        }
+        encodeScalar(in + i, length - i, out);
+    }
+
+    BASE64_TARGET("avx2")
+    void encodeAvx2(const unsigned char *in, size_t length, char *out)
+    {
+        const __m256i shuffle = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                                 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+        const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                 '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                                 '/' - 63, 'A', 0, 0,
+                                                 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                 '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                                 '/' - 63, 'A', 0, 0);
+        size_t i = 0;
+        for (; length - i >= 28; i += 24, out += 32)
+        {
+            // Lane 0 takes bytes 0-11 and lane 1 bytes 12-23 (pshufb does not cross lanes)
+            __m256i bytes = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 12)), 1);
+            bytes = _mm256_shuffle_epi8(bytes, shuffle);
+            __m256i high = _mm256_mulhi_epu16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+            __m256i low = _mm256_mullo_epi16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+            __m256i indices = _mm256_or_si256(high, low);
+
+            __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+            range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices), _mm256_set1_epi8(13)));
+            __m256i chars = _mm256_add_epi8(indices, _mm256_shuffle_epi8(offsets, range));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), chars);
+        }
+        encodeSsse3(in + i, length - i, out);
+    }
+
+    bool cpuHasSsse3()
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 9)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("ssse3");
+#endif
+    }
+
+    bool cpuHasAvx2()
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+        {
+            return false;
+        }
+        __cpuid(info, 1);
+        bool os_saves_ymm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+        if (!os_saves_ymm)
+        {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif // BASE64_X86
+
+    EncodeFunction selectKernel()
+    {
+#ifdef BASE64_X86
+        if (cpuHasAvx2())
+        {
+            return encodeAvx2;
+        }
+        if (cpuHasSsse3())
+        {
+            return encodeSsse3;
+        }
+#endif
+        return encodeScalar;
+    }
+} // namespace
+
+size_t base64Length(size_t raw_length)
+{
+    return ((raw_length + 2) / 3) * 4;
+}
+
+void encodeBase64(const unsigned char *in, size_t length, char *out)
+{
+    static const EncodeFunction encode = selectKernel();
+    encode(in, length, out);
+}
+
+bool base64KernelAvailable(Base64Kernel kernel)
+{
+    switch (kernel)
+    {
+    case Base64Kernel::SCALAR:
+        return true;
+#ifdef BASE64_X86
+    case Base64Kernel::SSSE3:
+        return cpuHasSsse3();
+    case Base64Kernel::AVX2:
+        return cpuHasAvx2();
+#endif
+    default:
+        return false;
+    }
+}
+
+const char *base64KernelName(Base64Kernel kernel)
+{
+    switch (kernel)
+    {
+    case Base64Kernel::SSSE3:
+        return "ssse3";
+    case Base64Kernel::AVX2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+void encodeBase64With(Base64Kernel kernel, const unsigned char *in, size_t length, char *out)
+{
+#ifdef BASE64_X86
+    if (kernel == Base64Kernel::AVX2 && cpuHasAvx2())
+    {
+        encodeAvx2(in, length, out);
+        return;
+    }
+    if (kernel == Base64Kernel::SSSE3 && cpuHasSsse3())
+    {
+        encodeSsse3(in, length, out);
+        return;
+    }
+#endif
+    encodeScalar(in, length, out);
+}
@@ -0,0 +1,32 @@
+#ifndef BASE64_H
+#define BASE64_H
+
+#include <cstddef>
+
+// Standard base64 (RFC 4648, '+' '/' and '=' padding) for image uploads.
+// encodeBase64 runs an AVX2 or SSSE3 kernel when the CPU has one, picked once
+// at first use, and falls back to a table-driven scalar loop otherwise.
+
+size_t base64Length(size_t raw_length);
+
+// Encodes `length` bytes into `out`, which must hold base64Length(length) chars
+// (no terminator is written). A stream can be encoded chunk by chunk as long as
+// every chunk but the last has a length that is a multiple of 3.
+void encodeBase64(const unsigned char *in, size_t length, char *out);
+
+// The kernels encodeBase64 picks from, for tests and benchmarks. Scalar is
+// always available; the others only on x86 CPUs that have the instructions.
+enum class Base64Kernel
+{
+    SCALAR,
+    SSSE3,
+    AVX2
+};
+
+bool base64KernelAvailable(Base64Kernel kernel);
+const char *base64KernelName(Base64Kernel kernel);
+
+// encodeBase64 with a fixed kernel; falls back to scalar if it is not available
+void encodeBase64With(Base64Kernel kernel, const unsigned char *in, size_t length, char *out);
+
+#endif // BASE64_H
@@ -0,0 +1,149 @@
+// Time to base64-encode an image upload: the encoder vision_processor.cpp used
+// to have (appending to a std::string one char at a time), then each kernel
+// encodeBase64 can pick, writing into a preallocated buffer, whole and in the
+// 48 KiB chunks LLMClient streams to curl.
+#include "base64.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // The removed anonymous base64_encode from vision_processor.cpp, minus the file read
+    std::string oldBase64Encode(const std::string &file_content)
+    {
+        const std::string base64_chars =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+            "abcdefghijklmnopqrstuvwxyz"
+            "0123456789+/";
+
+        std::string ret;
+        int i = 0;
+        int j = 0;
+        unsigned char char_array_3[3];
+        unsigned char char_array_4[4];
+
+        for (char const &c : file_content)
+        {
+            char_array_3[i++] = c;
+            if (i == 3)
+            {
+                char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
+                char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
+                char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+                char_array_4[3] = char_array_3[2] & 0x3f;
+
+                for (i = 0; (i < 4); i++)
+                    ret += base64_chars[char_array_4[i]];
+                i = 0;
+            }
+        }
+
+        if (i)
+        {
+            for (j = i; j < 3; j++)
+                char_array_3[j] = '\0';
+
+            char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
+            char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
+            char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+
+            for (j = 0; (j < i + 1); j++)
+                ret += base64_chars[char_array_4[j]];
+
+            while ((i++ < 3))
+                ret += '=';
+        }
+        return ret;
+    }
+
+    template <typename F>
+    double millisecondsPerCall(F &&encode)
+    {
+        // Warm up, then run for about 300 ms
+        size_t sink = 0;
+        for (int i = 0; i < 2; ++i)
+        {
+            sink += encode();
+        }
+        int iterations = 0;
+        auto started = std::chrono::steady_clock::now();
+        std::chrono::duration<double, std::milli> elapsed{};
+        do
+        {
+            sink += encode();
+            ++iterations;
+            elapsed = std::chrono::steady_clock::now() - started;
+        } while (elapsed.count() < 300.0);
+        if (sink == 0)
+        {
+            std::printf("(empty output)\n");
+        }
+        return elapsed.count() / iterations;
+    }
+} // namespace
+
+int main()
+{
+    const Base64Kernel kernels[] = {Base64Kernel::SCALAR, Base64Kernel::SSSE3, Base64Kernel::AVX2};
+    const size_t chunk = 48 * 1024;
+
+    std::printf("%-22s %9s %9s", "upload", "MB", "old ms");
+    for (Base64Kernel kernel : kernels)
+    {
+        std::printf(" %9s", base64KernelAvailable(kernel) ? base64KernelName(kernel) : "(n/a)");
+    }
+    std::printf(" %9s %8s\n", "chunked", "speedup");
+
+    // Compressed screenshots are close to random bytes; raw frames are 4 bytes per pixel
+    const struct
+    {
+        const char *name;
+        size_t bytes;
+    } uploads[] = {
+        {"1080p PNG", 700 * 1024},
+        {"4K PNG", 3400 * 1024},
+        {"1080p BGRA", 1920 * 1080 * 4},
+        {"4K BGRA", 3840 * 2160 * 4},
+    };
+
+    std::mt19937 rng(46);
+    for (const auto &upload : uploads)
+    {
+        std::string raw(upload.bytes, '\0');
+        for (char &c : raw)
+        {
+            c = static_cast<char>(rng());
+        }
+        const unsigned char *in = reinterpret_cast<const unsigned char *>(raw.data());
+        std::vector<char> out(base64Length(raw.size()));
+
+        double old_ms = millisecondsPerCall([&raw]
+                                            { return oldBase64Encode(raw).size(); });
+        std::printf("%-22s %9.1f %9.2f", upload.name, raw.size() / (1024.0 * 1024.0), old_ms);
+        for (Base64Kernel kernel : kernels)
+        {
+            double ms = millisecondsPerCall([&]
+                                            {
+                encodeBase64With(kernel, in, raw.size(), out.data());
+                return static_cast<size_t>(out[0]); });
+            std::printf(" %9.2f", ms);
+        }
+
+        // What LLMClient does: whichever kernel encodeBase64 picked, one curl buffer at a time
+        double chunked_ms = millisecondsPerCall([&]
+                                                {
+            char *next = out.data();
+            for (size_t offset = 0; offset < raw.size(); offset += chunk)
+            {
+                size_t length = raw.size() - offset < chunk ? raw.size() - offset : chunk;
+                encodeBase64(in + offset, length, next);
+                next += base64Length(length);
+            }
+            return static_cast<size_t>(out[0]); });
+        std::printf(" %9.2f %7.1fx\n", chunked_ms, old_ms / chunked_ms);
+    }
+    return 0;
+}
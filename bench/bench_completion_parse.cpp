@@ -0,0 +1,90 @@
+// Time to get the content out of a chat-completions response the size of a
+// screen analysis: parseCompletion's SAX pass against json::parse plus a walk
+// of the DOM, which is what analyzeImageWithQwen used to do.
+#include "llm_response.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace
+{
+    // A Qwen-VL style reply: a description, then ELEMENTS_JSON_START/END around `elements` UI elements
+    std::string makeResponse(int elements)
+    {
+        std::string content = "The screen shows a chat application with a conversation list on the left, "
+                              "an open conversation in the middle and a message box at the bottom.\n"
+                              "ELEMENTS_JSON_START\n[\n";
+        for (int i = 0; i < elements; ++i)
+        {
+            json element = {{"type", i % 3 == 0 ? "button" : (i % 3 == 1 ? "text" : "input_field")},
+                            {"text", "Element label number " + std::to_string(i)},
+                            {"bbox", {10 * i, 20 + i, 10 * i + 120, 52 + i}}};
+            content += "  " + element.dump() + (i + 1 < elements ? ",\n" : "\n");
+        }
+        content += "]\nELEMENTS_JSON_END";
+
+        json response = {
+            {"id", "gen-1750000000-abcdefghijklmnop"},
+            {"provider", "Chutes"},
+            {"model", "qwen/qwen2.5-vl-32b-instruct:free"},
+            {"object", "chat.completion"},
+            {"created", 1750000000},
+            {"choices", {{{"logprobs", nullptr},
+                          {"finish_reason", "stop"},
+                          {"native_finish_reason", "stop"},
+                          {"index", 0},
+                          {"message", {{"role", "assistant"}, {"content", content}, {"refusal", nullptr}, {"reasoning", nullptr}}}}}},
+            {"usage", {{"prompt_tokens", 2741}, {"completion_tokens", 40 * elements}, {"total_tokens", 2741 + 40 * elements}}}};
+        return response.dump();
+    }
+
+    template <typename F>
+    double microsecondsPerCall(F &&parse)
+    {
+        // Warm up, then run for about 200 ms
+        size_t sink = 0;
+        for (int i = 0; i < 10; ++i)
+        {
+            sink += parse();
+        }
+        int iterations = 0;
+        auto started = std::chrono::steady_clock::now();
+        std::chrono::duration<double, std::micro> elapsed{};
+        do
+        {
+            for (int i = 0; i < 20; ++i, ++iterations)
+            {
+                sink += parse();
+            }
+            elapsed = std::chrono::steady_clock::now() - started;
+        } while (elapsed.count() < 200000.0);
+        if (sink == 0)
+        {
+            std::printf("(empty content)\n");
+        }
+        return elapsed.count() / iterations;
+    }
+} // namespace
+
+int main()
+{
+    std::printf("%9s %10s %12s %12s %8s\n", "elements", "body KB", "DOM us", "SAX us", "speedup");
+    for (int elements : {10, 40, 120, 400})
+    {
+        const std::string body = makeResponse(elements);
+
+        double dom_us = microsecondsPerCall([&body]
+                                            {
+            json response = json::parse(body);
+            std::string content = response["choices"][0]["message"]["content"].get<std::string>();
+            return content.size(); });
+        double sax_us = microsecondsPerCall([&body]
+                                            {
+            CompletionResult completion;
+            parseCompletion(body, completion);
+            return completion.content.size(); });
+
+        std::printf("%9d %10.1f %12.1f %12.1f %7.2fx\n", elements, body.size() / 1024.0, dom_us, sax_us, dom_us / sax_us);
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+// Time per screen analysis step through VisionProcessor itself: capture from
+// saved screenshots (FileScreenSource), colour conversion and encoding with
+// cv::imencode, then the streamed base64 upload to a loopback backend that
+// answers at once with a canned completion, which is parsed as usual. The
+// model's own latency is left out, so what remains is what the agent adds.
+//
+//   bench_vision_pipeline <screenshot file or directory> [frames per format]
+#include "vision_processor.h"
+#include "llm_backend.h"
+#include "screen_cache.h"
+#include "loopback_server.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const char *kCompletion =
+        R"({"id": "bench", "object": "chat.completion", "choices": [{"index": 0, "finish_reason": "stop", "message": {"role": "assistant", "content": )"
+        R"("A settings window with a search box and two buttons.\nELEMENTS_JSON_START\n[{\"type\": \"input_field\", \"text\": \"\", \"bbox\": [40, 60, 400, 90]}, )"
+        R"({\"type\": \"button\", \"text\": \"OK\", \"bbox\": [600, 700, 680, 730]}, {\"type\": \"button\", \"text\": \"Cancel\", \"bbox\": [700, 700, 780, 730]}]\nELEMENTS_JSON_END"}}]})";
+
+    double median(std::vector<double> values)
+    {
+        if (values.empty())
+        {
+            return 0.0;
+        }
+        std::sort(values.begin(), values.end());
+        return values[values.size() / 2];
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: %s <screenshot file or directory> [frames per format]\n", argv[0]);
+        return 2;
+    }
+    int frames = argc > 2 ? std::max(1, std::atoi(argv[2])) : 20;
+
+#ifdef _WIN32
+    WSADATA wsa;
+    WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+    LoopbackServer server(0, [](int)
+                          { return std::string(kCompletion); });
+    LLMBackendConfig backend;
+    backend.name = "loopback";
+    backend.url = server.url();
+    LLMBackendRouter::instance().addBackend(backend);
+    LLMBackendRouter::instance().setRoute(LLMCallType::SCREEN_ANALYSIS, "loopback");
+
+    // Every frame goes through the whole pipeline: no reuse, no cache, no crops
+    ScreenCacheSettings cache_settings;
+    cache_settings.enabled = false;
+    ScreenAnalysisCache::instance().configure(cache_settings);
+
+    struct Row
+    {
+        std::string format;
+        int width = 0;
+        int height = 0;
+        double kb = 0.0;
+        double encode_ms = 0.0;
+        double step_ms = 0.0;
+        int failed = 0;
+    };
+    std::vector<Row> rows;
+    for (const char *format : {"png", "jpeg", "webp"})
+    {
+        VisionCaptureSettings settings;
+        settings.screen_source = argv[1];
+        settings.format = format;
+        settings.change_threshold = -1.0;
+        settings.crop_changes = false;
+        VisionProcessor vision;
+        vision.setCaptureSettings(settings);
+
+        Row row;
+        row.format = format;
+        std::vector<double> kb, encode_ms, step_ms;
+        vision.analyzeCurrentScreen(); // Warm up buffers and the connection
+        for (int i = 0; i < frames; ++i)
+        {
+            ScreenAnalysis analysis = vision.analyzeCurrentScreen();
+            if (!analysis.metadata.contains("upload") || analysis.elements.empty())
+            {
+                ++row.failed;
+                continue;
+            }
+            const json &upload = analysis.metadata["upload"];
+            row.width = upload.value("width", 0);
+            row.height = upload.value("height", 0);
+            kb.push_back(upload.value("bytes", 0.0) / 1024.0);
+            encode_ms.push_back(upload.value("encode_ms", 0.0));
+            step_ms.push_back(upload.value("step_ms", 0.0));
+        }
+        row.kb = median(kb);
+        row.encode_ms = median(encode_ms);
+        row.step_ms = median(step_ms);
+        rows.push_back(row);
+    }
+
+    std::printf("\n%-6s %11s %9s %10s %9s %11s %7s\n", "format", "size", "KB", "encode ms", "step ms", "other ms", "failed");
+    for (const Row &row : rows)
+    {
+        std::printf("%-6s %5dx%-5d %9.0f %10.2f %9.2f %11.2f %7d\n", row.format.c_str(), row.width, row.height, row.kb,
+                    row.encode_ms, row.step_ms, row.step_ms - row.encode_ms, row.failed);
+    }
+    std::printf("(medians of %d frames; other ms is the rest of the step: capture, gate, base64, HTTP and parsing)\n", frames);
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include "context_window.h"
+#include "text_utf8.h"
+#include <algorithm>
+
+namespace
+{
+    const size_t kSummaryDescriptionChars = 60; // Per step inside the folded summary
+    const char *kHistoryHeading = "PREVIOUS STEPS:\n";
+} // namespace
+
+ContextWindowManager::ContextWindowManager() {}
+
+ContextWindowManager::ContextWindowManager(const ContextWindowSettings &settings) : settings(settings) {}
+
+void ContextWindowManager::setSettings(const ContextWindowSettings &new_settings)
+{
+    settings = new_settings;
+}
+
+const ContextWindowSettings &ContextWindowManager::getSettings() const
+{
+    return settings;
+}
+
+int ContextWindowManager::estimateTokens(const std::string &text)
+{
+    return static_cast<int>((text.size() + 3) / 4);
+}
+
+std::string ContextWindowManager::renderStep(size_t number, const ContextEntry &step)
+{
+    std::string line = std::to_string(number) + ". " + step.description;
+    if (step.success)
+    {
+        line += " - SUCCESS\n";
+    }
+    else
+    {
+        line += " - FAILED";
+        if (!step.error_message.empty())
+        {
+            line += " (" + step.error_message + ")";
+        }
+        line += "\n";
+    }
+    return line;
+}
+
+std::string ContextWindowManager::truncateToTokens(const std::string &text, int tokens)
+{
+    size_t max_chars = static_cast<size_t>(std::max(tokens, 0)) * 4;
+    if (text.size() <= max_chars)
+    {
+        return text;
+    }
+    // Cut at the last full line that fits so element lists stay well formed
+    size_t cut = text.rfind('\n', max_chars);
+    if (cut == std::string::npos || cut == 0)
+    {
+        return utf8Prefix(text, max_chars) + "\n[...]\n";
+    }
+    return text.substr(0, cut + 1) + "[...]\n";
+}
+
+std::string ContextWindowManager::summarizeSteps(const std::vector<ContextEntry> &steps, size_t count, int token_budget) const
+{
+    if (count == 0)
+    {
+        return "";
+    }
+
+    size_t failed = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!steps[i].success)
+        {
+            failed++;
+        }
+    }
+
+    std::string summary = "Steps 1-" + std::to_string(count) + " (summarized): " +
+                          std::to_string(count - failed) + " succeeded, " + std::to_string(failed) + " failed. ";
+    // Newest first so the most relevant older steps survive the budget
+    std::string actions;
+    for (size_t i = count; i-- > 0;)
+    {
+        std::string description = utf8Prefix(steps[i].description, kSummaryDescriptionChars);
+        std::string item = std::to_string(i + 1) + ": " + description + (steps[i].success ? " [ok]" : " [failed]") + "; ";
+        if (estimateTokens(summary + actions + item) > token_budget)
+        {
+            break;
+        }
+        actions = item + actions;
+    }
+    return summary + actions + "\n";
+}
+
+std::string ContextWindowManager::buildPrompt(const std::string &header,
+                                              const std::string &screen_section,
+                                              const std::vector<ContextEntry> &history,
+                                              const std::string &footer,
+                                              int &prompt_tokens) const
+{
+    int fixed_tokens = estimateTokens(header) + estimateTokens(footer);
+    int available = std::max(settings.prompt_token_budget - fixed_tokens, 0);
+
+    // Shrink the history until it fits in what the screen leaves over, but never
+    // let history push out more than half of the variable budget
+    size_t verbatim = std::min(history.size(), static_cast<size_t>(std::max(settings.recent_steps, 0)));
+    int screen_tokens = estimateTokens(screen_section);
+    int history_cap = std::max(available - screen_tokens, available / 2);
+    int summary_budget = settings.summary_token_budget;
+
+    std::string history_text;
+    while (true)
+    {
+        size_t folded = history.size() - verbatim;
+        history_text.clear();
+        if (!history.empty())
+        {
+            history_text = kHistoryHeading;
+            history_text += summarizeSteps(history, folded, summary_budget);
+            for (size_t i = folded; i < history.size(); ++i)
+            {
+                history_text += renderStep(i + 1, history[i]);
+            }
+            history_text += "\n";
+        }
+        if (estimateTokens(history_text) <= history_cap)
+        {
+            break;
+        }
+        if (verbatim > 1)
+        {
+            verbatim--;
+        }
+        else if (summary_budget > 40)
+        {
+            summary_budget /= 2;
+        }
+        else
+        {
+            history_text = truncateToTokens(history_text, history_cap);
+            break;
+        }
+    }
+
+    std::string screen_text = truncateToTokens(screen_section, available - estimateTokens(history_text));
+
+    std::string prompt;
+    prompt.reserve(header.size() + screen_text.size() + history_text.size() + footer.size());
+    prompt += header;
+    prompt += screen_text;
+    prompt += history_text;
+    prompt += footer;
+    prompt_tokens = estimateTokens(prompt);
+    return prompt;
+}
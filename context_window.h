@@ -0,0 +1,55 @@
+#ifndef CONTEXT_WINDOW_H
+#define CONTEXT_WINDOW_H
+
+#include <string>
+#include <vector>
+
+// One previously executed step as it should appear in a planning prompt
+struct ContextEntry
+{
+    std::string description;
+    bool success = false;
+    std::string error_message;
+};
+
+struct ContextWindowSettings
+{
+    int recent_steps = 5;           // Steps kept verbatim (context_settings.context_window_size)
+    int prompt_token_budget = 3000; // Upper bound for the whole prompt
+    int summary_token_budget = 250; // Upper bound for the folded summary of older steps
+};
+
+// Keeps vision planning prompts at a roughly constant size as a task grows.
+// The last K steps are shown verbatim, older ones are folded into a one-paragraph
+// summary, and the variable parts of the prompt are trimmed to fit a token budget.
+class ContextWindowManager
+{
+private:
+    ContextWindowSettings settings;
+
+    std::string summarizeSteps(const std::vector<ContextEntry> &steps, size_t count, int token_budget) const;
+    static std::string renderStep(size_t number, const ContextEntry &step);
+    static std::string truncateToTokens(const std::string &text, int tokens);
+
+public:
+    ContextWindowManager();
+    explicit ContextWindowManager(const ContextWindowSettings &settings);
+
+    void setSettings(const ContextWindowSettings &new_settings);
+    const ContextWindowSettings &getSettings() const;
+
+    // Rough count for budgeting (about four characters per token for English/JSON)
+    static int estimateTokens(const std::string &text);
+
+    // Builds header + screen + history + footer. header and footer are always kept;
+    // history shrinks first (fewer verbatim steps, then a shorter summary) and the
+    // screen section is cut at a line boundary last. Writes the estimated size to
+    // prompt_tokens.
+    std::string buildPrompt(const std::string &header,
+                            const std::string &screen_section,
+                            const std::vector<ContextEntry> &history,
+                            const std::string &footer,
+                            int &prompt_tokens) const;
+};
+
+#endif // CONTEXT_WINDOW_H
@@ -0,0 +1,298 @@
+#include "element_table.h"
+#include "text_utf8.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <map>
+#include <set>
+
+namespace
+{
+    const size_t kTextChars = 40;
+    const size_t kDescriptionChars = 60;
+    const size_t kMinPrefixChars = 4;     // "messag" matches "message", "messages"
+    const double kTextWeight = 2.0;       // Visible text is what the user usually names
+    const double kDescriptionWeight = 1.0;
+    const double kTypeWeight = 1.0;
+    const double kFailureTermWeight = 0.5;
+    const double kFailedElementFactor = 0.5;
+    const double kInteractiveBonus = 0.1; // Breaks ties between elements no word matched
+
+    const std::set<std::string> kStopWords = {
+        "a", "an", "and", "are", "as", "at", "be", "by", "for", "from", "i", "in", "into", "is", "it", "me",
+        "my", "of", "on", "or", "please", "the", "then", "this", "to", "with", "you", "your"};
+
+    std::string toLower(std::string text)
+    {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+        return text;
+    }
+
+    std::vector<std::string> words(const std::string &text)
+    {
+        std::vector<std::string> result;
+        std::string current;
+        for (unsigned char c : text)
+        {
+            if (std::isalnum(c))
+            {
+                current += static_cast<char>(std::tolower(c));
+                continue;
+            }
+            if (!current.empty())
+            {
+                result.push_back(current);
+                current.clear();
+            }
+        }
+        if (!current.empty())
+        {
+            result.push_back(current);
+        }
+        return result;
+    }
+
+    // Lowercase words joined by single spaces, for comparing labels
+    std::string label(const std::string &text)
+    {
+        std::string result;
+        for (const std::string &word : words(text))
+        {
+            result += (result.empty() ? "" : " ") + word;
+        }
+        return result;
+    }
+
+    bool wordMatches(const std::string &query, const std::string &word)
+    {
+        if (query == word)
+        {
+            return true;
+        }
+        const std::string &shorter = query.size() < word.size() ? query : word;
+        const std::string &longer = query.size() < word.size() ? word : query;
+        return shorter.size() >= kMinPrefixChars && longer.compare(0, shorter.size(), shorter) == 0;
+    }
+
+    // 1 for an exact word, 0.5 for a shared prefix, 0 otherwise
+    double fieldMatch(const std::string &query, const std::vector<std::string> &field)
+    {
+        double best = 0.0;
+        for (const std::string &word : field)
+        {
+            if (word == query)
+            {
+                return 1.0;
+            }
+            if (wordMatches(query, word))
+            {
+                best = 0.5;
+            }
+        }
+        return best;
+    }
+
+    bool isInteractive(const std::string &type)
+    {
+        std::string lower = toLower(type);
+        for (const char *kind : {"button", "input", "field", "edit", "link", "menu", "tab", "checkbox", "icon"})
+        {
+            if (lower.find(kind) != std::string::npos)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::string clean(const std::string &text, size_t max_chars)
+    {
+        std::string result;
+        bool space = false;
+        for (char c : text)
+        {
+            if (c == '|' || c == '\n' || c == '\r' || c == '\t' || c == ' ')
+            {
+                space = !result.empty();
+                continue;
+            }
+            if (space)
+            {
+                result += ' ';
+                space = false;
+            }
+            result += c;
+        }
+        if (result.size() > max_chars)
+        {
+            result = utf8Prefix(result, max_chars - 3) + "...";
+        }
+        return result;
+    }
+} // namespace
+
+std::string elementId(size_t index)
+{
+    return "e" + std::to_string(index + 1);
+}
+
+int elementIndexFromId(const std::string &target, size_t element_count)
+{
+    size_t pos = 0;
+    while (pos < target.size() && (target[pos] == ' ' || target[pos] == '[' || target[pos] == '#' || target[pos] == '"'))
+    {
+        pos++;
+    }
+    if (pos >= target.size() || (target[pos] != 'e' && target[pos] != 'E'))
+    {
+        return -1;
+    }
+    pos++;
+    size_t digits_start = pos;
+    long number = 0;
+    while (pos < target.size() && std::isdigit(static_cast<unsigned char>(target[pos])) && pos - digits_start < 6)
+    {
+        number = number * 10 + (target[pos] - '0');
+        pos++;
+    }
+    // "e7" must not be the start of a word such as "e7x" or "edit"
+    if (pos == digits_start || (pos < target.size() && std::isalnum(static_cast<unsigned char>(target[pos]))))
+    {
+        return -1;
+    }
+    if (number < 1 || static_cast<size_t>(number) > element_count)
+    {
+        return -1;
+    }
+    return static_cast<int>(number - 1);
+}
+
+std::vector<size_t> rankElements(const std::vector<UIElement> &elements,
+                                 const std::string &task,
+                                 const std::vector<std::string> &failed_targets,
+                                 size_t limit)
+{
+    // Query words and their weights; a word in both the task and a failure keeps the task weight
+    std::map<std::string, double> query;
+    for (const std::string &failed : failed_targets)
+    {
+        for (const std::string &word : words(failed))
+        {
+            if (!kStopWords.count(word))
+            {
+                query[word] = kFailureTermWeight;
+            }
+        }
+    }
+    for (const std::string &word : words(task))
+    {
+        if (!kStopWords.count(word))
+        {
+            query[word] = 1.0;
+        }
+    }
+
+    struct Fields
+    {
+        std::vector<std::string> text, description, type;
+    };
+    std::vector<Fields> fields(elements.size());
+    for (size_t i = 0; i < elements.size(); ++i)
+    {
+        fields[i] = {words(elements[i].text), words(elements[i].description), words(elements[i].type)};
+    }
+
+    // Rarer words on this screen say more about which element is meant
+    std::map<std::string, double> idf;
+    for (const auto &entry : query)
+    {
+        size_t containing = 0;
+        for (const Fields &field : fields)
+        {
+            if (fieldMatch(entry.first, field.text) > 0 || fieldMatch(entry.first, field.description) > 0 ||
+                fieldMatch(entry.first, field.type) > 0)
+            {
+                containing++;
+            }
+        }
+        idf[entry.first] = std::log(1.0 + static_cast<double>(elements.size() + 1) / (containing + 1));
+    }
+
+    std::set<std::string> failed_labels;
+    for (const std::string &failed : failed_targets)
+    {
+        std::string failed_label = label(failed);
+        if (!failed_label.empty())
+        {
+            failed_labels.insert(failed_label);
+        }
+    }
+
+    std::vector<double> scores(elements.size(), 0.0);
+    for (size_t i = 0; i < elements.size(); ++i)
+    {
+        double score = 0.0;
+        for (const auto &entry : query)
+        {
+            double match = kTextWeight * fieldMatch(entry.first, fields[i].text) +
+                           kDescriptionWeight * fieldMatch(entry.first, fields[i].description) +
+                           kTypeWeight * fieldMatch(entry.first, fields[i].type);
+            score += entry.second * idf[entry.first] * match;
+        }
+        if (isInteractive(elements[i].type))
+        {
+            score += kInteractiveBonus;
+        }
+        std::string text_label = label(elements[i].text);
+        std::string description_label = label(elements[i].description);
+        if ((!text_label.empty() && failed_labels.count(text_label)) ||
+            (!description_label.empty() && failed_labels.count(description_label)))
+        {
+            score *= kFailedElementFactor;
+        }
+        scores[i] = score;
+    }
+
+    std::vector<size_t> order(elements.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&scores](size_t a, size_t b)
+                     { return scores[a] > scores[b]; });
+    if (order.size() > limit)
+    {
+        order.resize(limit);
+    }
+    return order;
+}
+
+std::string renderElementTable(const std::vector<UIElement> &elements,
+                               const std::vector<size_t> &order,
+                               bool include_geometry)
+{
+    std::string table = include_geometry ? "id|type|text|description|x,y,w,h\n" : "id|type|text|description\n";
+    for (size_t index : order)
+    {
+        if (index >= elements.size())
+        {
+            continue;
+        }
+        const UIElement &element = elements[index];
+        std::string text = clean(element.text, kTextChars);
+        std::string description = clean(element.description, kDescriptionChars);
+        if (toLower(description) == toLower(text))
+        {
+            description.clear();
+        }
+        table += elementId(index) + "|" + clean(element.type, kTextChars) + "|" + text + "|" + description;
+        if (include_geometry)
+        {
+            table += "|" + std::to_string(element.x) + "," + std::to_string(element.y) + "," +
+                     std::to_string(element.width) + "," + std::to_string(element.height);
+        }
+        table += "\n";
+    }
+    return table;
+}
@@ -0,0 +1,39 @@
+#ifndef ELEMENT_TABLE_H
+#define ELEMENT_TABLE_H
+
+#include "screen_analysis.h"
+#include <string>
+#include <vector>
+
+// Compact, relevance-ordered UI element lists for prompts.
+//
+// Elements are referred to by short ids ("e1", "e2", ...) derived from their
+// position in ScreenAnalysis::elements, so an id the model returns resolves
+// against the same analysis the prompt was built from.
+
+// "e" + (index + 1)
+std::string elementId(size_t index);
+
+// Index of the element an action target refers to by id ("e7", "E7", "[e7]",
+// "e7 - Send button"), or -1 if the target is not an id or out of range.
+int elementIndexFromId(const std::string &target, size_t element_count);
+
+// Indices of the `limit` elements most relevant to the task, best first.
+// Scores are lexical: task words found in an element's text, description or
+// type, weighted by how rare the word is on this screen. Words from
+// failed_targets (what earlier failed actions were aimed at) count half, and
+// an element that exactly matches a failed target is demoted so alternatives
+// surface. Ties keep the vision model's order.
+std::vector<size_t> rankElements(const std::vector<UIElement> &elements,
+                                 const std::string &task,
+                                 const std::vector<std::string> &failed_targets,
+                                 size_t limit);
+
+// One header line and one pipe-separated row per element:
+//   id|type|text|description[|x,y,w,h]
+// Fields are trimmed and a description that repeats the text is left out.
+std::string renderElementTable(const std::vector<UIElement> &elements,
+                               const std::vector<size_t> &order,
+                               bool include_geometry);
+
+#endif // ELEMENT_TABLE_H
@@ -0,0 +1,108 @@
+#include "execution_context.h"
+#include "ai_model.h"
+#include <iostream>
+#include <atomic>
+
+namespace
+{
+    std::atomic<long> intent_analyses{0};
+    std::atomic<long> intent_analyses_reused{0};
+    std::atomic<long> screen_analyses{0};
+    std::atomic<long> screen_analyses_reused{0};
+} // namespace
+
+ExecutionContext::ExecutionContext(const std::string &request) : request(request) {}
+
+const std::string &ExecutionContext::getRequest() const
+{
+    return request;
+}
+
+void ExecutionContext::setIntent(const json &analysis)
+{
+    std::lock_guard<std::mutex> lock(context_mutex);
+    if (has_intent || analysis.empty())
+    {
+        return;
+    }
+    intent = analysis;
+    has_intent = true;
+    intent_analyses++;
+}
+
+json ExecutionContext::getOrComputeIntent(const std::string &api_key)
+{
+    {
+        std::lock_guard<std::mutex> lock(context_mutex);
+        if (has_intent)
+        {
+            intent_reuses++;
+            intent_analyses_reused++;
+            std::cout << "♻️ Reusing intent analysis already computed for this request" << std::endl;
+            return intent;
+        }
+    }
+    // Not under the lock: the call takes seconds. A concurrent caller may duplicate
+    // it, and setIntent keeps whichever answer arrived first.
+    json analysis = callIntentAI(api_key, request);
+    setIntent(analysis);
+    return analysis;
+}
+
+void ExecutionContext::setScreen(const ScreenAnalysis &analysis)
+{
+    std::lock_guard<std::mutex> lock(context_mutex);
+    screen = analysis;
+    screen_captured_at = std::chrono::steady_clock::now();
+    has_screen = true;
+    screen_captures++;
+    screen_analyses++;
+}
+
+bool ExecutionContext::getFreshScreen(long max_age_ms, ScreenAnalysis &out)
+{
+    std::lock_guard<std::mutex> lock(context_mutex);
+    if (!has_screen || std::chrono::steady_clock::now() - screen_captured_at > std::chrono::milliseconds(max_age_ms))
+    {
+        return false;
+    }
+    out = screen;
+    screen_reuses++;
+    screen_analyses_reused++;
+    return true;
+}
+
+void ExecutionContext::setPlanStarter(std::function<std::future<json>()> starter)
+{
+    std::lock_guard<std::mutex> lock(context_mutex);
+    start_plan = std::move(starter);
+}
+
+std::shared_future<json> ExecutionContext::getPlan()
+{
+    std::lock_guard<std::mutex> lock(context_mutex);
+    if (!plan.valid() && start_plan)
+    {
+        plan = start_plan().share(); // Only submits the call; the answer arrives later
+        start_plan = nullptr;
+    }
+    return plan;
+}
+
+json ExecutionContext::getStats() const
+{
+    std::lock_guard<std::mutex> lock(context_mutex);
+    return {
+        {"intent_calls_avoided", intent_reuses},
+        {"screen_analyses", screen_captures},
+        {"screen_analyses_avoided", screen_reuses}};
+}
+
+json ExecutionContext::getGlobalStats()
+{
+    return {
+        {"intent_analyses", intent_analyses.load()},
+        {"intent_calls_avoided", intent_analyses_reused.load()},
+        {"screen_analyses", screen_analyses.load()},
+        {"screen_analyses_avoided", screen_analyses_reused.load()}};
+}
@@ -0,0 +1,63 @@
+#ifndef EXECUTION_CONTEXT_H
+#define EXECUTION_CONTEXT_H
+
+#include "include/json.hpp"
+#include "vision_processor.h"
+#include <string>
+#include <mutex>
+#include <future>
+#include <functional>
+#include <chrono>
+
+using json = nlohmann::json;
+
+// Facts about one user request that several components need: the intent
+// analysis, the latest screen analysis and the plan. Whoever
+// computes a fact first stores it here and everyone after reuses it, so a single
+// /api/execute pays for each at most once. Safe to share between threads.
+class ExecutionContext
+{
+private:
+    std::string request;
+
+    mutable std::mutex context_mutex;
+    bool has_intent = false;
+    json intent;
+    bool has_screen = false;
+    ScreenAnalysis screen;
+    std::chrono::steady_clock::time_point screen_captured_at;
+    std::shared_future<json> plan;
+    std::function<std::future<json>()> start_plan; // Run by the first getPlan
+
+    // This request's share of the process-wide counters (see getGlobalStats)
+    int intent_reuses = 0;
+    int screen_captures = 0;
+    int screen_reuses = 0;
+
+public:
+    explicit ExecutionContext(const std::string &request);
+
+    const std::string &getRequest() const;
+
+    // Intent of getRequest() as returned by callIntentAI; the first value stored wins
+    void setIntent(const json &analysis);
+    // Stored intent if there is one, otherwise asks callIntentAI and stores a non-empty answer
+    json getOrComputeIntent(const std::string &api_key);
+
+    void setScreen(const ScreenAnalysis &analysis);
+    // Copies the stored screen analysis if it is younger than max_age_ms
+    bool getFreshScreen(long max_age_ms, ScreenAnalysis &out);
+
+    // How to start the planning call. Nothing is sent until getPlan is first
+    // called, so a request routed to the vision executor never pays for a plan.
+    void setPlanStarter(std::function<std::future<json>()> starter);
+    // The plan, started on the first call; invalid if no starter was set
+    std::shared_future<json> getPlan();
+
+    // Calls this request avoided so far
+    json getStats() const;
+    // Calls avoided across all requests since startup
+    static json getGlobalStats();
+};
+
+#endif // EXECUTION_CONTEXT_H
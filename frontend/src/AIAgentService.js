@@ -52,6 +52,56 @@ class AIAgentService {
     }
   }
 
+  // Chatbot mode: streams the reply to `messages` ([{ role, content }], oldest
+  // first, ending with the new user message). onDelta gets each piece of text
+  // as it arrives; resolves with the final event ({ done, content, error? }).
+  async streamChat(messages, onDelta) {
+    try {
+      const response = await fetch(`${this.baseUrl}/api/chat/stream`, {
+        method: "POST",
+        headers: {
+          "Content-Type": "application/json",
+        },
+        body: JSON.stringify({ messages }),
+      });
+
+      if (!response.ok) {
+        throw new Error(`HTTP error! status: ${response.status}`);
+      }
+
+      const reader = response.body.getReader();
+      const decoder = new TextDecoder();
+      let buffered = "";
+      let result = null;
+      for (;;) {
+        const { value, done } = await reader.read();
+        if (done) break;
+        buffered += decoder.decode(value, { stream: true });
+        // Events are separated by a blank line
+        let boundary;
+        while ((boundary = buffered.indexOf("\n\n")) !== -1) {
+          const event = buffered.slice(0, boundary);
+          buffered = buffered.slice(boundary + 2);
+          if (!event.startsWith("data: ")) continue;
+          const data = JSON.parse(event.slice(6));
+          if (data.done) {
+            result = data;
+          } else if (data.delta) {
+            onDelta(data.delta);
+          }
+        }
+      }
+
+      if (!result) {
+        throw new Error("Chat stream ended without a reply");
+      }
+      return result;
+    } catch (error) {
+      console.error("Stream chat error:", error);
+      throw error;
+    }
+  }
+
   async getHistory() {
     try {
       const response = await fetch(`${this.baseUrl}/api/history`);
@@ -42,11 +42,31 @@ const ChatInterface = ({ aiService }) => {
   };
 
   const addMessage = (message) => {
-    setMessages((prev) => [
-      ...prev,
-      { ...message, id: Date.now() + Math.random() },
-    ]);
+    const id = Date.now() + Math.random();
+    setMessages((prev) => [...prev, { ...message, id }]);
+    return id;
   };
+
+  const updateMessage = (id, update) => {
+    setMessages((prev) =>
+      prev.map((message) =>
+        message.id === id ? { ...message, ...update(message) } : message
+      )
+    );
+  };
+
+  // Earlier chatbot turns, sent along so the model sees the conversation
+  const chatHistory = () =>
+    messages
+      .filter(
+        (message) =>
+          (message.type === "user" || message.type === "assistant") &&
+          message.content
+      )
+      .map((message) => ({
+        role: message.type === "user" ? "user" : "assistant",
+        content: message.content,
+      }));
   const handleSubmit = async (e) => {
     e.preventDefault();
     if (!input.trim() || isLoading || !connectionStatus) return;
@@ -62,22 +82,30 @@ const ChatInterface = ({ aiService }) => {
     setIsLoading(true);
 
     try {
-      // In chatbot mode, force auto_execute to false and add mode parameter
-      const autoExecute = mode === "chatbot" ? false : false; // Default to asking permission
-      const response = await aiService.executeTask(input, autoExecute, mode);
-
       if (mode === "chatbot") {
-        // In chatbot mode, just show the AI response without execution options
-        const aiMessage = {
+        // In chatbot mode the reply streams into its message as it arrives
+        const conversation = [
+          ...chatHistory(),
+          { role: "user", content: input },
+        ];
+        const replyId = addMessage({
           type: "assistant",
-          content:
-            response.content ||
-            response.message ||
-            "I understand your request. In chatbot mode, I can only provide information and suggestions without executing tasks.",
+          content: "",
           timestamp: new Date().toLocaleTimeString(),
-        };
-        addMessage(aiMessage);
+        });
+        const result = await aiService.streamChat(conversation, (delta) =>
+          updateMessage(replyId, (message) => ({
+            content: message.content + delta,
+          }))
+        );
+        updateMessage(replyId, () =>
+          result.content
+            ? { content: result.content }
+            : { type: "error", content: `Error: ${result.error}` }
+        );
       } else {
+        const response = await aiService.executeTask(input, false, mode); // Default to asking permission
+
         // Agent mode - handle confirmation/execution flow
         if (response.response_type === "confirmation") {
           // Show conversational confirmation message
@@ -1,5 +1,6 @@
 #include "http_server.h"
 #include "ai_model.h"
+#include "llm_backend.h"
 #include <iostream>
 #include <sstream>
 #include <thread>
@@ -8,6 +9,7 @@
 #include <ctime>
 #include <vector>
 #include <algorithm>
+#include <cctype>
 #include "vision_processor.h" // Added for ScreenAnalysis, UIElement
 // httplib.h removed - not available
 
@@ -20,6 +22,38 @@
 
 #pragma comment(lib, "ws2_32.lib")
 
+namespace
+{
+    const size_t kMaxRequestBytes = 1024 * 1024; // Chat history is the largest body a client sends
+
+    // Reads the headers, then as much body as Content-Length announces
+    bool receiveRequest(SOCKET client_socket, std::string &raw_request)
+    {
+        char buffer[4096];
+        size_t expected = std::string::npos; // Known once the headers are in
+        while (raw_request.size() < expected && raw_request.size() < kMaxRequestBytes)
+        {
+            int bytes_received = recv(client_socket, buffer, sizeof(buffer), 0);
+            if (bytes_received <= 0)
+            {
+                break;
+            }
+            raw_request.append(buffer, bytes_received);
+            size_t header_end = raw_request.find("\r\n\r\n");
+            if (expected == std::string::npos && header_end != std::string::npos)
+            {
+                std::string headers = raw_request.substr(0, header_end);
+                std::transform(headers.begin(), headers.end(), headers.begin(), [](unsigned char c)
+                               { return static_cast<char>(std::tolower(c)); });
+                size_t length_pos = headers.find("\r\ncontent-length:");
+                size_t body_length = length_pos == std::string::npos ? 0 : std::strtoul(headers.c_str() + length_pos + 17, nullptr, 10);
+                expected = header_end + 4 + body_length;
+            }
+        }
+        return !raw_request.empty();
+    }
+} // namespace
+
 HttpServer::HttpServer(int port) : port(port), running(false),
                                    executor(nullptr),
                                    task_planner(nullptr), multimodal_handler(nullptr),
@@ -48,6 +82,16 @@ void HttpServer::setComponents(AdvancedExecutor *adv_exec,
     api_key = key;
 }
 
+void HttpServer::setIntentClassifier(std::shared_ptr<IntentClassifier> classifier)
+{
+    intent_classifier = std::move(classifier);
+}
+
+void HttpServer::setFusedRouting(bool enabled)
+{
+    fused_routing = enabled;
+}
+
 bool HttpServer::start()
 {
     if (running.load())
@@ -105,13 +149,8 @@ bool HttpServer::start()
             
             // Handle request in a separate thread
             std::thread([this, client_socket]() {
-                char buffer[4096];
-                int bytes_received = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
-                
-                if (bytes_received > 0) {
-                    buffer[bytes_received] = '\0';
-                    std::string raw_request(buffer);
-                    
+                std::string raw_request;
+                if (receiveRequest(client_socket, raw_request)) {
                     HttpRequest request;
                     parseRequest(raw_request, request);
                     
@@ -120,6 +159,11 @@ bool HttpServer::start()
                     
                     std::string response_str = buildResponse(response);
                     send(client_socket, response_str.c_str(), response_str.length(), 0);
+                    if (response.stream) {
+                        response.stream([client_socket](const std::string &chunk) {
+                            return send(client_socket, chunk.c_str(), static_cast<int>(chunk.length()), 0) != SOCKET_ERROR;
+                        });
+                    }
                 }
                 
                 closesocket(client_socket);
@@ -211,6 +255,13 @@ std::string HttpServer::buildResponse(const HttpResponse &response)
         oss << header.first << ": " << header.second << "\r\n";
     }
 
+    if (response.stream)
+    {
+        // The body follows as it is produced and ends when the connection closes
+        oss << "\r\n";
+        return oss.str();
+    }
+
     oss << "Content-Length: " << response.body.length() << "\r\n";
     oss << "\r\n";
     oss << response.body;
@@ -241,6 +292,10 @@ void HttpServer::handleRequest(const HttpRequest &request, HttpResponse &respons
         {
             handleExecuteTask(request_data, response);
         }
+        else if (request.path == "/api/chat/stream" && request.method == "POST")
+        {
+            handleChatStream(request_data, response);
+        }
         else if (request.path == "/api/history" && request.method == "GET")
         {
             handleGetHistory(request_data, response);
@@ -253,6 +308,16 @@ void HttpServer::handleRequest(const HttpRequest &request, HttpResponse &respons
         {
             handleUpdatePreferences(request_data, response);
         }
+        else if (request.path == "/api/metrics" && request.method == "GET")
+        {
+            // ?limit=N caps the list of recent calls
+            auto limit = request.query_params.find("limit");
+            if (limit != request.query_params.end())
+            {
+                request_data["limit"] = std::atoi(limit->second.c_str());
+            }
+            handleGetMetrics(request_data, response);
+        }
         else if (request.path == "/api/processes" && request.method == "GET")
         {
             handleGetActiveProcesses(request_data, response);
@@ -337,15 +402,15 @@ void HttpServer::handleExecuteTask(const json &request_data, HttpResponse &respo
 
         if (mode == "chatbot")
         {
-            std::string chatbot_prompt = "You are a helpful AI assistant. The user will ask you questions or make requests. "
-                                         "Respond conversationally and helpfully, but do not provide executable commands or scripts. "
-                                         "If the user asks you to perform a task that would require system access, explain what you would do "
-                                         "but mention that you're in chatbot mode and cannot execute commands. "
-                                         "Always be friendly, informative, and helpful.\n\n"
-                                         "User: " +
-                                         user_input;
+            // The client keeps the conversation and sends the earlier turns along
+            json conversation = request_data.value("history", json::array());
+            if (!conversation.is_array())
+            {
+                conversation = json::array();
+            }
+            conversation.push_back({{"role", "user"}, {"content", user_input}});
 
-            json ai_response = callAIModel(api_key, chatbot_prompt);
+            json ai_response = callChatAI(api_key, conversation);
             result["response_type"] = "text";
             result["content"] = ai_response.value("content", "I understand your request, but I'm currently in chatbot mode. I can provide information and suggestions, but I cannot execute commands or perform system tasks. How else can I help you?");
 
@@ -354,13 +419,34 @@ void HttpServer::handleExecuteTask(const json &request_data, HttpResponse &respo
         }
         else
         {
-            if (isVisionTask(user_input))
+            // Everything learned about this request (intent, screen, plan) is computed once
+            // and shared with the executors through the context
+            auto context = std::make_shared<ExecutionContext>(user_input);
+
+            // The plan is started by whoever needs it first: the fused route oracle or a
+            // regular task below. A request routed to the vision executor never starts it.
+            std::string key = api_key;
+            context->setPlanStarter([key, user_input]
+                                    { return callAIModelAsync(key, user_input); });
+
+            auto request_started = std::chrono::steady_clock::now();
+            RoutingStats &routing = routing_stats[fused_routing ? 1 : 0];
+            auto recordReady = [&routing, request_started](int route)
+            {
+                routing.requests[route]++;
+                routing.ready_time_us[route] += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - request_started).count();
+            };
+            bool is_vision_task = isVisionTask(user_input, context);
+
+            if (is_vision_task)
             {
-                result = handleVisionTaskRequest(user_input);
+                recordReady(1);
+                result = handleVisionTaskRequest(user_input, context);
             }
             else
             {
-                json ai_response = callAIModel(api_key, user_input);
+                json ai_response = context->getPlan().get();
+                recordReady(0);
                 result["response_type"] = "text";
                 result["content"] = ai_response.value("content", "Unable to process your request.");
             }
@@ -381,6 +467,49 @@ void HttpServer::handleExecuteTask(const json &request_data, HttpResponse &respo
     }
 }
 
+void HttpServer::handleChatStream(const json &request_data, HttpResponse &response)
+{
+    json conversation = request_data.value("messages", json::array());
+    if (!conversation.is_array() || conversation.empty() || !conversation.back().is_object() ||
+        conversation.back().value("role", "") != "user")
+    {
+        response.status_code = 400;
+        response.body = R"({"error": "'messages' must be an array ending with a user message"})";
+        return;
+    }
+
+    // Server-sent events: {"delta": "..."} for each piece of the reply, then the
+    // callChatAI result with "done": true and the time to the first piece
+    response.headers["Content-Type"] = "text/event-stream";
+    response.headers["Cache-Control"] = "no-cache";
+    response.headers["Connection"] = "close";
+    std::string key = api_key;
+    response.stream = [key, conversation](const std::function<bool(const std::string &)> &write)
+    {
+        auto sendEvent = [&write](const json &event)
+        {
+            return write("data: " + event.dump(-1, ' ', false, json::error_handler_t::replace) + "\n\n");
+        };
+        auto started = std::chrono::steady_clock::now();
+        double first_delta_ms = -1.0;
+        bool connected = true;
+        json result = callChatAI(key, conversation, [&](const std::string &delta)
+                                 {
+            if (first_delta_ms < 0)
+            {
+                first_delta_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+            }
+            connected = connected && sendEvent({{"delta", delta}}); });
+        result["done"] = true;
+        result["first_delta_ms"] = first_delta_ms;
+        result["total_ms"] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        if (connected)
+        {
+            sendEvent(result);
+        }
+    };
+}
+
 void HttpServer::handleGetHistory(const json &request_data, HttpResponse &response)
 {
     json history_response;
@@ -396,9 +525,46 @@ void HttpServer::handleGetSystemInfo(const json &request_data, HttpResponse &res
     // Removed context_manager references
     system_info["system_state"] = "active";
     system_info["user_preferences"] = json::object();
+    if (intent_classifier)
+    {
+        system_info["intent_classifier"] = intent_classifier->getStats();
+    }
     response.body = system_info.dump();
 }
 
+void HttpServer::handleGetMetrics(const json &request_data, HttpResponse &response)
+{
+    int limit = request_data.value("limit", 100);
+    json metrics = LLMMetrics::instance().snapshot(static_cast<size_t>(std::max(limit, 0)));
+    metrics["execution_context"] = ExecutionContext::getGlobalStats();
+    metrics["backend_routes"] = LLMBackendRouter::instance().describeRoutes();
+    metrics["call_profiles"] = LLMBackendRouter::instance().describeProfiles();
+
+    // A/B view of agent-mode routing, per mode and route: time from request to a
+    // ready plan (regular tasks) or to the vision executor starting (vision tasks)
+    json routing = {{"mode", fused_routing ? "fused" : "separate"}};
+    const char *mode_names[2] = {"separate", "fused"};
+    const char *route_names[2] = {"regular", "vision"};
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        json per_mode = json::object();
+        for (int route = 0; route < 2; ++route)
+        {
+            long requests = routing_stats[mode].requests[route];
+            per_mode[route_names[route]] = {
+                {"requests", requests},
+                {"avg_ready_ms", requests > 0 ? routing_stats[mode].ready_time_us[route] / 1000.0 / requests : 0.0}};
+        }
+        routing[mode_names[mode]] = per_mode;
+    }
+    metrics["routing"] = routing;
+    if (intent_classifier)
+    {
+        metrics["intent_classifier"] = intent_classifier->getStats();
+    }
+    response.body = metrics.dump();
+}
+
 void HttpServer::handleUpdatePreferences(const json &request_data, HttpResponse &response)
 {
     try
@@ -485,27 +651,45 @@ std::map<std::string, std::string> HttpServer::parseQueryString(const std::strin
     return params;
 }
 
-bool HttpServer::isVisionTask(const std::string &input)
+bool HttpServer::isVisionTask(const std::string &input, const std::shared_ptr<ExecutionContext> &context)
 {
-    // Use AI to dynamically determine if this is a vision task
-    try
+    // Use AI to dynamically determine if this is a vision task. The key and context
+    // are copied because background audits of the local classifier may outlive this call.
+    // With fused routing the plan already in flight decides, saving the intent call;
+    // the classifier's audits still ask the intent LLM, never for a plan.
+    auto get_plan = [context]
+    { return context->getPlan(); };
+    IntentOracle ask_plan = fused_routing ? planRouteOracle(get_plan) : nullptr;
+    IntentOracle ask_intent = [key = api_key, context](const std::string &request, bool &is_vision)
     {
-        json intent = callIntentAI(api_key, input);
-
-        if (intent.contains("is_vision_task"))
+        try
         {
-            bool is_vision = intent["is_vision_task"];
-            double confidence = intent.value("confidence", 0.5);
+            json intent = callIntentAI(key, request);
+            context->setIntent(intent); // The vision executor parses the same request again
 
-            std::cout << "🤖 AI Intent Analysis (HTTP): " << (is_vision ? "Vision Task" : "Regular Task")
-                      << " (confidence: " << (confidence * 100) << "%)" << std::endl;
+            if (intent.contains("is_vision_task"))
+            {
+                is_vision = intent["is_vision_task"];
+                double confidence = intent.value("confidence", 0.5);
 
-            return is_vision;
+                std::cout << "🤖 AI Intent Analysis (HTTP): " << (is_vision ? "Vision Task" : "Regular Task")
+                          << " (confidence: " << (confidence * 100) << "%)" << std::endl;
+                return true;
+            }
         }
-    }
-    catch (const std::exception &e)
+        catch (const std::exception &e)
+        {
+            std::cout << "⚠️ AI intent analysis failed, falling back to keyword detection: " << e.what() << std::endl;
+        }
+        return false;
+    };
+
+    bool is_vision = false;
+    bool decided = intent_classifier ? intent_classifier->route(input, ask_intent, is_vision, ask_plan)
+                                     : (ask_plan ? ask_plan : ask_intent)(input, is_vision);
+    if (decided)
     {
-        std::cout << "⚠️ AI intent analysis failed, falling back to keyword detection: " << e.what() << std::endl;
+        return is_vision;
     }
 
     // Fallback to simplified keyword detection if AI fails
@@ -528,7 +712,7 @@ bool HttpServer::isVisionTask(const std::string &input)
     return false;
 }
 
-json HttpServer::handleVisionTaskRequest(const std::string &input)
+json HttpServer::handleVisionTaskRequest(const std::string &input, const std::shared_ptr<ExecutionContext> &context)
 {
     json result;
 
@@ -537,7 +721,7 @@ json HttpServer::handleVisionTaskRequest(const std::string &input)
         std::cout << "🎯 Processing vision task via HTTP: " << input << std::endl;
 
         // Execute natural language task using vision
-        ExecutionResult exec_result = executor->executeNaturalLanguageTask(input);
+        ExecutionResult exec_result = executor->executeNaturalLanguageTask(input, context);
 
         result["response_type"] = "vision_task";
         result["success"] = exec_result.success;
@@ -554,6 +738,11 @@ json HttpServer::handleVisionTaskRequest(const std::string &input)
             result["step_details"] = exec_result.metadata["step_details"];
         }
 
+        if (exec_result.metadata.contains("context"))
+        {
+            result["context"] = exec_result.metadata["context"];
+        }
+
         if (!exec_result.success)
         {
             result["error"] = exec_result.error_message;
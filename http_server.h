@@ -5,6 +5,8 @@
 #include "advanced_executor.h"
 #include "task_planner.h"
 #include "multimodal_handler.h"
+#include "intent_classifier.h"
+#include "llm_metrics.h"
 #include <string>
 #include <thread>
 #include <atomic>
@@ -26,6 +28,10 @@ struct HttpResponse
     int status_code;
     std::string body;
     std::map<std::string, std::string> headers;
+    // Set for a streamed reply: the headers go out without Content-Length, then
+    // this runs on the connection's thread and sends the body through write
+    // (false once the client is gone). The connection closes afterwards.
+    std::function<void(const std::function<bool(const std::string &)> &write)> stream;
 
     HttpResponse(int code = 200) : status_code(code)
     {
@@ -49,6 +55,17 @@ private:
     VisionProcessor *vision_processor_ptr = nullptr;   // Added
     AdvancedExecutor *advanced_executor_ptr = nullptr; // For clarity, ensure it's present, though 'executor' might be it
     std::string api_key;
+    std::shared_ptr<IntentClassifier> intent_classifier; // Optional local router in front of callIntentAI
+    bool fused_routing = false;                          // Route from the plan's type instead of a separate intent call
+
+    // Time from the request to the point where work can start: the plan for a
+    // regular task, the route decision for a vision task (its executor plans on its own)
+    struct RoutingStats
+    {
+        std::atomic<long> requests[2] = {{0}, {0}};        // [0] regular, [1] vision
+        std::atomic<long> ready_time_us[2] = {{0}, {0}};
+    };
+    RoutingStats routing_stats[2]; // [0] separate intent call, [1] fused with planning
 
     // HTTP handling
     void handleRequest(const HttpRequest &request, HttpResponse &response);
@@ -57,8 +74,10 @@ private:
 
     // API endpoints
     void handleExecuteTask(const json &request_data, HttpResponse &response);
+    void handleChatStream(const json &request_data, HttpResponse &response);
     void handleGetHistory(const json &request_data, HttpResponse &response);
     void handleGetSystemInfo(const json &request_data, HttpResponse &response);
+    void handleGetMetrics(const json &request_data, HttpResponse &response);
     void handleUpdatePreferences(const json &request_data, HttpResponse &response);
     void handleGetActiveProcesses(const json &request_data, HttpResponse &response);
     void handleRollback(const json &request_data, HttpResponse &response);
@@ -67,8 +86,8 @@ private:
     void handleImageInput(const json &request_data, HttpResponse &response);
 
     // Vision task handling
-    bool isVisionTask(const std::string &input);            // This seems more like a helper for general task execution
-    json handleVisionTaskRequest(const std::string &input); // This seems more like a helper for general task execution
+    bool isVisionTask(const std::string &input, const std::shared_ptr<ExecutionContext> &context);            // This seems more like a helper for general task execution
+    json handleVisionTaskRequest(const std::string &input, const std::shared_ptr<ExecutionContext> &context); // This seems more like a helper for general task execution
                                                             // New API Handlers for Vision - removed httplib references
     // void handleApiVisionAnalyzeScreen(...);
     // void handleApiVisionExecuteAction(...);
@@ -81,6 +100,8 @@ public:
     void setComponents(AdvancedExecutor *adv_exec,
                        TaskPlanner *planner, MultiModalHandler *mm_handler,
                        VisionProcessor *vp, const std::string &key);
+    void setIntentClassifier(std::shared_ptr<IntentClassifier> classifier);
+    void setFusedRouting(bool enabled);
 
     // Server control
     bool start();
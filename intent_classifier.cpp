@@ -0,0 +1,318 @@
+#include "intent_classifier.h"
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <cctype>
+#include <algorithm>
+
+namespace
+{
+    const float kLearningRate = 0.5f;
+    const int kTrainingPasses = 5; // Over the log at startup
+    const long kStatsLogInterval = 25;
+
+    uint64_t hashFeature(char kind, const std::string &text)
+    {
+        uint64_t hash = 1469598103934665603ULL ^ static_cast<unsigned char>(kind);
+        for (unsigned char c : text)
+        {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    double sigmoid(double x)
+    {
+        return 1.0 / (1.0 + std::exp(-x));
+    }
+
+    long elapsedUs(std::chrono::steady_clock::time_point since)
+    {
+        return static_cast<long>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - since).count());
+    }
+} // namespace
+
+IntentOracle planRouteOracle(std::function<std::shared_future<json>()> get_plan)
+{
+    return [get_plan](const std::string &, bool &is_vision)
+    {
+        json response = get_plan().get();
+        if (!response.is_object() || !response.contains("type") || !response["type"].is_string())
+        {
+            return false;
+        }
+        is_vision = response["type"] == "vision_task";
+        std::cout << "🔀 Route from plan: " << (is_vision ? "Vision Task" : "Regular Task")
+                  << " (type: " << response["type"].get<std::string>() << ")" << std::endl;
+        return true;
+    };
+}
+
+IntentClassifier::IntentClassifier() : weights(size_t(1) << kFeatureBits, 0.0f), rng(std::random_device{}()) {}
+
+std::vector<size_t> IntentClassifier::extractFeatures(const std::string &text)
+{
+    // Lowercased words; everything that is not alphanumeric separates them
+    std::vector<std::string> words;
+    std::string current;
+    for (unsigned char c : text)
+    {
+        if (std::isalnum(c))
+        {
+            current += static_cast<char>(std::tolower(c));
+        }
+        else if (!current.empty())
+        {
+            words.push_back(current);
+            current.clear();
+        }
+    }
+    if (!current.empty())
+    {
+        words.push_back(current);
+    }
+
+    const size_t mask = (size_t(1) << kFeatureBits) - 1;
+    std::vector<size_t> features;
+    std::string normalized = " ";
+    for (size_t i = 0; i < words.size(); ++i)
+    {
+        features.push_back(hashFeature('w', words[i]) & mask);
+        if (i + 1 < words.size())
+        {
+            features.push_back(hashFeature('b', words[i] + ' ' + words[i + 1]) & mask);
+        }
+        normalized += words[i] + ' ';
+    }
+    // Character trigrams catch inflections and typos ("clicking", "whatsap")
+    for (size_t i = 0; i + 3 <= normalized.size(); ++i)
+    {
+        features.push_back(hashFeature('c', normalized.substr(i, 3)) & mask);
+    }
+    return features;
+}
+
+void IntentClassifier::train(const std::vector<size_t> &features, bool is_vision)
+{
+    if (features.empty())
+    {
+        return;
+    }
+    const float value = 1.0f / std::sqrt(static_cast<float>(features.size()));
+
+    std::unique_lock<std::shared_mutex> lock(model_mutex);
+    double score = bias;
+    for (size_t feature : features)
+    {
+        score += weights[feature] * value;
+    }
+    float gradient = static_cast<float>((is_vision ? 1.0 : 0.0) - sigmoid(score));
+    for (size_t feature : features)
+    {
+        weights[feature] += kLearningRate * gradient * value;
+    }
+    bias += kLearningRate * gradient * 0.1f;
+}
+
+void IntentClassifier::configure(const IntentClassifierSettings &new_settings)
+{
+    settings = new_settings;
+
+    std::vector<std::pair<std::vector<size_t>, bool>> examples;
+    std::ifstream log(settings.training_log);
+    std::string line;
+    while (std::getline(log, line))
+    {
+        json entry = json::parse(line, nullptr, false);
+        if (entry.is_object() && entry.contains("text") && entry.contains("is_vision_task"))
+        {
+            examples.emplace_back(extractFeatures(entry.value("text", "")), entry.value("is_vision_task", false));
+        }
+    }
+
+    {
+        std::unique_lock<std::shared_mutex> lock(model_mutex);
+        std::fill(weights.begin(), weights.end(), 0.0f);
+        bias = 0.0f;
+        examples_seen = static_cast<long>(examples.size());
+    }
+    for (int pass = 0; pass < kTrainingPasses; ++pass)
+    {
+        {
+            std::lock_guard<std::mutex> lock(log_mutex);
+            std::shuffle(examples.begin(), examples.end(), rng);
+        }
+        for (const auto &example : examples)
+        {
+            train(example.first, example.second);
+        }
+    }
+
+    if (settings.enabled)
+    {
+        std::cout << "🧠 Intent classifier trained on " << examples.size() << " logged intent results"
+                  << (static_cast<int>(examples.size()) < settings.min_training_examples ? " (still deferring to the LLM)" : "") << std::endl;
+    }
+}
+
+IntentClassifier::Prediction IntentClassifier::predict(const std::string &input) const
+{
+    auto started_at = std::chrono::steady_clock::now();
+    std::vector<size_t> features = extractFeatures(input);
+    const float value = features.empty() ? 0.0f : 1.0f / std::sqrt(static_cast<float>(features.size()));
+
+    Prediction prediction;
+    long seen = 0;
+    {
+        std::shared_lock<std::shared_mutex> lock(model_mutex);
+        double score = bias;
+        for (size_t feature : features)
+        {
+            score += weights[feature] * value;
+        }
+        prediction.probability = sigmoid(score);
+        seen = examples_seen;
+    }
+    prediction.is_vision = prediction.probability >= 0.5;
+    double confidence = std::max(prediction.probability, 1.0 - prediction.probability);
+    prediction.confident = settings.enabled && seen >= settings.min_training_examples && confidence >= settings.confidence_threshold;
+
+    predict_time_ns += static_cast<long>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started_at).count());
+    return prediction;
+}
+
+void IntentClassifier::appendToLog(const std::string &input, bool is_vision)
+{
+    if (settings.training_log.empty())
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(log_mutex);
+    std::ofstream log(settings.training_log, std::ios::app);
+    log << json{{"text", input}, {"is_vision_task", is_vision}}.dump() << "\n";
+}
+
+void IntentClassifier::learn(const std::string &input, bool is_vision)
+{
+    train(extractFeatures(input), is_vision);
+    {
+        std::unique_lock<std::shared_mutex> lock(model_mutex);
+        examples_seen++;
+    }
+    appendToLog(input, is_vision);
+}
+
+void IntentClassifier::audit(const std::string &input, const Prediction &prediction, const IntentOracle &ask_intent)
+{
+    {
+        std::lock_guard<std::mutex> lock(log_mutex);
+        if (std::uniform_real_distribution<double>(0.0, 1.0)(rng) >= settings.audit_rate)
+        {
+            return;
+        }
+    }
+    // Off the request path: the caller already has its answer
+    std::shared_ptr<IntentClassifier> self = shared_from_this();
+    std::thread([self, input, prediction, ask_intent]()
+                {
+                    bool llm_is_vision = false;
+                    if (!ask_intent(input, llm_is_vision))
+                    {
+                        return;
+                    }
+                    self->audits++;
+                    if (llm_is_vision == prediction.is_vision)
+                    {
+                        self->audit_agreements++;
+                    }
+                    else
+                    {
+                        std::cout << "🧠 Intent audit disagreed (local p(vision)=" << prediction.probability << ", LLM: "
+                                  << (llm_is_vision ? "vision" : "regular") << ") for: " << input << std::endl;
+                    }
+                    self->learn(input, llm_is_vision); })
+        .detach();
+}
+
+bool IntentClassifier::route(const std::string &input, const IntentOracle &ask_intent, bool &is_vision,
+                             const IntentOracle &ask_plan)
+{
+    Prediction prediction = predict(input);
+    bool decided = false;
+
+    if (prediction.confident)
+    {
+        local_decisions++;
+        is_vision = prediction.is_vision;
+        decided = true;
+        std::cout << "🧠 Local intent classifier: " << (is_vision ? "Vision Task" : "Regular Task")
+                  << " (p(vision): " << (prediction.probability * 100) << "%)" << std::endl;
+        audit(input, prediction, ask_intent);
+    }
+    else if (ask_plan)
+    {
+        // A plan type says what the plan turned out to be, not what the request asked for;
+        // mixing it into the intent labels would train the model on a different question
+        decided = ask_plan(input, is_vision);
+        if (decided)
+        {
+            plan_decisions++;
+        }
+    }
+    else
+    {
+        auto started_at = std::chrono::steady_clock::now();
+        decided = ask_intent(input, is_vision);
+        if (decided)
+        {
+            llm_decisions++;
+            llm_time_us += elapsedUs(started_at);
+            if (is_vision == prediction.is_vision)
+            {
+                llm_agreements++;
+            }
+            if (settings.enabled)
+            {
+                learn(input, is_vision);
+            }
+        }
+    }
+
+    long total = local_decisions + llm_decisions + plan_decisions;
+    if (decided && settings.enabled && total % kStatsLogInterval == 0)
+    {
+        std::cout << "🧠 Intent classifier stats: " << getStats().dump() << std::endl;
+    }
+    return decided;
+}
+
+json IntentClassifier::getStats() const
+{
+    long local = local_decisions, llm = llm_decisions, planned = plan_decisions, audited = audits;
+    double avg_llm_ms = llm > 0 ? llm_time_us / 1000.0 / llm : 0.0;
+    long seen;
+    {
+        std::shared_lock<std::shared_mutex> lock(model_mutex);
+        seen = examples_seen;
+    }
+
+    json stats;
+    stats["enabled"] = settings.enabled;
+    stats["training_examples"] = seen;
+    stats["local_decisions"] = local;
+    stats["llm_decisions"] = llm;
+    stats["plan_decisions"] = planned;
+    stats["local_share"] = (local + llm + planned) > 0 ? static_cast<double>(local) / (local + llm + planned) : 0.0;
+    // Audits sample confident local decisions; llm_agreement covers the unsure ones
+    stats["audits"] = audited;
+    stats["audit_agreement"] = audited > 0 ? static_cast<double>(audit_agreements) / audited : 0.0;
+    stats["llm_agreement"] = llm > 0 ? static_cast<double>(llm_agreements) / llm : 0.0;
+    stats["avg_llm_ms"] = avg_llm_ms;
+    stats["avg_local_us"] = (local + llm + planned) > 0 ? predict_time_ns / 1000.0 / (local + llm + planned) : 0.0;
+    stats["latency_saved_ms"] = local * avg_llm_ms;
+    return stats;
+}
@@ -0,0 +1,99 @@
+#ifndef INTENT_CLASSIFIER_H
+#define INTENT_CLASSIFIER_H
+
+#include "include/json.hpp"
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <functional>
+#include <atomic>
+#include <random>
+#include <future>
+
+using json = nlohmann::json;
+
+struct IntentClassifierSettings
+{
+    bool enabled = true;
+    double confidence_threshold = 0.9; // Route locally when max(p, 1 - p) reaches this
+    int min_training_examples = 50;    // Always ask the LLM until this many labels were seen
+    double audit_rate = 0.05;          // Share of local decisions re-checked by the LLM in the background
+    std::string training_log; // Empty: learn in memory only. Otherwise a JSONL file of raw request texts and labels
+};
+
+// Asks the intent LLM; returns false when it gave no usable answer
+using IntentOracle = std::function<bool(const std::string &input, bool &is_vision)>;
+
+// Fused routing: reads the route from the callAIModel plan (its "type" is
+// vision_task or not) so no separate intent call is made. get_plan is only
+// called when the oracle is asked. False if the plan failed. Its answers are
+// plan types, not intent labels, so IntentClassifier never learns from them.
+IntentOracle planRouteOracle(std::function<std::shared_future<json>()> get_plan);
+
+// Vision/non-vision router that learns from callIntentAI. Requests are turned
+// into hashed word uni/bigram and character trigram features and scored by an
+// online logistic regression, which takes microseconds. Only when the model is
+// unsure (or still untrained) is the intent LLM consulted, and its answer is
+// appended to the training log and learned immediately.
+class IntentClassifier : public std::enable_shared_from_this<IntentClassifier>
+{
+public:
+    struct Prediction
+    {
+        bool is_vision = false;
+        double probability = 0.5; // P(vision)
+        bool confident = false;
+    };
+
+private:
+    static const size_t kFeatureBits = 18;
+
+    IntentClassifierSettings settings;
+
+    mutable std::shared_mutex model_mutex; // Guards weights, bias and examples_seen
+    std::vector<float> weights;
+    float bias = 0.0f;
+    long examples_seen = 0;
+
+    std::mutex log_mutex; // Guards the training log and rng
+    std::mt19937 rng;
+
+    // Decision counters (see getStats)
+    std::atomic<long> local_decisions{0};
+    std::atomic<long> llm_decisions{0};
+    std::atomic<long> llm_agreements{0}; // Unconfident predictions that matched the LLM anyway
+    std::atomic<long> plan_decisions{0};  // Unconfident requests routed by the plan's type (fused routing)
+    std::atomic<long> audits{0};
+    std::atomic<long> audit_agreements{0};
+    std::atomic<long> llm_time_us{0};
+    mutable std::atomic<long> predict_time_ns{0};
+
+    static std::vector<size_t> extractFeatures(const std::string &text);
+    void train(const std::vector<size_t> &features, bool is_vision);
+    void appendToLog(const std::string &input, bool is_vision);
+    void audit(const std::string &input, const Prediction &prediction, const IntentOracle &ask_intent);
+
+public:
+    IntentClassifier();
+
+    // Applies settings and replays the training log (a few passes) into a fresh model
+    void configure(const IntentClassifierSettings &new_settings);
+
+    Prediction predict(const std::string &input) const;
+    void learn(const std::string &input, bool is_vision);
+
+    // Decides whether input is a vision task, asking ask_intent only when the local
+    // model is not confident. Returns false when neither could decide, leaving the
+    // caller's own fallback in charge. With fused routing, ask_plan answers the
+    // unconfident requests instead and is not learned from; training labels and
+    // background audits always come from ask_intent.
+    bool route(const std::string &input, const IntentOracle &ask_intent, bool &is_vision,
+               const IntentOracle &ask_plan = nullptr);
+
+    // Agreement rates and latency saved so far
+    json getStats() const;
+};
+
+#endif // INTENT_CLASSIFIER_H
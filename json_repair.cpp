@@ -0,0 +1,434 @@
+#include "json_repair.h"
+#include "include/json.hpp"
+#include <vector>
+#include <cctype>
+
+namespace
+{
+    enum class Expect
+    {
+        KEY,   // Object: a key or '}'
+        COLON, // Object: ':' after a key
+        VALUE, // Array element, or object value after ':'
+        NEXT   // ',' or the closing bracket
+    };
+
+    struct Frame
+    {
+        char closer;
+        Expect expect;
+        bool has_items = false;
+        size_t last_complete; // Output length after the last complete member/element
+    };
+
+    bool isWordChar(char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$' || c == '-' || c == '+' || c == '.';
+    }
+
+    void appendQuoted(std::string &out, const std::string &raw)
+    {
+        // Model text can hold invalid UTF-8; replace it rather than throw
+        out += nlohmann::json(raw).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+    }
+
+    class Repairer
+    {
+    private:
+        const std::string &text;
+        size_t pos = 0;
+        std::string out;
+        std::vector<Frame> stack;
+        bool done = false;
+
+        // Reads a string starting at its opening quote into raw (unescaped).
+        // Returns false if the text ends first.
+        bool readString(std::string &raw)
+        {
+            char quote = text[pos++];
+            while (pos < text.size())
+            {
+                char c = text[pos++];
+                if (c == quote)
+                {
+                    return true;
+                }
+                if (c != '\\')
+                {
+                    raw += c;
+                    continue;
+                }
+                if (pos >= text.size())
+                {
+                    return false;
+                }
+                char escaped = text[pos++];
+                switch (escaped)
+                {
+                case 'n':
+                    raw += '\n';
+                    break;
+                case 't':
+                    raw += '\t';
+                    break;
+                case 'r':
+                    raw += '\r';
+                    break;
+                case 'b':
+                    raw += '\b';
+                    break;
+                case 'f':
+                    raw += '\f';
+                    break;
+                case 'u':
+                {
+                    if (pos + 4 > text.size())
+                    {
+                        return false;
+                    }
+                    // Let the strict parser decode \uXXXX, trying a surrogate pair first
+                    nlohmann::json decoded;
+                    size_t length = 10;
+                    if (pos + 10 <= text.size() && text.compare(pos + 4, 2, "\\u") == 0)
+                    {
+                        decoded = nlohmann::json::parse("\"\\u" + text.substr(pos, 10) + "\"", nullptr, false);
+                    }
+                    if (!decoded.is_string())
+                    {
+                        decoded = nlohmann::json::parse("\"\\u" + text.substr(pos, 4) + "\"", nullptr, false);
+                        length = 4;
+                    }
+                    if (decoded.is_string())
+                    {
+                        raw += decoded.get<std::string>();
+                        pos += length;
+                    }
+                    else
+                    {
+                        raw += 'u';
+                    }
+                    break;
+                }
+                default:
+                    // \" \\ \/ \' and anything invalid stand for the character itself
+                    raw += escaped;
+                    break;
+                }
+            }
+            return false;
+        }
+
+        std::string readWord()
+        {
+            size_t start = pos;
+            while (pos < text.size() && isWordChar(text[pos]))
+            {
+                pos++;
+            }
+            return text.substr(start, pos - start);
+        }
+
+        void skipComment()
+        {
+            if (text[pos + 1] == '/')
+            {
+                size_t end = text.find('\n', pos);
+                pos = end == std::string::npos ? text.size() : end + 1;
+            }
+            else
+            {
+                size_t end = text.find("*/", pos + 2);
+                pos = end == std::string::npos ? text.size() : end + 2;
+            }
+        }
+
+        // Separates array elements; the comma the model wrote (or forgot) is never copied
+        void beginItem()
+        {
+            if (stack.back().has_items)
+            {
+                out += ',';
+            }
+        }
+
+        // A value finished at the current output position
+        void completeValue()
+        {
+            if (stack.empty())
+            {
+                done = true;
+                return;
+            }
+            Frame &frame = stack.back();
+            frame.has_items = true;
+            frame.expect = Expect::NEXT;
+            frame.last_complete = out.size();
+        }
+
+        void open(char bracket)
+        {
+            out += bracket;
+            Frame frame;
+            frame.closer = bracket == '{' ? '}' : ']';
+            frame.expect = bracket == '{' ? Expect::KEY : Expect::VALUE;
+            frame.last_complete = out.size();
+            stack.push_back(frame);
+        }
+
+        void close()
+        {
+            Frame &frame = stack.back();
+            // A key without a value ({"a":}) or a dangling comma is dropped
+            out.resize(frame.last_complete);
+            out += frame.closer;
+            stack.pop_back();
+            completeValue();
+        }
+
+        void scalarValue(const std::string &json_text)
+        {
+            if (stack.back().closer == ']')
+            {
+                beginItem();
+            }
+            out += json_text;
+            completeValue();
+        }
+
+        void wordValue(const std::string &word)
+        {
+            std::string lower = word;
+            for (char &c : lower)
+            {
+                c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+            if (lower == "true" || lower == "false" || lower == "null")
+            {
+                scalarValue(lower);
+            }
+            else if (lower == "none" || lower == "nan" || lower == "undefined" || lower == "infinity" || lower == "-infinity")
+            {
+                scalarValue("null");
+            }
+            else if (nlohmann::json::accept(word))
+            {
+                scalarValue(word); // A number
+            }
+            else
+            {
+                std::string quoted;
+                appendQuoted(quoted, word);
+                scalarValue(quoted);
+            }
+        }
+
+        // One token in the context of the innermost container
+        bool step()
+        {
+            char c = text[pos];
+            Frame &frame = stack.back();
+
+            if (frame.expect == Expect::KEY || (frame.closer == '}' && frame.expect == Expect::NEXT && c != ',' && c != '}'))
+            {
+                // A key, possibly after a missing comma
+                if (c == '}')
+                {
+                    pos++;
+                    close();
+                    return true;
+                }
+                if (c == ']')
+                {
+                    pos++;
+                    close(); // Wrong bracket type; close what is open
+                    return true;
+                }
+                std::string key;
+                if (c == '"' || c == '\'')
+                {
+                    if (!readString(key))
+                    {
+                        return false;
+                    }
+                }
+                else if (isWordChar(c))
+                {
+                    key = readWord();
+                }
+                else
+                {
+                    pos++; // Stray character
+                    return true;
+                }
+                if (frame.has_items)
+                {
+                    out += ',';
+                }
+                appendQuoted(out, key);
+                frame.expect = Expect::COLON;
+                return true;
+            }
+
+            if (frame.expect == Expect::COLON)
+            {
+                out += ':';
+                frame.expect = Expect::VALUE;
+                if (c == ':' || c == '=')
+                {
+                    pos++;
+                }
+                return true;
+            }
+
+            if (frame.expect == Expect::NEXT)
+            {
+                if (c == ',')
+                {
+                    pos++;
+                    frame.expect = frame.closer == '}' ? Expect::KEY : Expect::VALUE;
+                    return true;
+                }
+                if (c == '}' || c == ']')
+                {
+                    pos++;
+                    close();
+                    return true;
+                }
+                // Missing comma between array elements: treat as the next element
+                frame.expect = Expect::VALUE;
+            }
+
+            // Expect::VALUE
+            switch (c)
+            {
+            case ',':
+                pos++; // [1,,2]
+                return true;
+            case '}':
+            case ']':
+                pos++;
+                close();
+                return true;
+            case ':':
+                pos++;
+                return true;
+            case '{':
+            case '[':
+                if (frame.closer == ']')
+                {
+                    beginItem();
+                }
+                pos++;
+                open(c);
+                return true;
+            case '"':
+            case '\'':
+            {
+                std::string value;
+                if (!readString(value))
+                {
+                    return false;
+                }
+                std::string quoted;
+                appendQuoted(quoted, value);
+                scalarValue(quoted);
+                return true;
+            }
+            default:
+                break;
+            }
+            if (isWordChar(c))
+            {
+                std::string word = readWord();
+                if (pos >= text.size())
+                {
+                    return false; // A number or literal may have been cut short
+                }
+                if (word[0] == '+')
+                {
+                    word.erase(0, 1);
+                }
+                if (!word.empty() && word[0] == '.')
+                {
+                    word = "0" + word;
+                }
+                if (!word.empty() && word.back() == '.')
+                {
+                    word += "0";
+                }
+                wordValue(word);
+                return true;
+            }
+            pos++; // Stray character
+            return true;
+        }
+
+    public:
+        explicit Repairer(const std::string &text) : text(text) {}
+
+        bool run(std::string &repaired, bool *truncated)
+        {
+            pos = text.find_first_of("{[");
+            if (pos == std::string::npos)
+            {
+                return false;
+            }
+            open(text[pos++]);
+
+            bool complete = true;
+            while (!done)
+            {
+                while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos])))
+                {
+                    pos++;
+                }
+                if (pos >= text.size())
+                {
+                    complete = false;
+                    break;
+                }
+                if (text[pos] == '/' && pos + 1 < text.size() && (text[pos + 1] == '/' || text[pos + 1] == '*'))
+                {
+                    skipComment();
+                    continue;
+                }
+                if (!step())
+                {
+                    complete = false;
+                    break;
+                }
+            }
+
+            if (!complete)
+            {
+                // An array keeps only whole elements: drop a partly written element
+                // (a UI element without its bbox, a plan step without its action)
+                for (size_t i = 0; i + 1 < stack.size(); ++i)
+                {
+                    if (stack[i].closer == ']')
+                    {
+                        stack.resize(i + 1);
+                        break;
+                    }
+                }
+                // Cut back to the last complete item and close everything still open
+                while (!stack.empty())
+                {
+                    close();
+                }
+            }
+            if (truncated)
+            {
+                *truncated = !complete;
+            }
+            repaired = std::move(out);
+            return true;
+        }
+    };
+} // namespace
+
+bool repairJson(const std::string &text, std::string &repaired, bool *truncated)
+{
+    Repairer repairer(text);
+    return repairer.run(repaired, truncated);
+}
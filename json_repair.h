@@ -0,0 +1,23 @@
+#ifndef JSON_REPAIR_H
+#define JSON_REPAIR_H
+
+#include <string>
+
+// Rewrites almost-JSON from model output into strict JSON in one pass over the
+// text. Skips any prose before the first '{' or '[' and everything after the
+// value closes. Fixes the mistakes models actually make:
+//   - trailing commas, doubled commas and missing commas between items
+//   - // and /* */ comments
+//   - unquoted or single-quoted keys and strings, Python True/False/None
+//   - raw newlines and invalid escapes inside strings
+//   - output cut off by max_tokens: every open bracket is closed after the last
+//     complete item. A partly written array element is dropped whole while an
+//     object keeps the members that arrived, so an elements array keeps every
+//     UI element that arrived in full and an action object keeps its complete
+//     fields for the schema to judge
+//
+// Returns false if no value could be recovered. truncated, when given, is set
+// when the text ended before the value did.
+bool repairJson(const std::string &text, std::string &repaired, bool *truncated = nullptr);
+
+#endif // JSON_REPAIR_H
@@ -0,0 +1,203 @@
+#include "llm_backend.h"
+#include <iostream>
+
+const char *LLMBackendRouter::kDefaultBackend = "openrouter";
+
+LLMBackendRouter &LLMBackendRouter::instance()
+{
+    static LLMBackendRouter router;
+    return router;
+}
+
+bool LLMBackendRouter::addBackend(const LLMBackendConfig &config)
+{
+    if (config.url.empty() || config.name.empty() || config.name == kDefaultBackend)
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(router_mutex);
+    if (backends.count(config.name))
+    {
+        return false;
+    }
+    Backend &backend = backends[config.name];
+    backend.config = config;
+    backend.client = std::make_unique<LLMClient>(config.limits);
+    // One cassette file covers the whole session, whichever backend served a call
+    backend.client->shareCassetteWith(LLMClient::instance());
+    return true;
+}
+
+bool LLMBackendRouter::setRoute(LLMCallType type, const std::string &backend_name)
+{
+    std::lock_guard<std::mutex> lock(router_mutex);
+    if (backend_name == kDefaultBackend)
+    {
+        routes.erase(type);
+        return true;
+    }
+    auto it = backends.find(backend_name);
+    if (it == backends.end())
+    {
+        return false;
+    }
+    routes[type] = &it->second;
+    std::cout << "🔌 LLM " << llmCallTypeName(type) << " calls go to backend '" << backend_name << "' ("
+              << it->second.config.url << ")" << std::endl;
+    return true;
+}
+
+LLMBackendRouter::Backend *LLMBackendRouter::backendFor(LLMCallType type) const
+{
+    std::lock_guard<std::mutex> lock(router_mutex);
+    auto it = routes.find(type);
+    return it == routes.end() ? nullptr : it->second;
+}
+
+void LLMBackendRouter::setDefaultStructuredOutput(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(router_mutex);
+    default_structured_output = enabled;
+}
+
+bool LLMBackendRouter::addProfile(const LLMProfile &profile)
+{
+    if (profile.name.empty())
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(router_mutex);
+    return profiles.emplace(profile.name, profile).second;
+}
+
+bool LLMBackendRouter::setProfile(LLMCallType type, const std::string &profile_name)
+{
+    std::lock_guard<std::mutex> lock(router_mutex);
+    if (profile_name.empty())
+    {
+        call_profiles.erase(type);
+        return true;
+    }
+    auto it = profiles.find(profile_name);
+    if (it == profiles.end())
+    {
+        return false;
+    }
+    call_profiles[type] = &it->second;
+    return true;
+}
+
+LLMProfile LLMBackendRouter::profileFor(LLMCallType type) const
+{
+    std::lock_guard<std::mutex> lock(router_mutex);
+    auto it = call_profiles.find(type);
+    return it == call_profiles.end() ? LLMProfile() : *it->second;
+}
+
+void LLMBackendRouter::apply(json &body, LLMRequest &request) const
+{
+    const Backend *backend = backendFor(request.call_type);
+    LLMProfile profile = profileFor(request.call_type);
+    bool structured_output;
+    {
+        std::lock_guard<std::mutex> lock(router_mutex);
+        structured_output = backend ? backend->config.structured_output : default_structured_output;
+    }
+
+    if (!profile.model.empty())
+    {
+        body["model"] = profile.model;
+    }
+    if (profile.max_tokens > 0)
+    {
+        body["max_tokens"] = profile.max_tokens;
+    }
+    if (profile.temperature >= 0.0)
+    {
+        body["temperature"] = profile.temperature;
+    }
+    if (profile.timeout_ms > 0)
+    {
+        request.timeout_ms = profile.timeout_ms;
+    }
+    // OpenRouter's reasoning parameter; other servers may reject unknown fields
+    if (profile.strip_reasoning && !backend)
+    {
+        body["reasoning"] = {{"exclude", true}};
+    }
+
+    if (!structured_output)
+    {
+        body.erase("response_format");
+    }
+    if (backend)
+    {
+        request.url = backend->config.url;
+        request.api_key = backend->config.api_key;
+        if (!backend->config.model.empty())
+        {
+            body["model"] = backend->config.model;
+        }
+    }
+    if (body.contains("model") && body["model"].is_string())
+    {
+        request.model = body["model"].get<std::string>();
+    }
+}
+
+bool LLMBackendRouter::isRouted(LLMCallType type) const
+{
+    return backendFor(type) != nullptr;
+}
+
+LLMClient &LLMBackendRouter::clientFor(LLMCallType type) const
+{
+    const Backend *backend = backendFor(type);
+    return backend ? *backend->client : LLMClient::instance();
+}
+
+std::future<LLMResponse> LLMBackendRouter::submit(LLMRequest request) const
+{
+    LLMClient &client = clientFor(request.call_type);
+    return client.submit(std::move(request));
+}
+
+LLMResponse LLMBackendRouter::perform(LLMRequest request) const
+{
+    return submit(std::move(request)).get();
+}
+
+std::vector<LLMClient *> LLMBackendRouter::allClients() const
+{
+    std::vector<LLMClient *> clients = {&LLMClient::instance()};
+    std::lock_guard<std::mutex> lock(router_mutex);
+    for (const auto &entry : backends)
+    {
+        clients.push_back(entry.second.client.get());
+    }
+    return clients;
+}
+
+json LLMBackendRouter::describeRoutes() const
+{
+    json description = json::object();
+    std::lock_guard<std::mutex> lock(router_mutex);
+    for (LLMCallType type : {LLMCallType::INTENT, LLMCallType::PLANNING, LLMCallType::VISION_STEP,
+                             LLMCallType::CONTENT_GENERATION, LLMCallType::SCREEN_ANALYSIS, LLMCallType::CHAT})
+    {
+        auto it = routes.find(type);
+        description[llmCallTypeName(type)] = it == routes.end() ? std::string(kDefaultBackend) : it->second->config.name;
+    }
+    return description;
+}
+
+json LLMBackendRouter::describeProfiles() const
+{
+    json description = json::object();
+    std::lock_guard<std::mutex> lock(router_mutex);
+    for (const auto &entry : call_profiles)
+    {
+        description[llmCallTypeName(entry.first)] = entry.second->name;
+    }
+    return description;
+}
@@ -0,0 +1,110 @@
+#ifndef LLM_BACKEND_H
+#define LLM_BACKEND_H
+
+#include "llm_client.h"
+#include "include/json.hpp"
+#include <string>
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <future>
+
+using json = nlohmann::json;
+
+// An OpenAI-compatible chat completions server other than OpenRouter, e.g. a
+// llama.cpp server running on this machine's CPU.
+struct LLMBackendConfig
+{
+    std::string name;
+    std::string url;     // Full chat completions endpoint
+    std::string api_key; // Empty for servers without auth; the OpenRouter key is never sent here
+    std::string model;   // Replaces the "model" of every request routed here when set
+    bool structured_output = true; // Honours response_format json_schema (llama.cpp server does)
+    LLMConnectionLimits limits;
+};
+
+// Model and output budget for a class of calls, so a yes/no intent check does
+// not pay for the long reasoning a full plan needs. Unset fields leave what
+// the call site built untouched.
+struct LLMProfile
+{
+    std::string name;
+    std::string model;          // Replaces "model" when set (a routed backend's own model still wins)
+    int max_tokens = 0;         // 0: no limit
+    double temperature = -1.0;  // Negative: keep the call site's temperature
+    long timeout_ms = 0;        // Overrides the call policy deadline when > 0
+    bool strip_reasoning = false; // Asks OpenRouter to leave reasoning out and drops <think> blocks from content
+};
+
+// Chooses where each call type goes. Call types without a route use
+// LLMClient::instance() and the OpenRouter URL, key and model the call site
+// built. A routed call type goes through its backend's own LLMClient, so it
+// has a separate connection pool and concurrency limit and never queues behind
+// slow remote calls (or the other way round).
+//
+// Each call type can also have an LLMProfile, applied before the backend.
+//
+// Configure backends, routes and profiles at startup, before the first call.
+class LLMBackendRouter
+{
+private:
+    struct Backend
+    {
+        LLMBackendConfig config;
+        std::unique_ptr<LLMClient> client;
+    };
+
+    mutable std::mutex router_mutex;
+    std::map<std::string, Backend> backends;
+    std::map<LLMCallType, Backend *> routes;
+    std::map<std::string, LLMProfile> profiles;
+    std::map<LLMCallType, const LLMProfile *> call_profiles;
+    bool default_structured_output = true; // Whether OpenRouter requests keep response_format
+
+    LLMBackendRouter() = default;
+
+    Backend *backendFor(LLMCallType type) const;
+
+public:
+    static const char *kDefaultBackend; // "openrouter"
+
+    static LLMBackendRouter &instance();
+
+    // False if the name is already taken or the url is empty
+    bool addBackend(const LLMBackendConfig &config);
+    // backend_name is a name passed to addBackend, or kDefaultBackend
+    bool setRoute(LLMCallType type, const std::string &backend_name);
+
+    void setDefaultStructuredOutput(bool enabled);
+
+    // False if the name is empty or already taken
+    bool addProfile(const LLMProfile &profile);
+    // profile_name is a name passed to addProfile; an empty name removes the assignment
+    bool setProfile(LLMCallType type, const std::string &profile_name);
+    // The call type's profile, or a default one that changes nothing
+    LLMProfile profileFor(LLMCallType type) const;
+
+    // Applies the call type's profile to a request built for OpenRouter, then
+    // points it at the backend of its call type: url, api key and the "model"
+    // field of body. Drops response_format when the backend cannot take it.
+    // request.model ends up as the body's model, for rate limiting.
+    void apply(json &body, LLMRequest &request) const;
+
+    // True when the call type goes to a backend other than OpenRouter
+    bool isRouted(LLMCallType type) const;
+    // The client whose pool serves the call type
+    LLMClient &clientFor(LLMCallType type) const;
+    std::future<LLMResponse> submit(LLMRequest request) const;
+    LLMResponse perform(LLMRequest request) const;
+
+    // Every client, the default one first, for settings that apply to all of them
+    std::vector<LLMClient *> allClients() const;
+
+    // {"call_type": "backend name", ...} for every call type
+    json describeRoutes() const;
+    // {"call_type": "profile name", ...} for call types that have a profile
+    json describeProfiles() const;
+};
+
+#endif // LLM_BACKEND_H
@@ -0,0 +1,260 @@
+#include "llm_cassette.h"
+#include "include/json.hpp"
+#include <iostream>
+#include <cstdint>
+#include <cstdio>
+
+using json = nlohmann::json;
+
+namespace
+{
+    const char kMagic[4] = {'L', 'L', 'M', 'C'};
+    const uint8_t kVersion = 1;
+
+    // 64-bit FNV-1a, fed incrementally so file segments never have to be held in memory
+    struct Fnv1a
+    {
+        uint64_t hash = 1469598103934665603ULL;
+
+        void update(const void *data, size_t length)
+        {
+            const unsigned char *bytes = static_cast<const unsigned char *>(data);
+            for (size_t i = 0; i < length; ++i)
+            {
+                hash ^= bytes[i];
+                hash *= 1099511628211ULL;
+            }
+        }
+
+        void update(const std::string &text)
+        {
+            update(text.data(), text.size());
+            update("\0", 1); // Field separator so "ab"+"c" differs from "a"+"bc"
+        }
+    };
+
+    void writeLength(std::ofstream &out, uint32_t length)
+    {
+        unsigned char bytes[4] = {static_cast<unsigned char>(length), static_cast<unsigned char>(length >> 8),
+                                  static_cast<unsigned char>(length >> 16), static_cast<unsigned char>(length >> 24)};
+        out.write(reinterpret_cast<const char *>(bytes), 4);
+    }
+
+    bool readLength(std::ifstream &in, uint32_t &length)
+    {
+        unsigned char bytes[4];
+        if (!in.read(reinterpret_cast<char *>(bytes), 4))
+        {
+            return false;
+        }
+        length = uint32_t(bytes[0]) | (uint32_t(bytes[1]) << 8) | (uint32_t(bytes[2]) << 16) | (uint32_t(bytes[3]) << 24);
+        return true;
+    }
+} // namespace
+
+bool parseCassetteMode(const std::string &name, CassetteMode &mode)
+{
+    if (name == "off")
+        mode = CassetteMode::OFF;
+    else if (name == "record")
+        mode = CassetteMode::RECORD;
+    else if (name == "replay")
+        mode = CassetteMode::REPLAY;
+    else
+        return false;
+    return true;
+}
+
+bool LLMCassette::open(CassetteMode new_mode, const std::string &path, bool use_recorded_latency)
+{
+    std::lock_guard<std::mutex> lock(cassette_mutex);
+    mode = CassetteMode::OFF;
+    replay_latency = use_recorded_latency;
+    entries.clear();
+    by_fingerprint.clear();
+    sequence_cursor.clear();
+    if (out.is_open())
+    {
+        out.close();
+    }
+
+    if (new_mode == CassetteMode::RECORD)
+    {
+        out.open(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+        {
+            std::cerr << "❌ Could not open LLM cassette for recording: " << path << std::endl;
+            return false;
+        }
+        out.write(kMagic, sizeof(kMagic));
+        out.put(static_cast<char>(kVersion));
+        out.flush();
+        std::cout << "📼 Recording LLM traffic to " << path << std::endl;
+    }
+    else if (new_mode == CassetteMode::REPLAY)
+    {
+        if (!load(path))
+        {
+            return false;
+        }
+        std::cout << "📼 Replaying " << entries.size() << " recorded LLM responses from " << path
+                  << (replay_latency ? " (with recorded latencies)" : "") << std::endl;
+    }
+    mode = new_mode;
+    return true;
+}
+
+bool LLMCassette::load(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    char magic[4];
+    if (!in.is_open() || !in.read(magic, 4) || std::string(magic, 4) != std::string(kMagic, 4) || in.get() != kVersion)
+    {
+        std::cerr << "❌ Could not open LLM cassette for replay (missing or not a v" << int(kVersion) << " cassette): " << path << std::endl;
+        return false;
+    }
+
+    uint32_t length = 0;
+    std::vector<uint8_t> buffer;
+    while (readLength(in, length))
+    {
+        buffer.resize(length);
+        if (!in.read(reinterpret_cast<char *>(buffer.data()), length))
+        {
+            std::cerr << "⚠️ LLM cassette truncated after " << entries.size() << " records" << std::endl;
+            break;
+        }
+        json record = json::from_cbor(buffer, true, false);
+        if (record.is_discarded() || !record.is_object())
+        {
+            std::cerr << "⚠️ Skipping unreadable LLM cassette record " << entries.size() << std::endl;
+            continue;
+        }
+
+        Entry entry;
+        entry.fingerprint = record.value("fp", "");
+        if (!parseLLMCallType(record.value("type", ""), entry.call_type))
+        {
+            entry.call_type = LLMCallType::PLANNING;
+        }
+        entry.response.transport_ok = record.value("ok", false);
+        entry.response.http_status = record.value("status", 0L);
+        entry.response.latency_ms = record.value("latency_ms", 0.0);
+        entry.response.body = record.value("body", "");
+        entry.response.error = record.value("error", "");
+        entry.response.attempts = 1;
+        by_fingerprint.emplace(entry.fingerprint, entries.size());
+        entries.push_back(std::move(entry));
+    }
+    return true;
+}
+
+CassetteMode LLMCassette::getMode()
+{
+    std::lock_guard<std::mutex> lock(cassette_mutex);
+    return mode;
+}
+
+bool LLMCassette::replaysLatency()
+{
+    std::lock_guard<std::mutex> lock(cassette_mutex);
+    return replay_latency;
+}
+
+void LLMCassette::record(const std::string &fingerprint, LLMCallType call_type, const LLMResponse &response)
+{
+    json record = {
+        {"fp", fingerprint},
+        {"type", llmCallTypeName(call_type)},
+        {"ok", response.transport_ok},
+        {"status", response.http_status},
+        {"latency_ms", response.latency_ms},
+        {"body", response.body}};
+    if (!response.error.empty())
+    {
+        record["error"] = response.error;
+    }
+    std::vector<uint8_t> bytes = json::to_cbor(record);
+
+    std::lock_guard<std::mutex> lock(cassette_mutex);
+    if (mode != CassetteMode::RECORD)
+    {
+        return;
+    }
+    writeLength(out, static_cast<uint32_t>(bytes.size()));
+    out.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    out.flush(); // A crashed session still leaves every completed call on disk
+}
+
+bool LLMCassette::lookup(const std::string &fingerprint, LLMCallType call_type, LLMResponse &response)
+{
+    std::lock_guard<std::mutex> lock(cassette_mutex);
+
+    // Identical request: take the first unused recording of it
+    auto range = by_fingerprint.equal_range(fingerprint);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        Entry &entry = entries[it->second];
+        if (!entry.used)
+        {
+            entry.used = true;
+            response = entry.response;
+            return true;
+        }
+    }
+
+    // Otherwise the next unused recording of this call type, in session order
+    size_t &cursor = sequence_cursor[call_type];
+    for (; cursor < entries.size(); ++cursor)
+    {
+        Entry &entry = entries[cursor];
+        if (entry.call_type == call_type && !entry.used)
+        {
+            entry.used = true;
+            response = entry.response;
+            ++cursor;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string LLMCassette::fingerprint(const LLMRequest &request)
+{
+    Fnv1a hasher;
+    hasher.update(request.url);
+    hasher.update(std::string(llmCallTypeName(request.call_type)));
+    if (request.body_segments.empty())
+    {
+        hasher.update(request.body);
+    }
+    for (const LLMBodySegment &segment : request.body_segments)
+    {
+        switch (segment.kind)
+        {
+        case LLMBodySegment::Kind::TEXT:
+            hasher.update(segment.text);
+            break;
+        case LLMBodySegment::Kind::BASE64_BUFFER:
+            if (segment.buffer)
+            {
+                hasher.update(segment.buffer->data(), segment.buffer->size());
+            }
+            break;
+        case LLMBodySegment::Kind::BASE64_FILE:
+        {
+            std::ifstream file(segment.file_path, std::ios::binary);
+            char chunk[64 * 1024];
+            while (file.read(chunk, sizeof(chunk)) || file.gcount() > 0)
+            {
+                hasher.update(chunk, static_cast<size_t>(file.gcount()));
+            }
+            break;
+        }
+        }
+    }
+
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hasher.hash));
+    return hex;
+}
@@ -0,0 +1,67 @@
+#ifndef LLM_CASSETTE_H
+#define LLM_CASSETTE_H
+
+#include "llm_client.h"
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+
+enum class CassetteMode
+{
+    OFF,
+    RECORD, // Every completed call is appended to the cassette
+    REPLAY  // Calls are answered from the cassette; nothing goes over the network
+};
+
+bool parseCassetteMode(const std::string &name, CassetteMode &mode);
+
+// On-disk record of LLM traffic so whole agent sessions can be re-run offline
+// and benchmarked deterministically.
+//
+// File format: the magic "LLMC" and a version byte, then records, each a
+// little-endian uint32 length followed by that many bytes of CBOR:
+//   {"fp": fingerprint, "type": call type, "ok": transport_ok, "status": http
+//    status, "latency_ms": original latency, "body": response body, "error": text}
+//
+// Replay matches a request by fingerprint first. Requests whose bodies differ
+// between runs (screenshots, timestamps) fall back to the next unused record of
+// the same call type, in recorded order. Identical calls coalesced while
+// recording are stored once per caller, so each gets its own record on replay.
+class LLMCassette
+{
+private:
+    struct Entry
+    {
+        std::string fingerprint;
+        LLMCallType call_type;
+        LLMResponse response;
+        bool used = false;
+    };
+
+    std::mutex cassette_mutex;
+    CassetteMode mode = CassetteMode::OFF;
+    bool replay_latency = false;
+    std::ofstream out;
+    std::vector<Entry> entries;                                 // REPLAY
+    std::multimap<std::string, size_t> by_fingerprint;          // REPLAY
+    std::map<LLMCallType, size_t> sequence_cursor;              // REPLAY, next index to try per type
+
+    bool load(const std::string &path);
+
+public:
+    // Opens (RECORD truncates) the cassette file. Returns false and stays OFF on failure.
+    bool open(CassetteMode new_mode, const std::string &path, bool use_recorded_latency);
+
+    CassetteMode getMode();
+    bool replaysLatency();
+
+    void record(const std::string &fingerprint, LLMCallType call_type, const LLMResponse &response);
+    bool lookup(const std::string &fingerprint, LLMCallType call_type, LLMResponse &response);
+
+    // Stable hash of URL, call type and body (streamed segments included)
+    static std::string fingerprint(const LLMRequest &request);
+};
+
+#endif // LLM_CASSETTE_H
@@ -0,0 +1,1203 @@
+#include "llm_client.h"
+#include "base64.h"
+#include "llm_cassette.h"
+#include "llm_metrics.h"
+#include "llm_response.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+using Clock = std::chrono::steady_clock;
+
+// One logical LLM call. It may turn into several transfers (retries, a hedge).
+struct LLMClient::Call
+{
+    LLMRequest request;
+    LLMCallback on_complete;
+    LLMCallPolicy policy;
+    Clock::time_point started_at;
+    Clock::time_point deadline;
+    int attempts = 0;
+    int retries = 0;
+    int in_flight = 0;
+    bool hedged = false;
+    bool done = false;
+    bool admitted = false;      // Holds one of the client's max_concurrent_calls slots
+    double queue_ms = 0.0;      // Submission to first attempt: slot and rate-limit waits
+    std::vector<CURL *> easies; // Transfers currently in flight for this call
+    std::string fingerprint;    // Set only while a cassette is recording or replaying
+    bool replay = false;        // Answered from the cassette instead of the network
+    LLMResponse replayed;
+    int64_t bytes_sent = 0; // Request body bytes over all attempts
+    bool streamed = false;  // Part of a response already went to on_body_data; no retry or hedge now
+    size_t body_hash = 0;   // Set when identical calls may join this one
+    bool coalescible = false;
+    std::vector<LLMCallback> followers; // Identical calls waiting on this one (guarded by queue_mutex)
+};
+
+namespace
+{
+    const size_t kBodyChunkBytes = 48 * 1024; // Raw bytes per read; a multiple of 3 so chunks encode without padding
+
+    // Produces a request body from its segments on demand for CURLOPT_READFUNCTION.
+    // Memory use is one raw chunk plus at most one encoded chunk, whatever the image size.
+    class BodyReader
+    {
+    private:
+        const std::vector<LLMBodySegment> *segments;
+        size_t segment_index = 0;
+        size_t offset = 0; // Into the current TEXT or BASE64_BUFFER segment
+        std::ifstream file;
+        std::vector<unsigned char> raw_chunk;
+        std::string carry; // Encoded bytes that did not fit in curl's buffer last time
+        size_t carry_pos = 0;
+
+        size_t readRaw(const LLMBodySegment &segment, size_t want)
+        {
+            if (segment.kind == LLMBodySegment::Kind::BASE64_BUFFER)
+            {
+                size_t available = segment.buffer ? segment.buffer->size() - offset : 0;
+                size_t count = std::min(want, available);
+                if (count > 0)
+                {
+                    std::memcpy(raw_chunk.data(), segment.buffer->data() + offset, count);
+                    offset += count;
+                }
+                return count;
+            }
+
+            if (!file.is_open())
+            {
+                file.open(segment.file_path, std::ios::binary);
+                if (!file.is_open())
+                {
+                    failed = true;
+                    return 0;
+                }
+            }
+            file.read(reinterpret_cast<char *>(raw_chunk.data()), static_cast<std::streamsize>(want));
+            return static_cast<size_t>(file.gcount());
+        }
+
+        void nextSegment()
+        {
+            segment_index++;
+            offset = 0;
+            if (file.is_open())
+            {
+                file.close();
+            }
+        }
+
+    public:
+        bool failed = false;
+
+        explicit BodyReader(const std::vector<LLMBodySegment> *segments) : segments(segments), raw_chunk(kBodyChunkBytes) {}
+
+        void rewind()
+        {
+            segment_index = 0;
+            offset = 0;
+            if (file.is_open())
+            {
+                file.close();
+            }
+            file.clear();
+            carry.clear();
+            carry_pos = 0;
+            failed = false;
+        }
+
+        size_t read(char *out, size_t max_bytes)
+        {
+            size_t written = 0;
+            while (written < max_bytes && !failed)
+            {
+                if (carry_pos < carry.size())
+                {
+                    size_t count = std::min(max_bytes - written, carry.size() - carry_pos);
+                    std::memcpy(out + written, carry.data() + carry_pos, count);
+                    carry_pos += count;
+                    written += count;
+                    continue;
+                }
+                if (segment_index >= segments->size())
+                {
+                    break;
+                }
+
+                const LLMBodySegment &segment = (*segments)[segment_index];
+                size_t space = max_bytes - written;
+                if (segment.kind == LLMBodySegment::Kind::TEXT)
+                {
+                    size_t count = std::min(space, segment.text.size() - offset);
+                    std::memcpy(out + written, segment.text.data() + offset, count);
+                    offset += count;
+                    written += count;
+                    if (offset >= segment.text.size())
+                    {
+                        nextSegment();
+                    }
+                    continue;
+                }
+
+                // Encode straight into curl's buffer when it has room, else via carry
+                size_t want = std::min(space >= 4 ? (space / 4) * 3 : 3, kBodyChunkBytes);
+                size_t got = readRaw(segment, want);
+                if (got == 0)
+                {
+                    if (!failed)
+                    {
+                        nextSegment();
+                    }
+                    continue;
+                }
+                size_t encoded_length = base64Length(got);
+                if (encoded_length <= space)
+                {
+                    encodeBase64(raw_chunk.data(), got, out + written);
+                    written += encoded_length;
+                }
+                else
+                {
+                    carry.resize(encoded_length);
+                    encodeBase64(raw_chunk.data(), got, &carry[0]);
+                    carry_pos = 0;
+                }
+            }
+            return written;
+        }
+    };
+
+    size_t ReadCallback(char *buffer, size_t size, size_t nitems, void *userdata)
+    {
+        BodyReader *reader = static_cast<BodyReader *>(userdata);
+        size_t count = reader->read(buffer, size * nitems);
+        return reader->failed ? CURL_READFUNC_ABORT : count;
+    }
+
+    // curl rewinds the body when it has to resend it (redirects, connection reuse races)
+    int SeekCallback(void *userdata, curl_off_t offset, int origin)
+    {
+        if (offset != 0 || origin != SEEK_SET)
+        {
+            return CURL_SEEKFUNC_CANTSEEK;
+        }
+        static_cast<BodyReader *>(userdata)->rewind();
+        return CURL_SEEKFUNC_OK;
+    }
+
+    // Upload size of a segmented body, or -1 if a file segment is unreadable
+    curl_off_t streamedBodyLength(const std::vector<LLMBodySegment> &segments)
+    {
+        curl_off_t total = 0;
+        for (const LLMBodySegment &segment : segments)
+        {
+            switch (segment.kind)
+            {
+            case LLMBodySegment::Kind::TEXT:
+                total += static_cast<curl_off_t>(segment.text.size());
+                break;
+            case LLMBodySegment::Kind::BASE64_BUFFER:
+                total += static_cast<curl_off_t>(base64Length(segment.buffer ? segment.buffer->size() : 0));
+                break;
+            case LLMBodySegment::Kind::BASE64_FILE:
+            {
+                std::error_code ec;
+                std::uintmax_t file_size = std::filesystem::file_size(segment.file_path, ec);
+                if (ec)
+                {
+                    return -1;
+                }
+                total += static_cast<curl_off_t>(base64Length(static_cast<size_t>(file_size)));
+                break;
+            }
+            }
+        }
+        return total;
+    }
+
+    // CURLOPT_WRITEDATA for a call with LLMRequest::on_body_data. The body is
+    // collected as usual; pieces of a 2xx response are also passed on.
+    struct BodyTap
+    {
+        std::string *body = nullptr;
+        CURL *easy = nullptr;
+        const std::function<void(const char *, size_t)> *on_data = nullptr;
+        bool *streamed = nullptr; // The call's flag
+    };
+
+    size_t TapWriteCallback(void *contents, size_t size, size_t nmemb, BodyTap *tap)
+    {
+        size_t total_size = size * nmemb;
+        tap->body->append(static_cast<char *>(contents), total_size);
+        long status = 0;
+        curl_easy_getinfo(tap->easy, CURLINFO_RESPONSE_CODE, &status);
+        if (status >= 200 && status < 300)
+        {
+            *tap->streamed = true;
+            (*tap->on_data)(static_cast<char *>(contents), total_size);
+        }
+        return total_size;
+    }
+} // namespace
+
+struct LLMClient::Transfer
+{
+    std::shared_ptr<Call> call;
+    CURL *easy = nullptr;
+    curl_slist *headers = nullptr;
+    std::string response_body;
+    std::unique_ptr<BodyReader> body_reader; // Only for segmented bodies
+    BodyTap tap;                             // Only for streamed responses
+    Clock::time_point started_at;
+};
+
+namespace
+{
+    const size_t kLatencyWindow = 100;  // Samples kept per call type for the p95
+    const size_t kMinHedgeSamples = 20; // Don't hedge until the p95 means something
+    const long kConnectTimeoutMs = 10000;
+
+    size_t WriteCallback(void *contents, size_t size, size_t nmemb, std::string *output)
+    {
+        size_t total_size = size * nmemb;
+        output->append(static_cast<char *>(contents), total_size);
+        return total_size;
+    }
+
+    double elapsedMs(Clock::time_point since)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+    }
+
+    long remainingMs(Clock::time_point deadline)
+    {
+        return static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count());
+    }
+
+    bool isRetryable(const LLMResponse &response)
+    {
+        return !response.transport_ok || response.http_status == 429 || response.http_status >= 500;
+    }
+
+    void recordCallMetrics(LLMCallType call_type, const LLMResponse &response, int64_t bytes_sent, bool replayed, double queue_ms)
+    {
+        LLMCallRecord record;
+        record.finished_at_ms = static_cast<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                         std::chrono::system_clock::now().time_since_epoch())
+                                                         .count());
+        CompletionUsage usage;
+        if (response.transport_ok && parseUsage(response.body, usage))
+        {
+            record.prompt_tokens = usage.prompt_tokens;
+            record.completion_tokens = usage.completion_tokens;
+        }
+        record.bytes_sent = bytes_sent;
+        record.bytes_received = static_cast<int64_t>(response.body.size());
+        record.latency_ms = response.latency_ms;
+        record.queue_ms = queue_ms;
+        record.call_type = static_cast<int32_t>(call_type);
+        record.http_status = static_cast<int32_t>(response.http_status);
+        record.attempts = response.attempts;
+        record.transport_ok = response.transport_ok;
+        record.hedged = response.hedged;
+        record.replayed = replayed;
+        LLMMetrics::instance().record(record);
+    }
+
+    std::string describeFailure(const LLMResponse &response)
+    {
+        return response.transport_ok ? "HTTP " + std::to_string(response.http_status) : response.error;
+    }
+
+    std::map<LLMCallType, LLMCallPolicy> defaultPolicies()
+    {
+        std::map<LLMCallType, LLMCallPolicy> defaults;
+
+        LLMCallPolicy intent;
+        intent.deadline_ms = 15000;
+        intent.hedge = true;
+        intent.priority = 0;
+        defaults[LLMCallType::INTENT] = intent;
+
+        LLMCallPolicy planning;
+        planning.deadline_ms = 60000;
+        defaults[LLMCallType::PLANNING] = planning;
+
+        LLMCallPolicy vision_step;
+        vision_step.deadline_ms = 30000;
+        vision_step.hedge = true;
+        vision_step.priority = 0;
+        defaults[LLMCallType::VISION_STEP] = vision_step;
+
+        LLMCallPolicy content_generation;
+        content_generation.deadline_ms = 90000;
+        content_generation.priority = 2; // Background work; yields to the next UI action
+        defaults[LLMCallType::CONTENT_GENERATION] = content_generation;
+
+        // Screenshots are large uploads; one retry is plenty and hedging would double them
+        LLMCallPolicy screen_analysis;
+        screen_analysis.deadline_ms = 45000;
+        screen_analysis.max_retries = 1;
+        screen_analysis.priority = 0; // Feeds the next vision step
+        defaults[LLMCallType::SCREEN_ANALYSIS] = screen_analysis;
+
+        LLMCallPolicy chat;
+        chat.deadline_ms = 60000;
+        chat.max_retries = 1;
+        defaults[LLMCallType::CHAT] = chat;
+
+        return defaults;
+    }
+} // namespace
+
+LLMBodySegment LLMBodySegment::fromText(std::string text)
+{
+    LLMBodySegment segment;
+    segment.kind = Kind::TEXT;
+    segment.text = std::move(text);
+    return segment;
+}
+
+LLMBodySegment LLMBodySegment::fromFile(std::string file_path)
+{
+    LLMBodySegment segment;
+    segment.kind = Kind::BASE64_FILE;
+    segment.file_path = std::move(file_path);
+    return segment;
+}
+
+LLMBodySegment LLMBodySegment::fromBuffer(std::shared_ptr<const std::vector<unsigned char>> buffer)
+{
+    LLMBodySegment segment;
+    segment.kind = Kind::BASE64_BUFFER;
+    segment.buffer = std::move(buffer);
+    return segment;
+}
+
+bool buildStreamedBody(const std::string &envelope, const std::string &placeholder, const std::string &prefix,
+                       LLMBodySegment insert, std::vector<LLMBodySegment> &segments)
+{
+    std::string quoted = "\"" + placeholder + "\"";
+    size_t pos = envelope.find(quoted);
+    if (pos == std::string::npos)
+    {
+        return false;
+    }
+    segments.clear();
+    segments.push_back(LLMBodySegment::fromText(envelope.substr(0, pos + 1) + prefix));
+    segments.push_back(std::move(insert));
+    segments.push_back(LLMBodySegment::fromText(envelope.substr(pos + quoted.size() - 1)));
+    return true;
+}
+
+const char *llmCallTypeName(LLMCallType type)
+{
+    switch (type)
+    {
+    case LLMCallType::INTENT:
+        return "intent";
+    case LLMCallType::PLANNING:
+        return "planning";
+    case LLMCallType::VISION_STEP:
+        return "vision_step";
+    case LLMCallType::CONTENT_GENERATION:
+        return "content_generation";
+    case LLMCallType::SCREEN_ANALYSIS:
+        return "screen_analysis";
+    case LLMCallType::CHAT:
+        return "chat";
+    }
+    return "unknown";
+}
+
+bool parseLLMCallType(const std::string &name, LLMCallType &type)
+{
+    static const LLMCallType all_types[] = {LLMCallType::INTENT, LLMCallType::PLANNING, LLMCallType::VISION_STEP,
+                                            LLMCallType::CONTENT_GENERATION, LLMCallType::SCREEN_ANALYSIS, LLMCallType::CHAT};
+    for (LLMCallType candidate : all_types)
+    {
+        if (name == llmCallTypeName(candidate))
+        {
+            type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+LLMClient::LLMClient(const LLMConnectionLimits &limits)
+    : limits(limits), running(true), policies(defaultPolicies()), cassette(std::make_shared<LLMCassette>()), rng(std::random_device{}())
+{
+    curl_global_init(CURL_GLOBAL_ALL);
+    multi_handle = curl_multi_init();
+    // Let concurrent requests to the same host share one HTTP/2 connection
+    curl_multi_setopt(multi_handle, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    if (limits.max_host_connections > 0)
+    {
+        // Extra transfers queue inside curl until a connection frees up
+        curl_multi_setopt(multi_handle, CURLMOPT_MAX_HOST_CONNECTIONS, limits.max_host_connections);
+    }
+
+    event_thread = std::thread(&LLMClient::eventLoop, this);
+}
+
+LLMClient::~LLMClient()
+{
+    running.store(false);
+    curl_multi_wakeup(multi_handle);
+    if (event_thread.joinable())
+    {
+        event_thread.join();
+    }
+    curl_multi_cleanup(multi_handle);
+    curl_global_cleanup();
+}
+
+LLMClient &LLMClient::instance()
+{
+    static LLMClient client;
+    return client;
+}
+
+void LLMClient::setCallPolicy(LLMCallType type, const LLMCallPolicy &policy)
+{
+    std::lock_guard<std::mutex> lock(policy_mutex);
+    policies[type] = policy;
+}
+
+LLMCallPolicy LLMClient::getCallPolicy(LLMCallType type)
+{
+    std::lock_guard<std::mutex> lock(policy_mutex);
+    return policies[type];
+}
+
+void LLMClient::setCircuitBreakerSettings(const CircuitBreakerSettings &settings)
+{
+    std::lock_guard<std::mutex> lock(policy_mutex);
+    breaker_settings = settings;
+}
+
+void LLMClient::setRateLimit(const std::string &host, const LLMRateLimit &limit)
+{
+    rate_limiter.setLimit(host, limit);
+}
+
+LLMCassette &LLMClient::getCassette()
+{
+    return *cassette;
+}
+
+void LLMClient::shareCassetteWith(LLMClient &other)
+{
+    cassette = other.cassette;
+}
+
+std::future<LLMResponse> LLMClient::submit(LLMRequest request)
+{
+    auto promise = std::make_shared<std::promise<LLMResponse>>();
+    std::future<LLMResponse> result = promise->get_future();
+    submit(std::move(request), [promise](LLMResponse response)
+           { promise->set_value(std::move(response)); });
+    return result;
+}
+
+void LLMClient::submit(LLMRequest request, LLMCallback on_complete)
+{
+    auto call = std::make_shared<Call>();
+    call->request = std::move(request);
+    call->on_complete = std::move(on_complete);
+    call->policy = getCallPolicy(call->request.call_type);
+    call->started_at = Clock::now();
+    long budget_ms = call->request.timeout_ms > 0 ? call->request.timeout_ms : call->policy.deadline_ms;
+    call->deadline = call->started_at + std::chrono::milliseconds(budget_ms);
+
+    CassetteMode cassette_mode = cassette->getMode();
+    if (cassette_mode != CassetteMode::OFF)
+    {
+        call->fingerprint = LLMCassette::fingerprint(call->request);
+    }
+
+    LLMResponse rejected;
+    if (cassette_mode == CassetteMode::REPLAY)
+    {
+        if (!cassette->lookup(call->fingerprint, call->request.call_type, call->replayed))
+        {
+            rejected.error = std::string("No recorded ") + llmCallTypeName(call->request.call_type) + " response left in the cassette";
+        }
+        else if (!cassette->replaysLatency())
+        {
+            rejected = call->replayed;
+            rejected.attempts = 1;
+        }
+        else
+        {
+            call->replay = true;
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            pending.push_back(call);
+        }
+    }
+    else
+    {
+        hashForCoalescing(*call);
+        // Looking for an identical call and becoming the one others join is a single step.
+        // Otherwise two identical calls submitted together could both miss and both go out.
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        if (joinIdenticalCall(call))
+        {
+            lock.unlock();
+            LLMMetrics::instance().recordCoalesced(call->request.call_type);
+            return;
+        }
+        if (!allowCall(call->request.call_type))
+        {
+            rejected.error = std::string("Circuit breaker open for ") + llmCallTypeName(call->request.call_type) + " calls";
+        }
+        else if (running.load())
+        {
+            pending.push_back(call);
+            if (call->coalescible)
+            {
+                coalescible_calls.emplace(call->body_hash, call);
+            }
+        }
+        else
+        {
+            rejected.error = "LLM client is shutting down";
+        }
+    }
+
+    if (!call->replay && (!rejected.error.empty() || cassette_mode == CassetteMode::REPLAY))
+    {
+        // Rejected, or replayed without delay: complete on the caller's thread
+        call->done = true;
+        if (cassette_mode != CassetteMode::REPLAY)
+        {
+            rejected.latency_ms = elapsedMs(call->started_at);
+        }
+        recordCallMetrics(call->request.call_type, rejected, 0, cassette_mode == CassetteMode::REPLAY, 0.0);
+        try
+        {
+            call->on_complete(std::move(rejected));
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "LLM completion callback threw: " << e.what() << std::endl;
+        }
+        return;
+    }
+    curl_multi_wakeup(multi_handle);
+}
+
+void LLMClient::hashForCoalescing(Call &call)
+{
+    // Screenshots streamed from disk are never byte-identical in practice; don't hash them.
+    // A streamed reply goes to one caller's on_body_data only.
+    if (!call.request.body_segments.empty() || call.request.on_body_data)
+    {
+        return;
+    }
+    call.coalescible = true;
+    call.body_hash = std::hash<std::string>()(call.request.body);
+}
+
+bool LLMClient::joinIdenticalCall(const std::shared_ptr<Call> &call)
+{
+    if (!call->coalescible)
+    {
+        return false;
+    }
+    auto range = coalescible_calls.equal_range(call->body_hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        const Call &leader = *it->second;
+        if (leader.request.call_type == call->request.call_type && leader.request.url == call->request.url &&
+            leader.request.body == call->request.body)
+        {
+            it->second->followers.push_back(std::move(call->on_complete));
+            return true;
+        }
+    }
+    return false;
+}
+
+LLMResponse LLMClient::perform(LLMRequest request)
+{
+    return submit(std::move(request)).get();
+}
+
+void LLMClient::eventLoop()
+{
+    while (running.load())
+    {
+        std::deque<std::shared_ptr<Call>> incoming;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            incoming.swap(pending);
+        }
+        for (auto &call : incoming)
+        {
+            if (call->replay)
+            {
+                long delay_ms = static_cast<long>(call->replayed.latency_ms);
+                timers.emplace(call->started_at + std::chrono::milliseconds(delay_ms), Timer{call, Timer::Kind::REPLAY});
+            }
+            else
+            {
+                enqueueWaiting(call);
+            }
+        }
+        admitWaiting();
+        runDueTimers();
+
+        int still_running = 0;
+        curl_multi_perform(multi_handle, &still_running);
+
+        int messages_left = 0;
+        while (CURLMsg *msg = curl_multi_info_read(multi_handle, &messages_left))
+        {
+            if (msg->msg == CURLMSG_DONE)
+            {
+                finishTransfer(msg->easy_handle, msg->data.result);
+            }
+        }
+        // Hand slots freed by finished calls on now rather than after the next poll
+        admitWaiting();
+
+        // Sleeps until socket activity, a curl timeout, a retry/hedge timer, a
+        // rate-limit token for a waiting call or curl_multi_wakeup() from submit()
+        long wait_ms = nextTimerDelayMs(1000);
+        if (!waiting.empty() && next_admission != Clock::time_point())
+        {
+            long admission_ms = static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(next_admission - Clock::now()).count()) + 1;
+            wait_ms = std::max(0L, std::min(wait_ms, admission_ms));
+        }
+        curl_multi_poll(multi_handle, nullptr, 0, static_cast<int>(wait_ms), nullptr);
+    }
+
+    // Fail everything still queued, waiting on a timer or in flight so no caller waits forever
+    std::vector<std::shared_ptr<Call>> leftovers;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        leftovers.assign(pending.begin(), pending.end());
+        pending.clear();
+    }
+    leftovers.insert(leftovers.end(), waiting.begin(), waiting.end());
+    waiting.clear();
+    for (auto &entry : active_transfers)
+    {
+        leftovers.push_back(entry.second->call);
+    }
+    for (auto &entry : timers)
+    {
+        leftovers.push_back(entry.second.call);
+    }
+    timers.clear();
+    for (auto &call : leftovers)
+    {
+        LLMResponse response;
+        response.error = "LLM client is shutting down";
+        finishCall(call, std::move(response));
+    }
+}
+
+void LLMClient::enqueueWaiting(const std::shared_ptr<Call> &call)
+{
+    // Behind every older call of the same or higher priority; a retry keeps its place by age
+    auto position = std::find_if(waiting.begin(), waiting.end(), [&call](const std::shared_ptr<Call> &queued)
+                                 { return queued->policy.priority > call->policy.priority ||
+                                          (queued->policy.priority == call->policy.priority && queued->started_at > call->started_at); });
+    waiting.insert(position, call);
+}
+
+void LLMClient::admitWaiting()
+{
+    // Calls whose deadline passed while queued fail without ever taking a slot
+    for (auto it = waiting.begin(); it != waiting.end();)
+    {
+        if (remainingMs((*it)->deadline) > 0)
+        {
+            ++it;
+            continue;
+        }
+        std::shared_ptr<Call> call = *it;
+        it = waiting.erase(it);
+        LLMResponse response;
+        response.error = "Deadline exceeded while waiting for a free connection slot or rate-limit token";
+        finishCall(call, std::move(response));
+    }
+
+    // A call whose bucket is empty does not hold up calls bound for other providers or models
+    Clock::time_point now = Clock::now();
+    next_admission = Clock::time_point();
+    for (auto it = waiting.begin(); it != waiting.end();)
+    {
+        std::shared_ptr<Call> call = *it;
+        // A queued retry already holds its slot
+        if (!call->admitted && limits.max_concurrent_calls > 0 && admitted_calls >= limits.max_concurrent_calls)
+        {
+            ++it;
+            continue;
+        }
+        Clock::time_point ready_at;
+        if (!rate_limiter.tryAcquire(call->request.url, call->request.model, now, ready_at))
+        {
+            if (next_admission == Clock::time_point() || ready_at < next_admission)
+            {
+                next_admission = ready_at;
+            }
+            ++it;
+            continue;
+        }
+        it = waiting.erase(it);
+        if (!call->admitted)
+        {
+            call->admitted = true;
+            call->queue_ms = elapsedMs(call->started_at);
+            admitted_calls++;
+        }
+        startAttempt(call);
+    }
+}
+
+void LLMClient::startAttempt(const std::shared_ptr<Call> &call)
+{
+    long remaining_ms = remainingMs(call->deadline);
+    if (remaining_ms <= 0)
+    {
+        if (call->in_flight == 0)
+        {
+            LLMResponse response;
+            response.error = "Deadline exceeded";
+            finishCall(call, std::move(response));
+        }
+        return;
+    }
+
+    CURL *easy = curl_easy_init();
+    if (!easy)
+    {
+        std::cerr << "Failed to initialize curl handle for LLM request" << std::endl;
+        if (call->in_flight == 0)
+        {
+            LLMResponse response;
+            response.error = "Failed to initialize curl";
+            finishCall(call, std::move(response));
+        }
+        return;
+    }
+
+    auto transfer = std::make_unique<Transfer>();
+    transfer->call = call;
+    transfer->easy = easy;
+    transfer->started_at = Clock::now();
+    transfer->headers = curl_slist_append(transfer->headers, "Content-Type: application/json");
+    if (!call->request.api_key.empty())
+    {
+        std::string auth_header = "Authorization: Bearer " + call->request.api_key;
+        transfer->headers = curl_slist_append(transfer->headers, auth_header.c_str());
+    }
+    // Large bodies would otherwise wait a round trip (or up to a second) for 100 Continue
+    transfer->headers = curl_slist_append(transfer->headers, "Expect:");
+
+    // The body lives in the Call, which outlives all of its transfers
+    curl_easy_setopt(easy, CURLOPT_URL, call->request.url.c_str());
+    if (call->request.body_segments.empty())
+    {
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDS, call->request.body.c_str());
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(call->request.body.size()));
+        call->bytes_sent += static_cast<int64_t>(call->request.body.size());
+    }
+    else
+    {
+        curl_off_t body_length = streamedBodyLength(call->request.body_segments);
+        if (body_length < 0)
+        {
+            std::cerr << "Failed to read streamed LLM request body" << std::endl;
+            curl_slist_free_all(transfer->headers);
+            curl_easy_cleanup(easy);
+            if (call->in_flight == 0)
+            {
+                LLMResponse response;
+                response.error = "Failed to read request body file";
+                finishCall(call, std::move(response));
+            }
+            return;
+        }
+        // Known length keeps it a plain Content-Length upload rather than chunked
+        transfer->body_reader = std::make_unique<BodyReader>(&call->request.body_segments);
+        curl_easy_setopt(easy, CURLOPT_POST, 1L);
+        curl_easy_setopt(easy, CURLOPT_READFUNCTION, ReadCallback);
+        curl_easy_setopt(easy, CURLOPT_READDATA, transfer->body_reader.get());
+        curl_easy_setopt(easy, CURLOPT_SEEKFUNCTION, SeekCallback);
+        curl_easy_setopt(easy, CURLOPT_SEEKDATA, transfer->body_reader.get());
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE_LARGE, body_length);
+        call->bytes_sent += static_cast<int64_t>(body_length);
+    }
+    curl_easy_setopt(easy, CURLOPT_HTTPHEADER, transfer->headers);
+    if (call->request.on_body_data)
+    {
+        transfer->tap.body = &transfer->response_body;
+        transfer->tap.easy = easy;
+        transfer->tap.on_data = &call->request.on_body_data;
+        transfer->tap.streamed = &call->streamed;
+        curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, TapWriteCallback);
+        curl_easy_setopt(easy, CURLOPT_WRITEDATA, &transfer->tap);
+    }
+    else
+    {
+        curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, WriteCallback);
+        curl_easy_setopt(easy, CURLOPT_WRITEDATA, &transfer->response_body);
+    }
+    curl_easy_setopt(easy, CURLOPT_ACCEPT_ENCODING, ""); // Any encoding curl was built with
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_2TLS));
+    if (call->request.url.rfind("https://", 0) == 0)
+    {
+        // Wait for a connection that may multiplex rather than opening a new one. Only
+        // worthwhile over TLS; plain http stays HTTP/1.1 and would just serialize.
+        curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+    }
+    // Each attempt may only use what is left of the call's deadline
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, remaining_ms);
+    curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, std::min(remaining_ms, kConnectTimeoutMs));
+
+    CURLMcode add_result = curl_multi_add_handle(multi_handle, easy);
+    if (add_result != CURLM_OK)
+    {
+        std::cerr << "curl_multi_add_handle() failed: " << curl_multi_strerror(add_result) << std::endl;
+        curl_slist_free_all(transfer->headers);
+        curl_easy_cleanup(easy);
+        if (call->in_flight == 0)
+        {
+            LLMResponse response;
+            response.error = curl_multi_strerror(add_result);
+            finishCall(call, std::move(response));
+        }
+        return;
+    }
+
+    call->attempts++;
+    call->in_flight++;
+    call->easies.push_back(easy);
+    active_transfers[easy] = std::move(transfer);
+
+    // A second copy of a streamed reply would interleave with the first
+    if (call->attempts == 1 && call->policy.hedge && !call->request.on_body_data)
+    {
+        long hedge_delay_ms = hedgeDelayMs(*call);
+        if (hedge_delay_ms > 0 && hedge_delay_ms < remaining_ms)
+        {
+            timers.emplace(Clock::now() + std::chrono::milliseconds(hedge_delay_ms), Timer{call, Timer::Kind::HEDGE});
+        }
+    }
+}
+
+void LLMClient::finishTransfer(CURL *easy, CURLcode result)
+{
+    auto it = active_transfers.find(easy);
+    if (it == active_transfers.end())
+    {
+        return;
+    }
+    std::unique_ptr<Transfer> transfer = std::move(it->second);
+    active_transfers.erase(it);
+    std::shared_ptr<Call> call = transfer->call;
+
+    LLMResponse response;
+    response.transport_ok = (result == CURLE_OK);
+    long retry_after_ms = 0;
+    if (response.transport_ok)
+    {
+        curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &response.http_status);
+#if LIBCURL_VERSION_NUM >= 0x074200
+        // Parses both the delay-seconds and HTTP-date forms of Retry-After
+        curl_off_t retry_after_s = 0;
+        if (curl_easy_getinfo(easy, CURLINFO_RETRY_AFTER, &retry_after_s) == CURLE_OK && retry_after_s > 0)
+        {
+            retry_after_ms = static_cast<long>(retry_after_s) * 1000;
+        }
+#endif
+    }
+    else
+    {
+        response.error = curl_easy_strerror(result);
+    }
+    response.body = std::move(transfer->response_body);
+    if (response.transport_ok)
+    {
+        rate_limiter.onResponse(call->request.url, call->request.model, response.http_status, retry_after_ms, Clock::now());
+        if (response.http_status == 429)
+        {
+            LLMMetrics::instance().recordRateLimited(call->request.call_type);
+        }
+    }
+
+    curl_multi_remove_handle(multi_handle, easy);
+    curl_easy_cleanup(easy);
+    curl_slist_free_all(transfer->headers);
+    call->in_flight--;
+    call->easies.erase(std::remove(call->easies.begin(), call->easies.end(), easy), call->easies.end());
+
+    if (call->done)
+    {
+        return;
+    }
+
+    // Once part of a reply has been streamed out, a retry would repeat it
+    if (!isRetryable(response) || call->streamed)
+    {
+        if (response.http_status >= 200 && response.http_status < 300)
+        {
+            recordLatency(call->request.call_type, elapsedMs(transfer->started_at));
+        }
+        finishCall(call, std::move(response));
+        return;
+    }
+
+    // A hedge is still running; let it decide the outcome
+    if (call->in_flight > 0)
+    {
+        return;
+    }
+
+    if (call->retries < call->policy.max_retries)
+    {
+        long delay_ms = backoffMs(*call, retry_after_ms);
+        if (delay_ms < remainingMs(call->deadline))
+        {
+            call->retries++;
+            std::cerr << "⚠️ LLM " << llmCallTypeName(call->request.call_type) << " call failed (" << describeFailure(response)
+                      << "), retry " << call->retries << "/" << call->policy.max_retries << " in " << delay_ms << " ms" << std::endl;
+            timers.emplace(Clock::now() + std::chrono::milliseconds(delay_ms), Timer{call, Timer::Kind::RETRY});
+            return;
+        }
+        // Waiting (e.g. for Retry-After) would blow the deadline, so fail now
+    }
+    finishCall(call, std::move(response));
+}
+
+void LLMClient::runDueTimers()
+{
+    Clock::time_point now = Clock::now();
+    while (!timers.empty() && timers.begin()->first <= now)
+    {
+        Timer timer = timers.begin()->second;
+        timers.erase(timers.begin());
+        std::shared_ptr<Call> &call = timer.call;
+        if (call->done)
+        {
+            continue;
+        }
+        if (timer.kind == Timer::Kind::REPLAY)
+        {
+            call->attempts = 1;
+            finishCall(call, call->replayed);
+        }
+        else if (timer.kind == Timer::Kind::HEDGE)
+        {
+            // A hedge is optional; never spend a rate-limit token the bucket does not have
+            Clock::time_point ready_at;
+            if (call->in_flight == 1 && !call->hedged &&
+                rate_limiter.tryAcquire(call->request.url, call->request.model, now, ready_at))
+            {
+                call->hedged = true;
+                std::cout << "🔀 LLM " << llmCallTypeName(call->request.call_type) << " call slower than p95, sending hedge request" << std::endl;
+                startAttempt(call);
+            }
+        }
+        else
+        {
+            // A retry waits for its bucket too, queued by priority with calls not yet started
+            Clock::time_point ready_at;
+            if (remainingMs(call->deadline) > 0 &&
+                !rate_limiter.tryAcquire(call->request.url, call->request.model, now, ready_at))
+            {
+                enqueueWaiting(call);
+                continue;
+            }
+            startAttempt(call);
+        }
+    }
+}
+
+long LLMClient::nextTimerDelayMs(long cap_ms) const
+{
+    if (timers.empty())
+    {
+        return cap_ms;
+    }
+    long delay_ms = static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(timers.begin()->first - Clock::now()).count());
+    return std::max(0L, std::min(delay_ms, cap_ms));
+}
+
+void LLMClient::cancelAttempts(Call &call)
+{
+    for (CURL *easy : call.easies)
+    {
+        auto it = active_transfers.find(easy);
+        if (it == active_transfers.end())
+        {
+            continue;
+        }
+        curl_multi_remove_handle(multi_handle, easy);
+        curl_easy_cleanup(easy);
+        curl_slist_free_all(it->second->headers);
+        active_transfers.erase(it);
+    }
+    call.easies.clear();
+    call.in_flight = 0;
+}
+
+void LLMClient::finishCall(const std::shared_ptr<Call> &call, LLMResponse response)
+{
+    if (call->done)
+    {
+        return;
+    }
+    call->done = true;
+    cancelAttempts(*call);
+    if (call->admitted)
+    {
+        call->admitted = false;
+        admitted_calls--;
+    }
+
+    std::vector<LLMCallback> followers;
+    if (call->coalescible)
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        auto range = coalescible_calls.equal_range(call->body_hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == call)
+            {
+                coalescible_calls.erase(it);
+                break;
+            }
+        }
+        followers.swap(call->followers);
+    }
+
+    response.latency_ms = elapsedMs(call->started_at);
+    response.attempts = call->attempts;
+    response.hedged = call->hedged;
+    recordCallMetrics(call->request.call_type, response, call->bytes_sent, call->replay, call->queue_ms);
+    if (!call->replay)
+    {
+        recordOutcome(call->request.call_type, !isRetryable(response));
+        if (!call->fingerprint.empty())
+        {
+            // One record per caller: replay does not coalesce, so each identical call looks up its own
+            for (size_t i = 0; i <= followers.size(); ++i)
+            {
+                cassette->record(call->fingerprint, call->request.call_type, response);
+            }
+        }
+    }
+
+    for (LLMCallback &follower : followers)
+    {
+        try
+        {
+            follower(response);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "LLM completion callback threw: " << e.what() << std::endl;
+        }
+    }
+    try
+    {
+        call->on_complete(std::move(response));
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "LLM completion callback threw: " << e.what() << std::endl;
+    }
+}
+
+long LLMClient::backoffMs(const Call &call, long retry_after_ms)
+{
+    // Full jitter: uniform in [0, min(cap, base * 2^retries)]
+    long ceiling_ms = call.policy.base_backoff_ms;
+    for (int i = 0; i < call.retries && ceiling_ms < call.policy.max_backoff_ms; ++i)
+    {
+        ceiling_ms *= 2;
+    }
+    ceiling_ms = std::min(ceiling_ms, call.policy.max_backoff_ms);
+    std::uniform_int_distribution<long> jitter(0, std::max(0L, ceiling_ms));
+    return std::max(jitter(rng), retry_after_ms);
+}
+
+long LLMClient::hedgeDelayMs(const Call &call) const
+{
+    auto it = latency_samples.find(call.request.call_type);
+    if (it == latency_samples.end() || it->second.size() < kMinHedgeSamples)
+    {
+        return -1;
+    }
+    std::vector<double> sorted(it->second.begin(), it->second.end());
+    size_t p95_index = (sorted.size() * 95) / 100;
+    std::nth_element(sorted.begin(), sorted.begin() + p95_index, sorted.end());
+    return std::max(static_cast<long>(sorted[p95_index]), call.policy.hedge_min_delay_ms);
+}
+
+void LLMClient::recordLatency(LLMCallType type, double latency_ms)
+{
+    std::deque<double> &samples = latency_samples[type];
+    samples.push_back(latency_ms);
+    if (samples.size() > kLatencyWindow)
+    {
+        samples.pop_front();
+    }
+}
+
+bool LLMClient::allowCall(LLMCallType type)
+{
+    std::lock_guard<std::mutex> lock(policy_mutex);
+    Breaker &breaker = breakers[type];
+    if (!breaker.open)
+    {
+        return true;
+    }
+    // Half-open: once the cool-down is over let exactly one probe through
+    if (Clock::now() >= breaker.open_until && !breaker.probe_in_flight)
+    {
+        breaker.probe_in_flight = true;
+        return true;
+    }
+    return false;
+}
+
+void LLMClient::recordOutcome(LLMCallType type, bool success)
+{
+    std::lock_guard<std::mutex> lock(policy_mutex);
+    Breaker &breaker = breakers[type];
+    if (success)
+    {
+        if (breaker.open)
+        {
+            std::cout << "✅ LLM " << llmCallTypeName(type) << " circuit breaker closed" << std::endl;
+        }
+        breaker = Breaker();
+        return;
+    }
+
+    breaker.consecutive_failures++;
+    if (breaker.probe_in_flight || breaker.consecutive_failures >= breaker_settings.failure_threshold)
+    {
+        if (!breaker.open || breaker.probe_in_flight)
+        {
+            std::cerr << "🚫 LLM " << llmCallTypeName(type) << " circuit breaker open for "
+                      << breaker_settings.open_ms << " ms after " << breaker.consecutive_failures << " failed calls" << std::endl;
+        }
+        breaker.open = true;
+        breaker.probe_in_flight = false;
+        breaker.open_until = Clock::now() + std::chrono::milliseconds(breaker_settings.open_ms);
+    }
+}
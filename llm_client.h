@@ -0,0 +1,238 @@
+#ifndef LLM_CLIENT_H
+#define LLM_CLIENT_H
+
+#include "llm_rate_limiter.h"
+#include <curl/curl.h>
+#include <string>
+#include <deque>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <memory>
+#include <chrono>
+#include <random>
+
+// What an LLM call is for. Policies (deadline, retries, hedging) and circuit
+// breakers are tracked per call type.
+enum class LLMCallType
+{
+    INTENT,
+    PLANNING,
+    VISION_STEP,
+    CONTENT_GENERATION,
+    SCREEN_ANALYSIS,
+    CHAT
+};
+
+const char *llmCallTypeName(LLMCallType type);
+bool parseLLMCallType(const std::string &name, LLMCallType &type);
+
+struct LLMCallPolicy
+{
+    long deadline_ms = 60000;       // Overall budget for the call, retries included
+    int max_retries = 2;            // Extra attempts after the first one
+    long base_backoff_ms = 500;     // First retry waits up to this long (full jitter)
+    long max_backoff_ms = 8000;     // Cap for the exponential backoff
+    bool hedge = false;             // Send a second request if the first is slower than p95
+    long hedge_min_delay_ms = 2000; // Never hedge earlier than this
+    int priority = 1;               // Lower goes first when calls queue for a slot or a rate-limit token
+};
+
+// Connection pool size and admission control for one LLMClient. 0 means unlimited.
+struct LLMConnectionLimits
+{
+    int max_concurrent_calls = 0;  // Calls past this wait in FIFO order for a free slot
+    long max_host_connections = 0; // CURLMOPT_MAX_HOST_CONNECTIONS
+};
+
+struct CircuitBreakerSettings
+{
+    int failure_threshold = 5; // Consecutive failed calls before the breaker opens
+    long open_ms = 30000;      // How long to fail fast before letting a probe through
+};
+
+// One piece of a streamed request body. BASE64_FILE and BASE64_BUFFER are
+// base64-encoded on the fly while curl uploads, so a multi-megabyte image is
+// never held as a base64 string, a data URL or a json DOM.
+struct LLMBodySegment
+{
+    enum class Kind
+    {
+        TEXT,
+        BASE64_FILE,
+        BASE64_BUFFER
+    };
+
+    Kind kind = Kind::TEXT;
+    std::string text;                                         // TEXT
+    std::string file_path;                                    // BASE64_FILE
+    std::shared_ptr<const std::vector<unsigned char>> buffer; // BASE64_BUFFER
+
+    static LLMBodySegment fromText(std::string text);
+    static LLMBodySegment fromFile(std::string file_path);
+    static LLMBodySegment fromBuffer(std::shared_ptr<const std::vector<unsigned char>> buffer);
+};
+
+// Splits a serialized JSON envelope at a placeholder string value (quotes
+// included in the search) and puts `insert` between the two halves, wrapped
+// in quotes again. `prefix` is emitted inside the quotes before it, e.g.
+// "data:image/png;base64,". Returns false if the placeholder is not found.
+bool buildStreamedBody(const std::string &envelope, const std::string &placeholder, const std::string &prefix,
+                       LLMBodySegment insert, std::vector<LLMBodySegment> &segments);
+
+// A single chat-completions style HTTP POST
+struct LLMRequest
+{
+    std::string url;
+    std::string api_key; // Sent as a Bearer token; no Authorization header when empty
+    std::string body;                          // Serialized JSON payload
+    std::vector<LLMBodySegment> body_segments; // Streamed instead of body when non-empty
+    LLMCallType call_type = LLMCallType::PLANNING;
+    long timeout_ms = 0; // Overrides the policy deadline when > 0
+    std::string model;   // Picks the rate-limit bucket; LLMBackendRouter::apply copies it from the body
+    // Called on the client's event thread with each piece of a 2xx body as it
+    // arrives, for "stream": true requests. Once a piece has been passed on the
+    // call is no longer retried or hedged. The full body still ends up in the
+    // LLMResponse; a cassette replay delivers only that.
+    std::function<void(const char *data, size_t length)> on_body_data;
+};
+
+struct LLMResponse
+{
+    bool transport_ok = false; // false when curl itself failed (DNS, TLS, timeout, shutdown...)
+    long http_status = 0;
+    std::string body;
+    std::string error; // curl error text when transport_ok is false
+    double latency_ms = 0.0;
+    int attempts = 0;   // Requests actually sent, hedges included
+    bool hedged = false;
+};
+
+class LLMCassette;
+
+// Invoked on the client's event thread - keep it short and never block in it
+using LLMCallback = std::function<void(LLMResponse)>;
+
+// Non-blocking LLM client. One event thread drives every transfer through a
+// single curl multi handle, so any number of requests can be in flight without
+// a thread per request, and connections (HTTP/2 multiplexed where the server
+// supports it) are reused across calls.
+//
+// Each call gets a deadline, bounded retries with jittered exponential backoff
+// on transport errors, 429 and 5xx (honouring Retry-After), optional hedging
+// and a per-call-type circuit breaker that fails fast while a backend is down.
+//
+// Calls identical to one already in flight (same call type, URL and body) do
+// not go out again: they wait for that call and get a copy of its response,
+// so they also share its deadline and retries. Streamed calls never join one.
+//
+// Before its first attempt a call waits for a connection slot and a token from
+// its provider/model rate-limit bucket (see LLMRateLimiter). Waiting calls are
+// served by policy priority, oldest first within a priority, so interactive
+// calls overtake queued background work instead of drawing 429s alongside it.
+class LLMClient
+{
+private:
+    struct Call;
+    struct Transfer;
+    struct Breaker
+    {
+        int consecutive_failures = 0;
+        bool open = false;
+        bool probe_in_flight = false;
+        std::chrono::steady_clock::time_point open_until;
+    };
+    struct Timer
+    {
+        enum class Kind
+        {
+            RETRY,
+            HEDGE,
+            REPLAY // Deliver a cassette response after its recorded latency
+        };
+        std::shared_ptr<Call> call;
+        Kind kind;
+    };
+
+    CURLM *multi_handle;
+    LLMConnectionLimits limits;
+    std::thread event_thread;
+    std::atomic<bool> running;
+
+    // Submitted but not yet handed to curl (guarded by queue_mutex)
+    std::mutex queue_mutex;
+    std::deque<std::shared_ptr<Call>> pending;
+    // Unfinished calls by body hash, for coalescing (guarded by queue_mutex)
+    std::multimap<size_t, std::shared_ptr<Call>> coalescible_calls;
+
+    // Policies and breakers are read by callers and the event thread
+    std::mutex policy_mutex;
+    std::map<LLMCallType, LLMCallPolicy> policies;
+    std::map<LLMCallType, Breaker> breakers;
+    CircuitBreakerSettings breaker_settings;
+
+    std::shared_ptr<LLMCassette> cassette; // Record/replay of all traffic, off by default
+
+    LLMRateLimiter rate_limiter;
+
+    // Owned by the event thread only
+    std::deque<std::shared_ptr<Call>> waiting; // Not started yet or retrying, by priority then age
+    int admitted_calls = 0;                    // Started and not yet finished
+    std::chrono::steady_clock::time_point next_admission; // When a rate-limited waiting call may start
+    std::map<CURL *, std::unique_ptr<Transfer>> active_transfers;
+    std::multimap<std::chrono::steady_clock::time_point, Timer> timers;
+    std::map<LLMCallType, std::deque<double>> latency_samples; // Successful attempts, for p95
+    std::mt19937 rng;
+
+    void hashForCoalescing(Call &call);
+    bool joinIdenticalCall(const std::shared_ptr<Call> &call); // Caller holds queue_mutex
+    void eventLoop();
+    void enqueueWaiting(const std::shared_ptr<Call> &call);
+    void admitWaiting();
+    void startAttempt(const std::shared_ptr<Call> &call);
+    void finishTransfer(CURL *easy, CURLcode result);
+    void runDueTimers();
+    long nextTimerDelayMs(long cap_ms) const;
+    void cancelAttempts(Call &call);
+    void finishCall(const std::shared_ptr<Call> &call, LLMResponse response);
+    long backoffMs(const Call &call, long retry_after_ms);
+    long hedgeDelayMs(const Call &call) const;
+    void recordLatency(LLMCallType type, double latency_ms);
+
+    bool allowCall(LLMCallType type);
+    void recordOutcome(LLMCallType type, bool success);
+
+public:
+    explicit LLMClient(const LLMConnectionLimits &limits = LLMConnectionLimits());
+    ~LLMClient();
+
+    LLMClient(const LLMClient &) = delete;
+    LLMClient &operator=(const LLMClient &) = delete;
+
+    // Process-wide client shared by every LLM call site
+    static LLMClient &instance();
+
+    std::future<LLMResponse> submit(LLMRequest request);
+    void submit(LLMRequest request, LLMCallback on_complete);
+
+    // Blocking convenience wrapper
+    LLMResponse perform(LLMRequest request);
+
+    void setCallPolicy(LLMCallType type, const LLMCallPolicy &policy);
+    LLMCallPolicy getCallPolicy(LLMCallType type);
+    void setCircuitBreakerSettings(const CircuitBreakerSettings &settings);
+    // host is as in the URL ("openrouter.ai", "127.0.0.1:8081"), or "*" for any other host
+    void setRateLimit(const std::string &host, const LLMRateLimit &limit);
+
+    // Record/replay layer (see llm_cassette.h); open it before the first call
+    LLMCassette &getCassette();
+    // Makes this client record to and replay from other's cassette, so one session
+    // file covers every backend. Call before the first request.
+    void shareCassetteWith(LLMClient &other);
+};
+
+#endif // LLM_CLIENT_H
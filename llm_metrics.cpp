@@ -0,0 +1,204 @@
+#include "llm_metrics.h"
+#include <cstring>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<LLMCallRecord>::value, "LLMCallRecord is copied through atomic words");
+static_assert(sizeof(LLMCallRecord) % sizeof(uint64_t) == 0, "LLMCallRecord must be a whole number of words");
+
+LLMMetrics::LLMMetrics()
+{
+    for (Slot &slot : ring)
+    {
+        for (auto &word : slot.words)
+        {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+LLMMetrics &LLMMetrics::instance()
+{
+    static LLMMetrics metrics;
+    return metrics;
+}
+
+void LLMMetrics::record(const LLMCallRecord &record)
+{
+    size_t type = static_cast<size_t>(record.call_type);
+    if (type < kTypeCount)
+    {
+        Totals &total = totals[type];
+        int64_t latency_us = static_cast<int64_t>(record.latency_ms * 1000.0);
+        total.calls.fetch_add(1, std::memory_order_relaxed);
+        if (!record.transport_ok || record.http_status < 200 || record.http_status >= 300)
+        {
+            total.failures.fetch_add(1, std::memory_order_relaxed);
+        }
+        total.retries.fetch_add(record.attempts > 1 ? record.attempts - 1 : 0, std::memory_order_relaxed);
+        total.hedged.fetch_add(record.hedged, std::memory_order_relaxed);
+        total.prompt_tokens.fetch_add(record.prompt_tokens, std::memory_order_relaxed);
+        total.completion_tokens.fetch_add(record.completion_tokens, std::memory_order_relaxed);
+        total.bytes_sent.fetch_add(record.bytes_sent, std::memory_order_relaxed);
+        total.bytes_received.fetch_add(record.bytes_received, std::memory_order_relaxed);
+        total.latency_us.fetch_add(latency_us, std::memory_order_relaxed);
+        int64_t max_us = total.max_latency_us.load(std::memory_order_relaxed);
+        while (latency_us > max_us && !total.max_latency_us.compare_exchange_weak(max_us, latency_us, std::memory_order_relaxed))
+        {
+        }
+        int64_t queue_us = static_cast<int64_t>(record.queue_ms * 1000.0);
+        total.queue_us.fetch_add(queue_us, std::memory_order_relaxed);
+        int64_t max_queue_us = total.max_queue_us.load(std::memory_order_relaxed);
+        while (queue_us > max_queue_us && !total.max_queue_us.compare_exchange_weak(max_queue_us, queue_us, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    uint64_t ticket = next_ticket.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = ring[ticket % kCapacity];
+    uint64_t words[kRecordWords];
+    std::memcpy(words, &record, sizeof(words));
+
+    slot.sequence.store(2 * ticket + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kRecordWords; ++i)
+    {
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    }
+    slot.sequence.store(2 * ticket + 2, std::memory_order_release);
+}
+
+void LLMMetrics::recordParseFailure(LLMCallType type)
+{
+    size_t index = static_cast<size_t>(type);
+    if (index < kTypeCount)
+    {
+        totals[index].parse_failures.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void LLMMetrics::recordJsonRepair(LLMCallType type)
+{
+    size_t index = static_cast<size_t>(type);
+    if (index < kTypeCount)
+    {
+        totals[index].json_repairs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void LLMMetrics::recordRateLimited(LLMCallType type)
+{
+    size_t index = static_cast<size_t>(type);
+    if (index < kTypeCount)
+    {
+        totals[index].rate_limited.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void LLMMetrics::recordCoalesced(LLMCallType type)
+{
+    size_t index = static_cast<size_t>(type);
+    if (index < kTypeCount)
+    {
+        totals[index].coalesced.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool LLMMetrics::readSlot(uint64_t ticket, LLMCallRecord &record) const
+{
+    const Slot &slot = ring[ticket % kCapacity];
+    uint64_t words[kRecordWords];
+    for (int tries = 0; tries < 4; ++tries)
+    {
+        uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before != 2 * ticket + 2)
+        {
+            // Still being written, or already overwritten by a newer call
+            if (before < 2 * ticket + 2)
+            {
+                continue;
+            }
+            return false;
+        }
+        for (size_t i = 0; i < kRecordWords; ++i)
+        {
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == before)
+        {
+            std::memcpy(&record, words, sizeof(words));
+            return true;
+        }
+    }
+    return false;
+}
+
+json LLMMetrics::snapshot(size_t recent_limit) const
+{
+    json result;
+    json by_type = json::object();
+    int64_t all_calls = 0;
+    for (size_t type = 0; type < kTypeCount; ++type)
+    {
+        const Totals &total = totals[type];
+        int64_t calls = total.calls.load(std::memory_order_relaxed);
+        if (calls == 0)
+        {
+            continue;
+        }
+        all_calls += calls;
+        int64_t latency_us = total.latency_us.load(std::memory_order_relaxed);
+        by_type[llmCallTypeName(static_cast<LLMCallType>(type))] = {
+            {"calls", calls},
+            {"failures", total.failures.load(std::memory_order_relaxed)},
+            {"retries", total.retries.load(std::memory_order_relaxed)},
+            {"hedged", total.hedged.load(std::memory_order_relaxed)},
+            {"prompt_tokens", total.prompt_tokens.load(std::memory_order_relaxed)},
+            {"completion_tokens", total.completion_tokens.load(std::memory_order_relaxed)},
+            {"bytes_sent", total.bytes_sent.load(std::memory_order_relaxed)},
+            {"bytes_received", total.bytes_received.load(std::memory_order_relaxed)},
+            {"total_latency_ms", latency_us / 1000.0},
+            {"avg_latency_ms", latency_us / 1000.0 / calls},
+            {"max_latency_ms", total.max_latency_us.load(std::memory_order_relaxed) / 1000.0},
+            {"avg_queue_ms", total.queue_us.load(std::memory_order_relaxed) / 1000.0 / calls},
+            {"max_queue_ms", total.max_queue_us.load(std::memory_order_relaxed) / 1000.0},
+            {"rate_limited", total.rate_limited.load(std::memory_order_relaxed)},
+            {"coalesced", total.coalesced.load(std::memory_order_relaxed)},
+            {"parse_failures", total.parse_failures.load(std::memory_order_relaxed)},
+            {"json_repairs", total.json_repairs.load(std::memory_order_relaxed)}};
+    }
+    result["calls"] = all_calls;
+    result["by_call_type"] = by_type;
+
+    json recent = json::array();
+    uint64_t end = next_ticket.load(std::memory_order_acquire);
+    uint64_t begin = end > kCapacity ? end - kCapacity : 0;
+    for (uint64_t ticket = end; ticket-- > begin && recent.size() < recent_limit;)
+    {
+        LLMCallRecord record;
+        if (!readSlot(ticket, record))
+        {
+            continue;
+        }
+        json entry = {
+            {"call_type", llmCallTypeName(static_cast<LLMCallType>(record.call_type))},
+            {"finished_at_ms", record.finished_at_ms},
+            {"latency_ms", record.latency_ms},
+            {"queue_ms", record.queue_ms},
+            {"http_status", record.http_status},
+            {"transport_ok", record.transport_ok != 0},
+            {"attempts", record.attempts},
+            {"hedged", record.hedged != 0},
+            {"prompt_tokens", record.prompt_tokens},
+            {"completion_tokens", record.completion_tokens},
+            {"bytes_sent", record.bytes_sent},
+            {"bytes_received", record.bytes_received}};
+        if (record.replayed)
+        {
+            entry["replayed"] = true;
+        }
+        recent.push_back(entry);
+    }
+    result["recent"] = recent;
+    return result;
+}
@@ -0,0 +1,96 @@
+#ifndef LLM_METRICS_H
+#define LLM_METRICS_H
+
+#include "llm_client.h"
+#include "include/json.hpp"
+#include <atomic>
+#include <array>
+#include <cstdint>
+
+using json = nlohmann::json;
+
+// One finished LLM call. Kept trivially copyable so it can live in the lock-free ring.
+struct LLMCallRecord
+{
+    int64_t finished_at_ms = 0; // System clock, milliseconds since the epoch
+    int64_t prompt_tokens = 0;
+    int64_t completion_tokens = 0;
+    int64_t bytes_sent = 0; // Request bodies of every attempt, hedges included
+    int64_t bytes_received = 0;
+    double latency_ms = 0.0;
+    double queue_ms = 0.0; // Part of latency_ms spent waiting for a slot or rate-limit token
+    int32_t call_type = 0; // LLMCallType
+    int32_t http_status = 0;
+    int32_t attempts = 0;
+    uint8_t transport_ok = 0;
+    uint8_t hedged = 0;
+    uint8_t replayed = 0; // Served from the cassette
+    uint8_t padding[1] = {};
+};
+
+// Process-wide accounting of every call LLMClient completes, tagged by call
+// type (intent, planning, vision step, content generation, screen analysis,
+// chat). Recording never takes a lock: running totals are atomics, and the last
+// kCapacity calls sit in a seqlock-protected ring that readers copy out and
+// retry if a writer overlapped them.
+class LLMMetrics
+{
+public:
+    static const size_t kCapacity = 1024;
+
+private:
+    static const size_t kTypeCount = static_cast<size_t>(LLMCallType::CHAT) + 1;
+    static const size_t kRecordWords = sizeof(LLMCallRecord) / sizeof(uint64_t);
+
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence{0}; // Odd while being written, 2 * (ticket + 1) once complete
+        std::array<std::atomic<uint64_t>, kRecordWords> words;
+    };
+
+    struct Totals
+    {
+        std::atomic<int64_t> calls{0};
+        std::atomic<int64_t> failures{0};  // Transport errors and non-2xx statuses
+        std::atomic<int64_t> retries{0};   // Attempts beyond the first, hedges included
+        std::atomic<int64_t> hedged{0};
+        std::atomic<int64_t> prompt_tokens{0};
+        std::atomic<int64_t> completion_tokens{0};
+        std::atomic<int64_t> bytes_sent{0};
+        std::atomic<int64_t> bytes_received{0};
+        std::atomic<int64_t> latency_us{0};
+        std::atomic<int64_t> max_latency_us{0};
+        std::atomic<int64_t> queue_us{0};
+        std::atomic<int64_t> max_queue_us{0};
+        std::atomic<int64_t> rate_limited{0}; // 429 responses, retried attempts included
+        std::atomic<int64_t> coalesced{0};    // Calls answered by an identical call already in flight
+        std::atomic<int64_t> parse_failures{0}; // Responses whose JSON was unusable, each costing a fallback or another call
+        std::atomic<int64_t> json_repairs{0};   // Responses usable only after repairJson, i.e. calls the repair saved
+    };
+
+    std::array<Slot, kCapacity> ring;
+    std::atomic<uint64_t> next_ticket{0};
+    std::array<Totals, kTypeCount> totals;
+
+    LLMMetrics();
+
+    bool readSlot(uint64_t ticket, LLMCallRecord &record) const;
+
+public:
+    static LLMMetrics &instance();
+
+    void record(const LLMCallRecord &record);
+    // A completed call whose content did not parse or did not match its schema
+    void recordParseFailure(LLMCallType type);
+    // A completed call whose content parsed only after repairJson
+    void recordJsonRepair(LLMCallType type);
+    // One attempt answered with 429
+    void recordRateLimited(LLMCallType type);
+    // A call that joined an identical one in flight instead of going out
+    void recordCoalesced(LLMCallType type);
+
+    // {"calls": total, "by_call_type": {type: totals...}, "recent": [newest first, up to limit]}
+    json snapshot(size_t recent_limit) const;
+};
+
+#endif // LLM_METRICS_H
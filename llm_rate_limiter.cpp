@@ -0,0 +1,138 @@
+#include "llm_rate_limiter.h"
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+    const double kAdaptSteps = 20.0;    // A success adds ceiling / kAdaptSteps; the rate never drops below that
+    const double kDecreaseFactor = 0.5; // Applied to the rate on every 429
+    const std::chrono::seconds kLearnWindow(1); // Unlimited buckets count requests over this to learn a ceiling
+
+    // "https://openrouter.ai/api/v1/..." -> "openrouter.ai"; the port stays, so local servers differ
+    std::string hostOf(const std::string &url)
+    {
+        size_t start = url.find("://");
+        start = start == std::string::npos ? 0 : start + 3;
+        size_t end = url.find('/', start);
+        return url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+    }
+
+    double perMinute(double rate_per_ms)
+    {
+        return rate_per_ms * 60000.0;
+    }
+} // namespace
+
+void LLMRateLimiter::setLimit(const std::string &host, const LLMRateLimit &limit)
+{
+    std::lock_guard<std::mutex> lock(limits_mutex);
+    limits[host] = limit;
+}
+
+LLMRateLimiter::Bucket &LLMRateLimiter::bucketFor(const std::string &url, const std::string &model, Clock::time_point now)
+{
+    std::string host = hostOf(url);
+    std::string key = host + "/" + model;
+    auto it = buckets.find(key);
+    if (it != buckets.end())
+    {
+        return it->second;
+    }
+
+    Bucket bucket;
+    bucket.name = key;
+    {
+        std::lock_guard<std::mutex> lock(limits_mutex);
+        auto limit = limits.find(host);
+        if (limit == limits.end())
+        {
+            limit = limits.find("*");
+        }
+        if (limit != limits.end())
+        {
+            bucket.ceiling = limit->second;
+        }
+    }
+    bucket.ceiling.burst = std::max(1, bucket.ceiling.burst);
+    bucket.rate_per_ms = std::max(0.0, bucket.ceiling.requests_per_minute) / 60000.0;
+    bucket.tokens = bucket.ceiling.burst;
+    bucket.refilled_at = now;
+    return buckets.emplace(key, bucket).first->second;
+}
+
+void LLMRateLimiter::refill(Bucket &bucket, Clock::time_point now) const
+{
+    double elapsed_ms = std::chrono::duration<double, std::milli>(now - bucket.refilled_at).count();
+    if (elapsed_ms > 0)
+    {
+        bucket.tokens = std::min<double>(bucket.ceiling.burst, bucket.tokens + elapsed_ms * bucket.rate_per_ms);
+        bucket.refilled_at = now;
+    }
+}
+
+bool LLMRateLimiter::tryAcquire(const std::string &url, const std::string &model, Clock::time_point now, Clock::time_point &ready_at)
+{
+    Bucket &bucket = bucketFor(url, model, now);
+    if (now < bucket.blocked_until)
+    {
+        ready_at = bucket.blocked_until;
+        return false;
+    }
+    if (bucket.rate_per_ms <= 0.0)
+    {
+        while (!bucket.recent_starts.empty() && now - bucket.recent_starts.front() > kLearnWindow)
+        {
+            bucket.recent_starts.pop_front();
+        }
+        bucket.recent_starts.push_back(now);
+        return true;
+    }
+    refill(bucket, now);
+    if (bucket.tokens >= 1.0)
+    {
+        bucket.tokens -= 1.0;
+        return true;
+    }
+    auto wait = std::chrono::duration<double, std::milli>((1.0 - bucket.tokens) / bucket.rate_per_ms);
+    ready_at = now + std::chrono::duration_cast<Clock::duration>(wait);
+    return false;
+}
+
+void LLMRateLimiter::onResponse(const std::string &url, const std::string &model, long http_status, long retry_after_ms, Clock::time_point now)
+{
+    Bucket &bucket = bucketFor(url, model, now);
+    double ceiling_per_ms = bucket.ceiling.requests_per_minute / 60000.0;
+
+    if (http_status == 429)
+    {
+        if (retry_after_ms > 0)
+        {
+            bucket.blocked_until = std::max(bucket.blocked_until, now + std::chrono::milliseconds(retry_after_ms));
+        }
+        if (bucket.rate_per_ms <= 0.0)
+        {
+            // No configured limit: what went out in the last second was too much
+            double sent = static_cast<double>(std::max<size_t>(1, bucket.recent_starts.size()));
+            bucket.ceiling.requests_per_minute = sent * 60000.0 / std::chrono::duration<double, std::milli>(kLearnWindow).count();
+            ceiling_per_ms = bucket.ceiling.requests_per_minute / 60000.0;
+            bucket.rate_per_ms = ceiling_per_ms;
+            bucket.recent_starts.clear();
+        }
+        refill(bucket, now);
+        bucket.rate_per_ms = std::max(ceiling_per_ms / kAdaptSteps, bucket.rate_per_ms * kDecreaseFactor);
+        bucket.tokens = std::min(bucket.tokens, 0.0); // No burst right after being told to slow down
+        std::cerr << "🐢 LLM rate limited by " << bucket.name << ", now " << perMinute(bucket.rate_per_ms) << " requests/min";
+        if (retry_after_ms > 0)
+        {
+            std::cerr << ", paused " << retry_after_ms << " ms (Retry-After)";
+        }
+        std::cerr << std::endl;
+        return;
+    }
+
+    if (http_status >= 200 && http_status < 300 && bucket.rate_per_ms > 0.0 && bucket.rate_per_ms < ceiling_per_ms)
+    {
+        refill(bucket, now);
+        bucket.rate_per_ms = std::min(ceiling_per_ms, bucket.rate_per_ms + ceiling_per_ms / kAdaptSteps);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef LLM_RATE_LIMITER_H
+#define LLM_RATE_LIMITER_H
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Ceiling for requests to one provider. 0 requests per minute means none is
+// known; the first 429 then sets one from the rate actually sent.
+struct LLMRateLimit
+{
+    double requests_per_minute = 0.0;
+    int burst = 1; // Requests that may go out back to back after an idle period
+};
+
+// Token buckets for outbound LLM requests, one per provider host and model
+// (free-tier limits are per model). Each bucket starts at its configured
+// ceiling and adapts to the provider: a 429 halves its rate and a Retry-After
+// stops it until the given time, each success adds back a twentieth of the
+// ceiling. Limits are keyed by host ("openrouter.ai", "127.0.0.1:8081"), with
+// "*" as the fallback for hosts not listed.
+//
+// setLimit may be called from any thread; everything else runs on the owning
+// LLMClient's event thread only.
+class LLMRateLimiter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    struct Bucket
+    {
+        std::string name; // host/model, for logs
+        LLMRateLimit ceiling;
+        double rate_per_ms = 0.0; // Current adaptive rate; 0 while unlimited
+        double tokens = 0.0;
+        std::deque<Clock::time_point> recent_starts; // Last second of requests, while unlimited
+        Clock::time_point refilled_at;
+        Clock::time_point blocked_until;
+    };
+
+    std::mutex limits_mutex;
+    std::map<std::string, LLMRateLimit> limits;
+    std::map<std::string, Bucket> buckets;
+
+    Bucket &bucketFor(const std::string &url, const std::string &model, Clock::time_point now);
+    void refill(Bucket &bucket, Clock::time_point now) const;
+
+public:
+    void setLimit(const std::string &host, const LLMRateLimit &limit);
+
+    // Takes a token and returns true when a request may start now. Otherwise
+    // ready_at is when the bucket will next have one.
+    bool tryAcquire(const std::string &url, const std::string &model, Clock::time_point now, Clock::time_point &ready_at);
+    // Feeds every attempt's outcome back into the bucket's rate
+    void onResponse(const std::string &url, const std::string &model, long http_status, long retry_after_ms, Clock::time_point now);
+};
+
+#endif // LLM_RATE_LIMITER_H
@@ -0,0 +1,434 @@
+#include "llm_response.h"
+#include "json_repair.h"
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+namespace
+{
+    const size_t kMaxEmbeddedCandidates = 8; // Opening brackets tried before giving up
+    const size_t kLogPreviewChars = 200;
+
+    // SAX consumer that tracks where it is in the document and keeps only the
+    // values CompletionResult needs. Everything else is skipped as it streams by.
+    class CompletionSax
+    {
+    private:
+        struct Container
+        {
+            bool is_array;
+            size_t index = 0; // Position of the next element when is_array
+            std::string key;  // Last key seen when !is_array
+        };
+
+        CompletionResult &result;
+        std::vector<Container> stack;
+
+        // Matches the path of the value currently being delivered. "#0" is array
+        // index 0, "#" any index, anything else an object key.
+        bool pathIs(std::initializer_list<const char *> expected) const
+        {
+            if (expected.size() != stack.size())
+            {
+                return false;
+            }
+            size_t depth = 0;
+            for (const char *segment : expected)
+            {
+                const Container &container = stack[depth++];
+                if (segment[0] == '#')
+                {
+                    if (!container.is_array || (segment[1] != '\0' && container.index != static_cast<size_t>(std::atoi(segment + 1))))
+                    {
+                        return false;
+                    }
+                }
+                else if (container.is_array || container.key != segment)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void onScalar()
+        {
+            if (!stack.empty() && stack.back().is_array)
+            {
+                stack.back().index++;
+            }
+        }
+
+        void onNumber(long value)
+        {
+            if (pathIs({"usage", "prompt_tokens"}))
+                result.usage.prompt_tokens = value;
+            else if (pathIs({"usage", "completion_tokens"}))
+                result.usage.completion_tokens = value;
+            else if (pathIs({"usage", "total_tokens"}))
+                result.usage.total_tokens = value;
+            onScalar();
+        }
+
+    public:
+        explicit CompletionSax(CompletionResult &result) : result(result) {}
+
+        bool null()
+        {
+            onScalar();
+            return true;
+        }
+        bool boolean(bool)
+        {
+            onScalar();
+            return true;
+        }
+        bool number_integer(json::number_integer_t value)
+        {
+            onNumber(static_cast<long>(value));
+            return true;
+        }
+        bool number_unsigned(json::number_unsigned_t value)
+        {
+            onNumber(static_cast<long>(value));
+            return true;
+        }
+        bool number_float(json::number_float_t value, const json::string_t &)
+        {
+            onNumber(static_cast<long>(value));
+            return true;
+        }
+        bool binary(json::binary_t &)
+        {
+            onScalar();
+            return true;
+        }
+
+        bool string(json::string_t &value)
+        {
+            if (pathIs({"choices", "#0", "message", "content"}) || pathIs({"choices", "#0", "delta", "content"}))
+            {
+                result.content = std::move(value);
+                result.has_content = true;
+            }
+            else if (pathIs({"choices", "#0", "message", "content", "#", "text"}))
+            {
+                // Multi-part content: keep the first text part
+                if (!result.has_content)
+                {
+                    result.content = std::move(value);
+                    result.has_content = true;
+                }
+            }
+            else if (pathIs({"choices", "#0", "message", "reasoning"}) || pathIs({"choices", "#0", "delta", "reasoning"}))
+                result.reasoning = std::move(value);
+            else if (pathIs({"choices", "#0", "finish_reason"}))
+                result.finish_reason = std::move(value);
+            else if (pathIs({"error", "message"}))
+                result.error_message = std::move(value);
+            onScalar();
+            return true;
+        }
+
+        bool start_object(std::size_t)
+        {
+            stack.push_back(Container{false, 0, {}});
+            return true;
+        }
+        bool key(json::string_t &value)
+        {
+            stack.back().key = std::move(value);
+            return true;
+        }
+        bool end_object()
+        {
+            stack.pop_back();
+            onScalar();
+            return true;
+        }
+        bool start_array(std::size_t)
+        {
+            stack.push_back(Container{true, 0, {}});
+            return true;
+        }
+        bool end_array()
+        {
+            stack.pop_back();
+            onScalar();
+            return true;
+        }
+
+        bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &)
+        {
+            return false;
+        }
+    };
+
+    // Returns one past the bracket closing the one at `start`, or npos if the
+    // text ends first (ran_out is then set) or a bracket closes the wrong kind.
+    // String literals (and escapes inside them) are skipped.
+    size_t findBalancedEnd(const std::string &text, size_t start, bool *ran_out = nullptr)
+    {
+        if (ran_out)
+        {
+            *ran_out = false;
+        }
+        std::vector<char> expected_closers;
+        bool in_string = false;
+        for (size_t i = start; i < text.size(); ++i)
+        {
+            char c = text[i];
+            if (in_string)
+            {
+                if (c == '\\')
+                    ++i;
+                else if (c == '"')
+                    in_string = false;
+                continue;
+            }
+            switch (c)
+            {
+            case '"':
+                in_string = true;
+                break;
+            case '{':
+                expected_closers.push_back('}');
+                break;
+            case '[':
+                expected_closers.push_back(']');
+                break;
+            case '}':
+            case ']':
+                if (expected_closers.empty() || expected_closers.back() != c)
+                {
+                    return std::string::npos;
+                }
+                expected_closers.pop_back();
+                if (expected_closers.empty())
+                {
+                    return i + 1;
+                }
+                break;
+            default:
+                break;
+            }
+        }
+        if (ran_out)
+        {
+            *ran_out = true;
+        }
+        return std::string::npos;
+    }
+
+    // A bracket that opens JSON rather than prose: {"key", {}, [1, [{ ...
+    bool opensJson(const std::string &text, size_t bracket)
+    {
+        size_t next = text.find_first_not_of(" \t\r\n", bracket + 1);
+        if (next == std::string::npos)
+        {
+            return false;
+        }
+        char c = text[next];
+        return c == '"' || c == '{' || c == '[' || c == '}' || c == ']' ||
+               (text[bracket] == '[' && (c == '-' || std::isdigit(static_cast<unsigned char>(c))));
+    }
+} // namespace
+
+bool parseCompletion(const std::string &body, CompletionResult &result)
+{
+    CompletionSax handler(result);
+    return json::sax_parse(body, &handler);
+}
+
+bool parseUsage(const std::string &body, CompletionUsage &usage)
+{
+    // The last "usage" key is the top-level one even if the model's own text mentions it
+    size_t key = body.rfind("\"usage\"");
+    if (key == std::string::npos)
+    {
+        return false;
+    }
+    size_t start = body.find_first_not_of(" \t\r\n:", key + 7);
+    if (start == std::string::npos || body[start] != '{')
+    {
+        return false;
+    }
+    size_t end = findBalancedEnd(body, start);
+    if (end == std::string::npos)
+    {
+        return false;
+    }
+    json parsed = json::parse(body.begin() + start, body.begin() + end, nullptr, false);
+    if (!parsed.is_object())
+    {
+        return false;
+    }
+    auto count = [&parsed](const char *field, long fallback)
+    {
+        auto it = parsed.find(field);
+        return it != parsed.end() && it->is_number() ? it->get<long>() : fallback;
+    };
+    usage.prompt_tokens = count("prompt_tokens", 0);
+    usage.completion_tokens = count("completion_tokens", 0);
+    usage.total_tokens = count("total_tokens", usage.prompt_tokens + usage.completion_tokens);
+    return true;
+}
+
+void ChatStreamParser::feed(const char *data, size_t length, std::string &delta)
+{
+    const char *end = data + length;
+    while (data < end)
+    {
+        const char *newline = static_cast<const char *>(std::memchr(data, '\n', end - data));
+        if (newline == nullptr)
+        {
+            partial_line.append(data, end);
+            return;
+        }
+        partial_line.append(data, newline);
+        data = newline + 1;
+        if (!partial_line.empty() && partial_line.back() == '\r')
+        {
+            partial_line.pop_back();
+        }
+        // Only data lines matter; blank lines, ": keep-alive" comments and event/id fields are skipped
+        if (partial_line.compare(0, 5, "data:") == 0)
+        {
+            size_t payload = partial_line.size() > 5 && partial_line[5] == ' ' ? 6 : 5;
+            if (partial_line.compare(payload, std::string::npos, "[DONE]") == 0)
+            {
+                done = true;
+            }
+            else
+            {
+                parseEvent(partial_line.substr(payload), delta);
+            }
+        }
+        partial_line.clear();
+    }
+}
+
+void ChatStreamParser::parseEvent(const std::string &payload, std::string &delta)
+{
+    CompletionResult event;
+    if (!parseCompletion(payload, event))
+    {
+        return;
+    }
+    saw_event = true;
+    if (event.has_content)
+    {
+        delta += event.content;
+        result.content += event.content;
+        result.has_content = true;
+    }
+    result.reasoning += event.reasoning;
+    if (!event.finish_reason.empty())
+    {
+        result.finish_reason = std::move(event.finish_reason);
+    }
+    if (!event.error_message.empty())
+    {
+        result.error_message = std::move(event.error_message);
+    }
+    if (event.usage.prompt_tokens > 0 || event.usage.completion_tokens > 0)
+    {
+        result.usage = event.usage;
+    }
+}
+
+void stripReasoningBlocks(std::string &content)
+{
+    const std::string open_tag = "<think>";
+    const std::string close_tag = "</think>";
+    size_t close = content.find(close_tag);
+    size_t open = content.find(open_tag);
+    if (close != std::string::npos && (open == std::string::npos || close < open))
+    {
+        content.erase(0, close + close_tag.size());
+    }
+    while ((open = content.find(open_tag)) != std::string::npos)
+    {
+        close = content.find(close_tag, open);
+        content.erase(open, close == std::string::npos ? std::string::npos : close + close_tag.size() - open);
+    }
+}
+
+bool extractEmbeddedJson(const std::string &text, json &out)
+{
+    return extractEmbeddedJson(text, out, [](const char *begin, const char *end, json &parsed)
+                               {
+                                   parsed = json::parse(begin, end, nullptr, false);
+                                   return !parsed.is_discarded(); });
+}
+
+bool extractEmbeddedJson(const std::string &text, json &out, const JsonSpanParser &parse_span, bool *repaired)
+{
+    if (repaired)
+    {
+        *repaired = false;
+    }
+
+    // A ```json fence is the strongest hint; otherwise start at the first bracket
+    size_t search_from = 0;
+    size_t fence = text.find("```json");
+    if (fence != std::string::npos)
+    {
+        search_from = fence + 7;
+    }
+
+    size_t first = text.find_first_of("{[", search_from);
+    size_t start = first;
+    size_t cut_off = std::string::npos; // JSON-looking candidate the text ends inside
+    for (size_t tries = 0; start != std::string::npos && tries < kMaxEmbeddedCandidates; ++tries)
+    {
+        bool ran_out = false;
+        size_t end = findBalancedEnd(text, start, &ran_out);
+        if (end != std::string::npos)
+        {
+            json parsed;
+            if (parse_span(text.data() + start, text.data() + end, parsed))
+            {
+                out = std::move(parsed);
+                return true;
+            }
+        }
+        else if (ran_out && opensJson(text, start))
+        {
+            // A reply cut off by max_tokens. Every later bracket is inside this value
+            // ({"steps": [{"n": 1}, {"n"...), so only a repair of it will do.
+            cut_off = start;
+            break;
+        }
+        // Prose like "use {x}" before the real payload: try the next bracket
+        start = text.find_first_of("{[", start + 1);
+    }
+
+    // No span is valid as written: trailing commas, comments, unquoted keys or
+    // a reply cut off by max_tokens. Retry the same candidates on repaired text,
+    // up to the cut-off value; brackets after it are inside it.
+    start = first;
+    for (size_t tries = 0; start != std::string::npos && start <= cut_off && tries < kMaxEmbeddedCandidates; ++tries)
+    {
+        std::string fixed;
+        json parsed;
+        // A repair that keeps nothing ({x} -> {}) is not a recovery
+        if (repairJson(text.substr(start), fixed) && fixed.size() > 2 &&
+            parse_span(fixed.data(), fixed.data() + fixed.size(), parsed))
+        {
+            if (repaired)
+            {
+                *repaired = true;
+            }
+            out = std::move(parsed);
+            return true;
+        }
+        start = text.find_first_of("{[", start + 1);
+    }
+
+    std::cerr << "Failed to extract JSON from model output (" << text.size() << " chars): "
+              << text.substr(0, kLogPreviewChars) << (text.size() > kLogPreviewChars ? "..." : "") << std::endl;
+    return false;
+}
@@ -0,0 +1,75 @@
+#ifndef LLM_RESPONSE_H
+#define LLM_RESPONSE_H
+
+#include "include/json.hpp"
+#include <string>
+#include <functional>
+
+using json = nlohmann::json;
+
+struct CompletionUsage
+{
+    long prompt_tokens = 0;
+    long completion_tokens = 0;
+    long total_tokens = 0;
+};
+
+// The handful of fields we actually use from a chat-completions response
+struct CompletionResult
+{
+    bool has_content = false; // choices[0].message.content was present
+    std::string content;      // A string, or the first "text" part when content is an array
+    std::string reasoning;    // choices[0].message.reasoning (DeepSeek R1 style models)
+    std::string finish_reason;
+    std::string error_message; // error.message when the provider returned an error object
+    CompletionUsage usage;
+};
+
+// Pulls CompletionResult out of a raw response body with a SAX pass, without
+// building a json DOM. Returns false if the body is not valid JSON.
+bool parseCompletion(const std::string &body, CompletionResult &result);
+
+// Reads a "stream": true chat completions body (server-sent events) as it
+// arrives, in pieces of any size. Each event is a small completion whose
+// choices[0].delta holds the next bit of text; parseCompletion reads it.
+// Keep-alive comments (": OPENROUTER PROCESSING") and [DONE] are skipped.
+class ChatStreamParser
+{
+private:
+    std::string partial_line; // Unterminated last line of the previous piece
+
+    void parseEvent(const std::string &payload, std::string &delta);
+
+public:
+    bool saw_event = false;  // False for a body that was not streamed after all
+    bool done = false;       // "data: [DONE]" arrived
+    CompletionResult result; // Content so far; finish_reason, usage and errors from the events
+
+    // Appends the content carried by the events completed in this piece to delta
+    void feed(const char *data, size_t length, std::string &delta);
+};
+
+// Reads only the top-level "usage" object (providers put it last) without
+// parsing the rest of the body. Cheap enough to run on every response.
+bool parseUsage(const std::string &body, CompletionUsage &usage);
+
+// Removes <think>...</think> blocks that reasoning models put in content. An
+// unclosed <think> (output cut off mid-thought) drops the rest; a lone </think>
+// (template opened the block in the prompt) drops everything before it.
+void stripReasoningBlocks(std::string &content);
+
+// Finds the JSON object/array embedded in model output (bare, inside a ```json
+// fence or surrounded by prose) by scanning for a balanced bracket span and
+// parsing only that span. If no span parses, the candidates are retried once
+// through repairJson. When the text ends inside an earlier value (cut off by
+// max_tokens), that value is repaired rather than returning a piece of it.
+// Logs a single short line on failure.
+bool extractEmbeddedJson(const std::string &text, json &out);
+
+// Same search, but each candidate span [begin, end) is handed to parse_span
+// (e.g. JsonSchema::parse) and the first one it accepts wins. repaired, when
+// given, is set if the accepted value only parsed after repairJson.
+using JsonSpanParser = std::function<bool(const char *begin, const char *end, json &out)>;
+bool extractEmbeddedJson(const std::string &text, json &out, const JsonSpanParser &parse_span, bool *repaired = nullptr);
+
+#endif // LLM_RESPONSE_H
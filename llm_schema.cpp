@@ -0,0 +1,329 @@
+#include "llm_schema.h"
+#include <algorithm>
+
+namespace
+{
+    unsigned typeBit(const std::string &type_name)
+    {
+        if (type_name == "null")
+            return JsonSchema::TYPE_NULL;
+        if (type_name == "boolean")
+            return JsonSchema::TYPE_BOOLEAN;
+        if (type_name == "integer")
+            return JsonSchema::TYPE_INTEGER;
+        if (type_name == "number")
+            return JsonSchema::TYPE_NUMBER | JsonSchema::TYPE_INTEGER;
+        if (type_name == "string")
+            return JsonSchema::TYPE_STRING;
+        if (type_name == "array")
+            return JsonSchema::TYPE_ARRAY;
+        if (type_name == "object")
+            return JsonSchema::TYPE_OBJECT;
+        return JsonSchema::TYPE_ANY;
+    }
+
+    // Builds the value and checks it against the compiled nodes as SAX events
+    // arrive. Returning false from an event stops the parse at the first violation.
+    class ValidatingSax
+    {
+    private:
+        struct Frame
+        {
+            int node; // -1: nothing below this point is checked
+            bool is_array;
+            json *value;
+            std::string key;            // Last key seen in an object
+            std::vector<bool> required; // Which of the node's required keys were seen
+        };
+
+        const std::vector<JsonSchema::Node> &nodes;
+        json &root;
+        std::string &error;
+        std::vector<Frame> stack;
+
+        std::string path() const
+        {
+            std::string result = "$";
+            for (const Frame &frame : stack)
+            {
+                if (frame.is_array)
+                {
+                    result += "[" + std::to_string(frame.value->size()) + "]";
+                }
+                else if (!frame.key.empty())
+                {
+                    result += "." + frame.key;
+                }
+            }
+            return result;
+        }
+
+        bool fail(const std::string &reason)
+        {
+            error = reason + " at " + path();
+            return false;
+        }
+
+        // Schema node of the value about to be delivered
+        int expectedNode() const
+        {
+            if (stack.empty())
+            {
+                return 0;
+            }
+            const Frame &frame = stack.back();
+            if (frame.node < 0)
+            {
+                return -1;
+            }
+            const JsonSchema::Node &parent = nodes[frame.node];
+            if (frame.is_array)
+            {
+                return parent.items;
+            }
+            auto it = parent.properties.find(frame.key);
+            return it != parent.properties.end() ? it->second : parent.additional;
+        }
+
+        bool check(int node_index, unsigned type, const json *scalar, double number)
+        {
+            if (node_index < 0)
+            {
+                return true;
+            }
+            const JsonSchema::Node &node = nodes[node_index];
+            if (!(node.types & type))
+            {
+                return fail("unexpected type");
+            }
+            if (scalar && !node.enum_values.empty() &&
+                std::find(node.enum_values.begin(), node.enum_values.end(), *scalar) == node.enum_values.end())
+            {
+                return fail("value " + scalar->dump() + " not in enum");
+            }
+            if ((type & (JsonSchema::TYPE_INTEGER | JsonSchema::TYPE_NUMBER)) &&
+                ((node.has_minimum && number < node.minimum) || (node.has_maximum && number > node.maximum)))
+            {
+                return fail("number out of range");
+            }
+            return true;
+        }
+
+        // Stores a finished value where the parse currently is; containers are pushed as frames
+        json *place(json value)
+        {
+            if (stack.empty())
+            {
+                root = std::move(value);
+                return &root;
+            }
+            Frame &frame = stack.back();
+            if (frame.is_array)
+            {
+                frame.value->push_back(std::move(value));
+                return &frame.value->back();
+            }
+            json &slot = (*frame.value)[frame.key];
+            slot = std::move(value);
+            return &slot;
+        }
+
+        bool scalar(json value, unsigned type, double number)
+        {
+            if (!check(expectedNode(), type, &value, number))
+            {
+                return false;
+            }
+            place(std::move(value));
+            return true;
+        }
+
+        bool open(bool is_array)
+        {
+            int node_index = expectedNode();
+            if (!check(node_index, is_array ? JsonSchema::TYPE_ARRAY : JsonSchema::TYPE_OBJECT, nullptr, 0.0))
+            {
+                return false;
+            }
+            json *value = place(is_array ? json::array() : json::object());
+            Frame frame{node_index, is_array, value, "", {}};
+            if (!is_array && node_index >= 0)
+            {
+                frame.required.assign(nodes[node_index].required.size(), false);
+            }
+            stack.push_back(std::move(frame));
+            return true;
+        }
+
+    public:
+        ValidatingSax(const std::vector<JsonSchema::Node> &nodes, json &root, std::string &error)
+            : nodes(nodes), root(root), error(error) {}
+
+        bool null() { return scalar(nullptr, JsonSchema::TYPE_NULL, 0.0); }
+        bool boolean(bool value) { return scalar(value, JsonSchema::TYPE_BOOLEAN, 0.0); }
+        bool number_integer(json::number_integer_t value) { return scalar(value, JsonSchema::TYPE_INTEGER, static_cast<double>(value)); }
+        bool number_unsigned(json::number_unsigned_t value) { return scalar(value, JsonSchema::TYPE_INTEGER, static_cast<double>(value)); }
+        bool number_float(json::number_float_t value, const std::string &) { return scalar(value, JsonSchema::TYPE_NUMBER, value); }
+        bool string(std::string &value) { return scalar(std::move(value), JsonSchema::TYPE_STRING, 0.0); }
+        bool binary(json::binary_t &) { return fail("unexpected binary value"); }
+
+        bool start_object(std::size_t) { return open(false); }
+        bool start_array(std::size_t) { return open(true); }
+
+        bool key(std::string &name)
+        {
+            Frame &frame = stack.back();
+            frame.key = name;
+            if (frame.node < 0)
+            {
+                return true;
+            }
+            const JsonSchema::Node &node = nodes[frame.node];
+            if (!node.properties.count(name) && !node.additional_allowed)
+            {
+                return fail("unexpected property");
+            }
+            for (size_t i = 0; i < node.required.size(); ++i)
+            {
+                if (node.required[i] == name)
+                {
+                    frame.required[i] = true;
+                }
+            }
+            return true;
+        }
+
+        bool end_object()
+        {
+            Frame &frame = stack.back();
+            frame.key.clear(); // Report the object itself, not its last property
+            for (size_t i = 0; i < frame.required.size(); ++i)
+            {
+                if (!frame.required[i])
+                {
+                    return fail("missing required property \"" + nodes[frame.node].required[i] + "\"");
+                }
+            }
+            stack.pop_back();
+            return true;
+        }
+
+        bool end_array()
+        {
+            stack.pop_back();
+            return true;
+        }
+
+        bool parse_error(std::size_t position, const std::string &, const nlohmann::detail::exception &)
+        {
+            error = "invalid JSON near offset " + std::to_string(position);
+            return false;
+        }
+    };
+} // namespace
+
+JsonSchema::JsonSchema(std::string name, json schema, bool strict)
+    : name(std::move(name)), schema(std::move(schema)), strict(strict)
+{
+    compile(this->schema);
+}
+
+int JsonSchema::compile(const json &schema_node)
+{
+    int index = static_cast<int>(nodes.size());
+    nodes.emplace_back();
+    if (!schema_node.is_object())
+    {
+        return index;
+    }
+
+    Node node;
+    if (schema_node.contains("type"))
+    {
+        const json &type = schema_node["type"];
+        if (type.is_string())
+        {
+            node.types = typeBit(type.get<std::string>());
+        }
+        else if (type.is_array())
+        {
+            node.types = 0;
+            for (const auto &type_name : type)
+            {
+                node.types |= type_name.is_string() ? typeBit(type_name.get<std::string>()) : TYPE_ANY;
+            }
+        }
+    }
+    if (schema_node.contains("enum") && schema_node["enum"].is_array())
+    {
+        for (const auto &value : schema_node["enum"])
+        {
+            node.enum_values.push_back(value);
+        }
+    }
+    if (schema_node.contains("required") && schema_node["required"].is_array())
+    {
+        for (const auto &required : schema_node["required"])
+        {
+            if (required.is_string())
+            {
+                node.required.push_back(required.get<std::string>());
+            }
+        }
+    }
+    if (schema_node.contains("minimum") && schema_node["minimum"].is_number())
+    {
+        node.has_minimum = true;
+        node.minimum = schema_node["minimum"].get<double>();
+    }
+    if (schema_node.contains("maximum") && schema_node["maximum"].is_number())
+    {
+        node.has_maximum = true;
+        node.maximum = schema_node["maximum"].get<double>();
+    }
+    // Children are compiled after this node is appended, so indices refer into the final table
+    if (schema_node.contains("properties") && schema_node["properties"].is_object())
+    {
+        for (const auto &property : schema_node["properties"].items())
+        {
+            node.properties[property.key()] = compile(property.value());
+        }
+    }
+    if (schema_node.contains("additionalProperties"))
+    {
+        const json &additional = schema_node["additionalProperties"];
+        if (additional.is_boolean())
+        {
+            node.additional_allowed = additional.get<bool>();
+        }
+        else
+        {
+            node.additional = compile(additional);
+        }
+    }
+    if (schema_node.contains("items"))
+    {
+        node.items = compile(schema_node["items"]);
+    }
+    nodes[index] = std::move(node);
+    return index;
+}
+
+json JsonSchema::responseFormat() const
+{
+    return {
+        {"type", "json_schema"},
+        {"json_schema", {{"name", name}, {"strict", strict}, {"schema", schema}}}};
+}
+
+bool JsonSchema::parse(const char *begin, const char *end, json &out, std::string &error) const
+{
+    json value;
+    ValidatingSax sax(nodes, value, error);
+    if (!json::sax_parse(begin, end, &sax))
+    {
+        return false;
+    }
+    out = std::move(value);
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef LLM_SCHEMA_H
+#define LLM_SCHEMA_H
+
+#include "include/json.hpp"
+#include <string>
+#include <vector>
+#include <map>
+
+using json = nlohmann::json;
+
+// A JSON Schema for structured model output. The schema is sent as the
+// request's response_format so backends that support it constrain decoding,
+// and compiled once into a table that checks responses during the SAX parse,
+// so a response is validated and built in a single pass over its text.
+//
+// Supported keywords: type (a name or a list of names), enum, properties,
+// required, additionalProperties (boolean or schema), items, minimum and
+// maximum. Anything else is sent to the backend but not checked here.
+class JsonSchema
+{
+public:
+    // Type bits; NUMBER also accepts integers
+    enum : unsigned
+    {
+        TYPE_NULL = 1,
+        TYPE_BOOLEAN = 2,
+        TYPE_INTEGER = 4,
+        TYPE_NUMBER = 8,
+        TYPE_STRING = 16,
+        TYPE_ARRAY = 32,
+        TYPE_OBJECT = 64,
+        TYPE_ANY = 127
+    };
+
+    struct Node
+    {
+        unsigned types = TYPE_ANY;
+        std::vector<json> enum_values; // Scalars only
+        std::map<std::string, int> properties;
+        std::vector<std::string> required;
+        bool additional_allowed = true;
+        int additional = -1; // Node for undeclared properties, -1 for anything
+        int items = -1;      // Node for array elements, -1 for anything
+        bool has_minimum = false;
+        bool has_maximum = false;
+        double minimum = 0.0;
+        double maximum = 0.0;
+    };
+
+private:
+    std::string name;
+    json schema;
+    bool strict;
+    std::vector<Node> nodes; // nodes[0] is the root
+
+    int compile(const json &schema_node);
+
+public:
+    // strict asks the backend to follow the schema exactly; OpenAI-style strict
+    // mode needs every property listed in required and additionalProperties false
+    JsonSchema(std::string name, json schema, bool strict);
+
+    // {"type": "json_schema", "json_schema": {"name", "strict", "schema"}}
+    json responseFormat() const;
+
+    // Parses [begin, end) as one JSON value and checks it against the schema.
+    // out is written only when both succeed; otherwise error says where it failed.
+    bool parse(const char *begin, const char *end, json &out, std::string &error) const;
+};
+
+#endif // LLM_SCHEMA_H
@@ -6,11 +6,16 @@
 #include <chrono>
 #include "include/json.hpp"
 #include "ai_model.h"
+#include "llm_client.h"
+#include "llm_backend.h"
+#include "llm_cassette.h"
 // #include "context_manager.h" // Removed
 #include "task_planner.h"
 #include "advanced_executor.h"
 #include "multimodal_handler.h"
 #include "http_server.h"
+#include "intent_classifier.h"
+#include "screen_cache.h"
 
 using json = nlohmann::json;
 
@@ -23,6 +28,8 @@ private:
     AdvancedExecutor advanced_executor;
     MultiModalHandler multimodal_handler;
     HttpServer http_server;
+    std::shared_ptr<IntentClassifier> intent_classifier;
+    bool fused_routing = false; // Route from the plan's type instead of a separate intent call
     bool interactive_mode;
     bool learning_enabled;
     bool server_mode;
@@ -32,12 +39,166 @@ public:
                         learning_enabled(true),
                         server_mode(false),
                         http_server(8080),
+                        intent_classifier(std::make_shared<IntentClassifier>()),
                         task_planner("") // Initialize with empty key, will be set in loadConfiguration
     {
         loadConfiguration(); // api_key is loaded here, then task_planner is re-initialized
         displayWelcomeMessage();
     }
 
+    // Local backends and call type routes, per-call-type deadlines/retries/hedging
+    // and circuit breaker thresholds for LLMClient
+    void loadLLMSettings(const json &llm_settings)
+    {
+        LLMClient &client = LLMClient::instance();
+        LLMBackendRouter &router = LLMBackendRouter::instance();
+
+        if (llm_settings.contains("backends"))
+        {
+            for (const auto &entry : llm_settings["backends"].items())
+            {
+                const json &backend_config = entry.value();
+                LLMBackendConfig backend;
+                backend.name = entry.key();
+                backend.url = backend_config.value("url", "");
+                backend.api_key = backend_config.value("api_key", "");
+                backend.model = backend_config.value("model", "");
+                backend.structured_output = backend_config.value("structured_output", backend.structured_output);
+                backend.limits.max_concurrent_calls = backend_config.value("max_concurrent_calls", backend.limits.max_concurrent_calls);
+                backend.limits.max_host_connections = backend_config.value("max_connections", backend.limits.max_host_connections);
+                if (!router.addBackend(backend))
+                {
+                    std::cerr << "⚠️ Warning: Ignoring llm_settings.backends." << entry.key() << " (missing url or duplicate name)" << std::endl;
+                }
+            }
+        }
+        router.setDefaultStructuredOutput(llm_settings.value("structured_output", true));
+        std::vector<LLMClient *> clients = router.allClients();
+
+        if (llm_settings.contains("circuit_breaker"))
+        {
+            const json &breaker_config = llm_settings["circuit_breaker"];
+            CircuitBreakerSettings breaker;
+            breaker.failure_threshold = breaker_config.value("failure_threshold", breaker.failure_threshold);
+            breaker.open_ms = breaker_config.value("open_ms", breaker.open_ms);
+            for (LLMClient *backend_client : clients)
+            {
+                backend_client->setCircuitBreakerSettings(breaker);
+            }
+        }
+
+        if (llm_settings.contains("rate_limits"))
+        {
+            for (const auto &entry : llm_settings["rate_limits"].items())
+            {
+                LLMRateLimit rate_limit;
+                rate_limit.requests_per_minute = entry.value().value("requests_per_minute", rate_limit.requests_per_minute);
+                rate_limit.burst = entry.value().value("burst", rate_limit.burst);
+                for (LLMClient *backend_client : clients)
+                {
+                    backend_client->setRateLimit(entry.key(), rate_limit);
+                }
+            }
+        }
+
+        if (llm_settings.contains("call_policies"))
+        {
+            for (const auto &entry : llm_settings["call_policies"].items())
+            {
+                LLMCallType call_type;
+                if (!parseLLMCallType(entry.key(), call_type))
+                {
+                    std::cerr << "⚠️ Warning: Unknown LLM call type in llm_settings.call_policies: " << entry.key() << std::endl;
+                    continue;
+                }
+                const json &policy_config = entry.value();
+                LLMCallPolicy policy = client.getCallPolicy(call_type);
+                policy.deadline_ms = policy_config.value("deadline_ms", policy.deadline_ms);
+                policy.max_retries = policy_config.value("max_retries", policy.max_retries);
+                policy.base_backoff_ms = policy_config.value("base_backoff_ms", policy.base_backoff_ms);
+                policy.max_backoff_ms = policy_config.value("max_backoff_ms", policy.max_backoff_ms);
+                policy.hedge = policy_config.value("hedge", policy.hedge);
+                policy.hedge_min_delay_ms = policy_config.value("hedge_min_delay_ms", policy.hedge_min_delay_ms);
+                policy.priority = policy_config.value("priority", policy.priority);
+                for (LLMClient *backend_client : clients)
+                {
+                    backend_client->setCallPolicy(call_type, policy);
+                }
+            }
+        }
+
+        if (llm_settings.contains("routes"))
+        {
+            for (const auto &entry : llm_settings["routes"].items())
+            {
+                LLMCallType call_type;
+                if (!parseLLMCallType(entry.key(), call_type))
+                {
+                    std::cerr << "⚠️ Warning: Unknown LLM call type in llm_settings.routes: " << entry.key() << std::endl;
+                    continue;
+                }
+                std::string backend_name = entry.value().is_string() ? entry.value().get<std::string>() : "";
+                if (!router.setRoute(call_type, backend_name))
+                {
+                    std::cerr << "⚠️ Warning: llm_settings.routes." << entry.key() << " names unknown backend '" << backend_name << "'" << std::endl;
+                }
+            }
+        }
+
+        if (llm_settings.contains("profiles"))
+        {
+            for (const auto &entry : llm_settings["profiles"].items())
+            {
+                const json &profile_config = entry.value();
+                LLMProfile profile;
+                profile.name = entry.key();
+                profile.model = profile_config.value("model", "");
+                profile.max_tokens = profile_config.value("max_tokens", profile.max_tokens);
+                profile.temperature = profile_config.value("temperature", profile.temperature);
+                profile.timeout_ms = profile_config.value("timeout_ms", profile.timeout_ms);
+                profile.strip_reasoning = profile_config.value("strip_reasoning", profile.strip_reasoning);
+                if (!router.addProfile(profile))
+                {
+                    std::cerr << "⚠️ Warning: Ignoring duplicate llm_settings.profiles." << entry.key() << std::endl;
+                }
+            }
+        }
+
+        if (llm_settings.contains("call_profiles"))
+        {
+            for (const auto &entry : llm_settings["call_profiles"].items())
+            {
+                LLMCallType call_type;
+                if (!parseLLMCallType(entry.key(), call_type))
+                {
+                    std::cerr << "⚠️ Warning: Unknown LLM call type in llm_settings.call_profiles: " << entry.key() << std::endl;
+                    continue;
+                }
+                std::string profile_name = entry.value().is_string() ? entry.value().get<std::string>() : "";
+                if (!router.setProfile(call_type, profile_name))
+                {
+                    std::cerr << "⚠️ Warning: llm_settings.call_profiles." << entry.key() << " names unknown profile '" << profile_name << "'" << std::endl;
+                }
+            }
+        }
+
+        if (llm_settings.contains("cassette"))
+        {
+            const json &cassette_config = llm_settings["cassette"];
+            std::string mode_name = cassette_config.value("mode", "off");
+            CassetteMode mode;
+            if (!parseCassetteMode(mode_name, mode))
+            {
+                std::cerr << "⚠️ Warning: Unknown llm_settings.cassette.mode '" << mode_name << "', expected off, record or replay" << std::endl;
+            }
+            else if (mode != CassetteMode::OFF)
+            {
+                client.getCassette().open(mode, cassette_config.value("path", "llm_session.cassette"),
+                                          cassette_config.value("replay_latency", false));
+            }
+        }
+    }
+
     void loadConfiguration()
     {
         std::ifstream config_file("config_advanced.json");
@@ -70,6 +231,34 @@ public:
         // Initialize vision capabilities with AI API key
         advanced_executor.setAIApiKey(api_key);
 
+        if (config.contains("llm_settings"))
+        {
+            loadLLMSettings(config["llm_settings"]);
+        }
+
+        if (config.contains("context_settings"))
+        {
+            const json &context_settings = config["context_settings"];
+            ContextWindowSettings window_settings;
+            window_settings.recent_steps = context_settings.value("context_window_size", window_settings.recent_steps);
+            window_settings.prompt_token_budget = context_settings.value("prompt_token_budget", window_settings.prompt_token_budget);
+            window_settings.summary_token_budget = context_settings.value("summary_token_budget", window_settings.summary_token_budget);
+            advanced_executor.setContextWindowSettings(window_settings);
+        }
+
+        IntentClassifierSettings classifier_settings;
+        if (config.contains("intent_classifier"))
+        {
+            const json &classifier_config = config["intent_classifier"];
+            classifier_settings.enabled = classifier_config.value("enabled", classifier_settings.enabled);
+            classifier_settings.confidence_threshold = classifier_config.value("confidence_threshold", classifier_settings.confidence_threshold);
+            classifier_settings.min_training_examples = classifier_config.value("min_training_examples", classifier_settings.min_training_examples);
+            classifier_settings.audit_rate = classifier_config.value("audit_rate", classifier_settings.audit_rate);
+            classifier_settings.training_log = classifier_config.value("training_log", classifier_settings.training_log);
+        }
+        intent_classifier->configure(classifier_settings);
+        fused_routing = config.value("fused_routing", fused_routing);
+
         // Load advanced settings if available
         if (config.contains("execution_mode"))
         {
@@ -99,6 +288,48 @@ public:
             }
         }
 
+        if (config.contains("image_settings"))
+        {
+            const json &image_settings = config["image_settings"];
+            VisionCaptureSettings capture_settings;
+            capture_settings.screen_source = image_settings.value("screen_source", capture_settings.screen_source);
+            capture_settings.save_screenshots = image_settings.value("save_screenshots", capture_settings.save_screenshots);
+            std::string quality_preset = image_settings.value("screenshot_quality", std::string("high"));
+            if (!applyScreenshotQuality(quality_preset, capture_settings))
+            {
+                std::cerr << "⚠️ Warning: Unknown image_settings.screenshot_quality: " << quality_preset << std::endl;
+            }
+            capture_settings.format = image_settings.value("format", capture_settings.format);
+            capture_settings.quality = image_settings.value("quality", capture_settings.quality);
+            capture_settings.png_compression = image_settings.value("png_compression", capture_settings.png_compression);
+            capture_settings.max_long_edge = image_settings.value("max_long_edge", capture_settings.max_long_edge);
+            capture_settings.change_threshold = image_settings.value("change_threshold", capture_settings.change_threshold);
+            capture_settings.crop_changes = image_settings.value("crop_changes", capture_settings.crop_changes);
+            capture_settings.crop_margin = image_settings.value("crop_margin", capture_settings.crop_margin);
+            capture_settings.max_crop_fraction = image_settings.value("max_crop_fraction", capture_settings.max_crop_fraction);
+            if (capture_settings.format != "png" && capture_settings.format != "jpeg" && capture_settings.format != "webp")
+            {
+                std::cerr << "⚠️ Warning: Unknown image_settings.format: " << capture_settings.format << ", using png" << std::endl;
+                capture_settings.format = "png";
+            }
+            if (VisionProcessor *vp = multimodal_handler.getVisionProcessor())
+            {
+                vp->setCaptureSettings(capture_settings);
+            }
+            advanced_executor.setVisionCaptureSettings(capture_settings);
+
+            ScreenCacheSettings cache_settings;
+            if (image_settings.contains("screen_cache"))
+            {
+                const json &cache_config = image_settings["screen_cache"];
+                cache_settings.enabled = cache_config.value("enabled", cache_settings.enabled);
+                cache_settings.max_entries = cache_config.value("max_entries", cache_settings.max_entries);
+                cache_settings.max_hamming_distance = cache_config.value("max_hamming_distance", cache_settings.max_hamming_distance);
+                cache_settings.path = cache_config.value("path", cache_settings.path);
+            }
+            ScreenAnalysisCache::instance().configure(cache_settings);
+        }
+
         // Check for server mode
         if (config.contains("server_mode"))
         {
@@ -111,6 +342,8 @@ public:
             http_server.setComponents(&advanced_executor,
                                       &task_planner, &multimodal_handler,
                                       vp, api_key);
+            http_server.setIntentClassifier(intent_classifier);
+            http_server.setFusedRouting(fused_routing);
         }
     }
     void displayWelcomeMessage()
@@ -144,19 +377,24 @@ public:
             return;
         }
 
-        // Check if this is a vision task (natural language task)
-        if (isVisionTask(input))
+        // Check if this is a vision task (natural language task). The intent found
+        // here travels with the request so the vision executor does not ask again.
+        auto context = std::make_shared<ExecutionContext>(input);
+        // With fused routing one call returns both the route and the plan; either way
+        // the plan is only requested once something needs it
+        std::string key = api_key;
+        context->setPlanStarter([key, input]
+                                { return callAIModelAsync(key, input); });
+        if (isVisionTask(input, context))
         {
-            handleVisionTask(input);
+            handleVisionTask(input, context);
             return;
         }
 
         try
         {
-            // Process input through context manager (replaced with direct input)
-            std::string contextual_prompt = input; // Was context_manager.getContextualPrompt(input);
-            // Call AI Model API with enhanced context
-            json response = callAIModel(api_key, contextual_prompt);
+            // Call AI Model API (the plan fused routing already asked for, if any)
+            json response = context->getPlan().get();
 
             // Enhanced Error Handling for AI Response
             if (response.empty() || response.is_null())
@@ -216,6 +454,34 @@ public:
                     std::cout << "🚫 Execution cancelled by user." << std::endl;
                 }
             }
+            else if (response_type == "multi_step_plan" || response_type == "generate_content_and_execute")
+            {
+                // planTask sends every content generation request at once; each task waits
+                // for its own content only when executeWithPlan reaches it
+                TaskPlan plan = task_planner.planTask(input, response);
+                displayTaskPlan(plan);
+
+                bool proceed = true;
+                if (advanced_executor.getExecutionMode() == ExecutionMode::INTERACTIVE)
+                {
+                    proceed = askForConfirmation(response);
+                }
+
+                if (proceed)
+                {
+                    ExecutionResult result = advanced_executor.executeWithPlan(plan);
+                    displayExecutionResult(result);
+
+                    if (learning_enabled)
+                    {
+                        advanced_executor.learnFromExecution(response, result);
+                    }
+                }
+                else
+                {
+                    std::cout << "🚫 Execution cancelled by user." << std::endl;
+                }
+            }
             else if (response_type == "vision_task")
             {
                 // This block handles when callAIModel *directly* identifies a vision_task,
@@ -378,6 +644,10 @@ public:
         {
             const auto &task = plan.tasks[i];
             std::cout << "  " << (i + 1) << ". " << task.description << std::endl;
+            if (task.pending_content.valid())
+            {
+                std::cout << "     → (content is being generated)" << std::endl;
+            }
             for (const auto &cmd : task.commands)
             {
                 std::cout << "     → " << cmd << std::endl;
@@ -423,44 +693,52 @@ public:
         }
         std::cout << "⏱️ Execution time: " << result.execution_time << "s" << std::endl;
     }
-    bool isVisionTask(const std::string &input)
+    bool isVisionTask(const std::string &input, const std::shared_ptr<ExecutionContext> &context)
     {
-        // Use AI to dynamically determine if this is a vision task
-        try
+        // Use AI to dynamically determine if this is a vision task (from the pending plan when fused)
+        auto get_plan = [context]
+        { return context->getPlan(); };
+        IntentOracle ask_plan = fused_routing ? planRouteOracle(get_plan) : nullptr;
+        IntentOracle ask_intent = [key = api_key, context](const std::string &request, bool &is_vision)
         {
-            json intent = callIntentAI(api_key, input);
-
-            if (intent.empty() || intent.is_null())
+            try
             {
-                std::cerr << "⚠️ Warning in isVisionTask: AI intent analysis returned empty or null JSON. Defaulting to non-vision task. Raw input: " << input << std::endl;
-                return false; // Default to non-vision task
-            }
+                json intent = callIntentAI(key, request);
+                context->setIntent(intent);
 
-            if (!intent.contains("is_vision_task"))
-            {
-                std::cerr << "⚠️ Warning in isVisionTask: AI intent JSON is missing 'is_vision_task' field. Defaulting to non-vision task. Intent: "
-                          << intent.dump(2) << std::endl;
-                return false; // Default to non-vision task
-            }
+                if (intent.empty() || intent.is_null())
+                {
+                    std::cerr << "⚠️ Warning in isVisionTask: AI intent analysis returned empty or null JSON. Defaulting to non-vision task. Raw input: " << request << std::endl;
+                    return false;
+                }
 
-            bool is_vision = intent["is_vision_task"];
-            double confidence = intent.value("confidence", 0.5);
+                if (!intent.contains("is_vision_task"))
+                {
+                    std::cerr << "⚠️ Warning in isVisionTask: AI intent JSON is missing 'is_vision_task' field. Defaulting to non-vision task. Intent: "
+                              << intent.dump(2) << std::endl;
+                    return false;
+                }
 
-            std::cout << "🤖 AI Intent Analysis: " << (is_vision ? "Vision Task" : "Regular Task")
-                      << " (confidence: " << (confidence * 100) << "%)" << std::endl;
+                is_vision = intent["is_vision_task"];
+                double confidence = intent.value("confidence", 0.5);
 
-            return is_vision;
-        }
-        catch (const std::exception &e)
-        {
-            std::cerr << "❌ Error in isVisionTask during AI call: " << e.what() << ". Defaulting to non-vision task for input: " << input << std::endl;
-        }
+                std::cout << "🤖 AI Intent Analysis: " << (is_vision ? "Vision Task" : "Regular Task")
+                          << " (confidence: " << (confidence * 100) << "%)" << std::endl;
+                return true;
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "❌ Error in isVisionTask during AI call: " << e.what() << ". Defaulting to non-vision task for input: " << request << std::endl;
+            }
+            return false;
+        };
 
         // If AI fails or JSON is malformed, default to false
-        return false;
+        bool is_vision = false;
+        return intent_classifier->route(input, ask_intent, is_vision, ask_plan) && is_vision;
     }
 
-    void handleVisionTask(const std::string &input)
+    void handleVisionTask(const std::string &input, std::shared_ptr<ExecutionContext> context = nullptr)
     {
         std::cout << "🎯 Detected vision task: " << input << std::endl;
         std::cout << "👁️ Analyzing screen and planning execution..." << std::endl;
@@ -468,7 +746,7 @@ public:
         try
         {
             // Execute natural language task using vision
-            ExecutionResult result = advanced_executor.executeNaturalLanguageTask(input);
+            ExecutionResult result = advanced_executor.executeNaturalLanguageTask(input, context);
 
             // Display detailed results
             displayVisionTaskResult(result, input);
@@ -0,0 +1,30 @@
+#ifndef SCREEN_ANALYSIS_H
+#define SCREEN_ANALYSIS_H
+
+#include "include/json.hpp"
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+struct UIElement
+{
+    int x, y, width, height;
+    std::string type;        // button, text_field, image, label, etc.
+    std::string text;        // OCR extracted text
+    std::string description; // AI generated description
+    double confidence;       // Detection confidence
+    std::string id;          // Unique identifier
+};
+
+struct ScreenAnalysis
+{
+    std::string screenshot_path;
+    std::vector<UIElement> elements;
+    std::string overall_description;
+    std::string window_title;
+    std::string application_name;
+    json metadata;
+};
+
+#endif // SCREEN_ANALYSIS_H
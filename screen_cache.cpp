@@ -0,0 +1,367 @@
+#include "screen_cache.h"
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <bitset>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+    const char kMagic[4] = {'S', 'C', 'A', 'C'};
+    const uint8_t kVersion = 1;
+    const double kChangedPixelDelta = 24; // Gray levels a pixel must move to count as changed
+    const size_t kCompactFactor = 4;      // Rewrite the file once it holds this many times max_entries records
+
+    void writeLength(std::ofstream &out, uint32_t length)
+    {
+        unsigned char bytes[4] = {static_cast<unsigned char>(length), static_cast<unsigned char>(length >> 8),
+                                  static_cast<unsigned char>(length >> 16), static_cast<unsigned char>(length >> 24)};
+        out.write(reinterpret_cast<const char *>(bytes), 4);
+    }
+
+    bool readLength(std::ifstream &in, uint32_t &length)
+    {
+        unsigned char bytes[4];
+        if (!in.read(reinterpret_cast<char *>(bytes), 4))
+        {
+            return false;
+        }
+        length = uint32_t(bytes[0]) | (uint32_t(bytes[1]) << 8) | (uint32_t(bytes[2]) << 16) | (uint32_t(bytes[3]) << 24);
+        return true;
+    }
+
+    json elementsToJson(const std::vector<UIElement> &elements)
+    {
+        json rows = json::array();
+        for (const UIElement &element : elements)
+        {
+            rows.push_back({element.type, element.text, element.description, element.x, element.y,
+                            element.width, element.height, element.confidence, element.id});
+        }
+        return rows;
+    }
+
+    std::vector<UIElement> elementsFromJson(const json &rows)
+    {
+        std::vector<UIElement> elements;
+        for (const json &row : rows)
+        {
+            // Records written before ids were kept have 8 fields
+            if (!row.is_array() || (row.size() != 8 && row.size() != 9))
+            {
+                continue;
+            }
+            UIElement element;
+            element.type = row[0].get<std::string>();
+            element.text = row[1].get<std::string>();
+            element.description = row[2].get<std::string>();
+            element.x = row[3].get<int>();
+            element.y = row[4].get<int>();
+            element.width = row[5].get<int>();
+            element.height = row[6].get<int>();
+            element.confidence = row[7].get<double>();
+            element.id = row.size() > 8 ? row[8].get<std::string>() : "";
+            elements.push_back(element);
+        }
+        return elements;
+    }
+} // namespace
+
+ScreenHash computeScreenHash(const cv::Mat &gray)
+{
+    cv::Mat thumbnail;
+    cv::resize(gray, thumbnail, cv::Size(17, 16), 0, 0, cv::INTER_AREA);
+    ScreenHash hash = {};
+    int bit = 0;
+    for (int y = 0; y < 16; ++y)
+    {
+        const unsigned char *row = thumbnail.ptr<unsigned char>(y);
+        for (int x = 0; x < 16; ++x, ++bit)
+        {
+            if (row[x + 1] > row[x])
+            {
+                hash[bit / 64] |= uint64_t(1) << (bit % 64);
+            }
+        }
+    }
+    return hash;
+}
+
+int hammingDistance(const ScreenHash &a, const ScreenHash &b)
+{
+    int distance = 0;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        distance += static_cast<int>(std::bitset<64>(a[i] ^ b[i]).count());
+    }
+    return distance;
+}
+
+void changedPixelMask(const cv::Mat &a, const cv::Mat &b, cv::Mat &mask)
+{
+    cv::absdiff(a, b, mask);
+    cv::threshold(mask, mask, kChangedPixelDelta, 255, cv::THRESH_BINARY);
+}
+
+double frameChangeFraction(const cv::Mat &a, const cv::Mat &b)
+{
+    if (a.empty() || a.size() != b.size())
+    {
+        return 1.0;
+    }
+    cv::Mat mask;
+    changedPixelMask(a, b, mask);
+    return static_cast<double>(cv::countNonZero(mask)) / mask.total();
+}
+
+ScreenAnalysisCache &ScreenAnalysisCache::instance()
+{
+    static ScreenAnalysisCache cache;
+    return cache;
+}
+
+void ScreenAnalysisCache::configure(const ScreenCacheSettings &new_settings)
+{
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    settings = new_settings;
+    entries.clear();
+    if (out.is_open())
+    {
+        out.close();
+    }
+    if (settings.enabled && !settings.path.empty())
+    {
+        load();
+    }
+}
+
+bool ScreenAnalysisCache::isEnabled()
+{
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return settings.enabled;
+}
+
+void ScreenAnalysisCache::load()
+{
+    std::error_code ec;
+    std::filesystem::path parent = std::filesystem::path(settings.path).parent_path();
+    if (!parent.empty())
+    {
+        std::filesystem::create_directories(parent, ec);
+    }
+
+    std::ifstream in(settings.path, std::ios::binary);
+    char magic[4];
+    if (in.is_open() && in.read(magic, 4) && std::string(magic, 4) == std::string(kMagic, 4) && in.get() == kVersion)
+    {
+        // Later records win, and only the newest max_entries screens are kept
+        std::map<std::tuple<ScreenHash, std::string, std::string, int, int>, std::list<Entry>::iterator> seen;
+        uint32_t length = 0;
+        std::vector<uint8_t> buffer;
+        while (readLength(in, length))
+        {
+            buffer.resize(length);
+            if (!in.read(reinterpret_cast<char *>(buffer.data()), length))
+            {
+                std::cerr << "⚠️ Screen cache truncated after " << entries.size() << " records" << std::endl;
+                break;
+            }
+            json record = json::from_cbor(buffer, true, false);
+            if (record.is_discarded() || !record.is_object() || !record.contains("hash") || !record["hash"].is_binary())
+            {
+                continue;
+            }
+            try
+            {
+                Entry entry;
+                const auto &hash_bytes = record["hash"].get_binary();
+                if (hash_bytes.size() != sizeof(ScreenHash))
+                {
+                    continue;
+                }
+                for (size_t i = 0; i < hash_bytes.size(); ++i)
+                {
+                    entry.hash[i / 8] |= uint64_t(hash_bytes[i]) << (8 * (i % 8));
+                }
+                entry.window_title = record.value("title", "");
+                entry.application_name = record.value("app", "");
+                entry.screen_width = record.value("width", 0);
+                entry.screen_height = record.value("height", 0);
+                const auto &gate_png = record["gate"].get_binary();
+                entry.gate_frame = cv::imdecode(std::vector<unsigned char>(gate_png.begin(), gate_png.end()), cv::IMREAD_GRAYSCALE);
+                if (entry.gate_frame.empty())
+                {
+                    continue;
+                }
+                entry.analysis.window_title = entry.window_title;
+                entry.analysis.application_name = entry.application_name;
+                entry.analysis.overall_description = record.value("description", "");
+                entry.analysis.elements = elementsFromJson(record.value("elements", json::array()));
+
+                auto key = std::make_tuple(entry.hash, entry.window_title, entry.application_name, entry.screen_width, entry.screen_height);
+                auto previous = seen.find(key);
+                if (previous != seen.end())
+                {
+                    entries.erase(previous->second);
+                }
+                entries.push_front(std::move(entry));
+                seen[key] = entries.begin();
+            }
+            catch (const std::exception &ex)
+            {
+                std::cerr << "⚠️ Skipping unreadable screen cache record: " << ex.what() << std::endl;
+            }
+        }
+        trim();
+    }
+    in.close();
+
+    rewrite();
+    if (!entries.empty())
+    {
+        std::cout << "🗂️ Loaded " << entries.size() << " cached screen analyses from " << settings.path << std::endl;
+    }
+}
+
+void ScreenAnalysisCache::rewrite()
+{
+    // Only the live entries, oldest first so the newest win on the next load
+    if (out.is_open())
+    {
+        out.close();
+    }
+    out.open(settings.path, std::ios::binary | std::ios::trunc);
+    file_records = 0;
+    if (!out.is_open())
+    {
+        std::cerr << "❌ Could not open screen cache: " << settings.path << std::endl;
+        return;
+    }
+    out.write(kMagic, sizeof(kMagic));
+    out.put(static_cast<char>(kVersion));
+    for (auto entry = entries.rbegin(); entry != entries.rend(); ++entry)
+    {
+        append(*entry);
+    }
+    out.flush();
+}
+
+void ScreenAnalysisCache::append(const Entry &entry)
+{
+    if (!out.is_open())
+    {
+        return;
+    }
+    std::vector<uint8_t> hash_bytes(sizeof(ScreenHash));
+    for (size_t i = 0; i < hash_bytes.size(); ++i)
+    {
+        hash_bytes[i] = static_cast<uint8_t>(entry.hash[i / 8] >> (8 * (i % 8)));
+    }
+    std::vector<unsigned char> gate_png;
+    cv::imencode(".png", entry.gate_frame, gate_png);
+
+    json record = {
+        {"hash", json::binary(std::move(hash_bytes))},
+        {"title", entry.window_title},
+        {"app", entry.application_name},
+        {"width", entry.screen_width},
+        {"height", entry.screen_height},
+        {"gate", json::binary(std::vector<uint8_t>(gate_png.begin(), gate_png.end()))},
+        {"description", entry.analysis.overall_description},
+        {"elements", elementsToJson(entry.analysis.elements)}};
+    std::vector<uint8_t> cbor = json::to_cbor(record);
+    writeLength(out, static_cast<uint32_t>(cbor.size()));
+    out.write(reinterpret_cast<const char *>(cbor.data()), static_cast<std::streamsize>(cbor.size()));
+    ++file_records;
+}
+
+void ScreenAnalysisCache::trim()
+{
+    while (entries.size() > settings.max_entries)
+    {
+        entries.pop_back();
+    }
+}
+
+bool ScreenAnalysisCache::lookup(const ScreenHash &hash, const std::string &window_title, const std::string &application_name,
+                                 const cv::Mat &gate_frame, int screen_width, int screen_height, double change_threshold,
+                                 ScreenAnalysis &analysis)
+{
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if (!settings.enabled)
+    {
+        return false;
+    }
+
+    // Candidates nearest in hash first; the pixel check has the final say
+    std::vector<std::pair<int, std::list<Entry>::iterator>> candidates;
+    for (auto entry = entries.begin(); entry != entries.end(); ++entry)
+    {
+        if (entry->window_title != window_title || entry->application_name != application_name ||
+            entry->screen_width != screen_width || entry->screen_height != screen_height)
+        {
+            continue;
+        }
+        int distance = hammingDistance(hash, entry->hash);
+        if (distance <= settings.max_hamming_distance)
+        {
+            candidates.emplace_back(distance, entry);
+        }
+    }
+    std::stable_sort(candidates.begin(), candidates.end(), [](const auto &a, const auto &b)
+                     { return a.first < b.first; });
+    for (const auto &candidate : candidates)
+    {
+        if (frameChangeFraction(gate_frame, candidate.second->gate_frame) <= change_threshold)
+        {
+            entries.splice(entries.begin(), entries, candidate.second);
+            analysis = entries.front().analysis;
+            ++hits;
+            return true;
+        }
+    }
+    ++misses;
+    return false;
+}
+
+void ScreenAnalysisCache::insert(const ScreenHash &hash, const std::string &window_title, const std::string &application_name,
+                                 const cv::Mat &gate_frame, int screen_width, int screen_height, const ScreenAnalysis &analysis)
+{
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if (!settings.enabled || gate_frame.empty())
+    {
+        return;
+    }
+    Entry entry;
+    entry.hash = hash;
+    entry.window_title = window_title;
+    entry.application_name = application_name;
+    entry.screen_width = screen_width;
+    entry.screen_height = screen_height;
+    entry.gate_frame = gate_frame.clone();
+    entry.analysis.window_title = window_title;
+    entry.analysis.application_name = application_name;
+    entry.analysis.overall_description = analysis.overall_description;
+    entry.analysis.elements = analysis.elements;
+    append(entry);
+    out.flush();
+    entries.push_front(std::move(entry));
+    trim();
+
+    // Every insert adds a record, evicted screens included; a long session
+    // would otherwise grow the file until the next startup compacts it
+    if (out.is_open() && file_records > kCompactFactor * std::max<size_t>(settings.max_entries, 1))
+    {
+        rewrite();
+    }
+}
+
+json ScreenAnalysisCache::getStats()
+{
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return {{"entries", entries.size()}, {"hits", hits}, {"misses", misses}};
+}
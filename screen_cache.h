@@ -0,0 +1,92 @@
+#ifndef SCREEN_CACHE_H
+#define SCREEN_CACHE_H
+
+#include "vision_processor.h"
+#include <opencv2/core.hpp>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <string>
+
+// 256-bit dHash of a grayscale frame: each bit says whether a pixel of a 17x16
+// thumbnail is brighter than its left neighbour. Survives rescaling and small
+// redraws (caret, clock), so frames of the same screen land a few bits apart.
+using ScreenHash = std::array<uint64_t, 4>;
+
+ScreenHash computeScreenHash(const cv::Mat &gray);
+int hammingDistance(const ScreenHash &a, const ScreenHash &b);
+
+// 255 where two same-sized grayscale frames differ by more than a few gray levels, else 0
+void changedPixelMask(const cv::Mat &a, const cv::Mat &b, cv::Mat &mask);
+// Fraction of pixels set in that mask (1.0 when the sizes differ)
+double frameChangeFraction(const cv::Mat &a, const cv::Mat &b);
+
+struct ScreenCacheSettings
+{
+    bool enabled = true;
+    size_t max_entries = 64;       // Least recently used screens are dropped first
+    int max_hamming_distance = 12; // dHash bits (of 256) a frame may differ by and still be looked at
+    std::string path = "temp/vision/screen_cache.bin"; // Empty keeps the cache in memory only
+};
+
+// Parsed screen analyses of screens seen before, in this session or an earlier
+// one, so returning to the same screen does not cost another vision-model call.
+//
+// A frame matches an entry when the window title, application and screen size
+// are equal, the dHash is within max_hamming_distance, and the entry's
+// 480-pixel-wide grayscale copy (the same one the frame-difference gate uses)
+// differs from the frame's by no more than the change threshold. The hash
+// narrows the candidates; the pixel check keeps a screen that differs only in
+// some text, which a perceptual hash barely sees, from matching.
+//
+// Entries are appended to path as they are added, in the cassette's framing
+// (magic "SCAC" and a version byte, then uint32 length-prefixed CBOR records),
+// and the file is rewritten with only the live entries when it is loaded and
+// whenever it holds four times max_entries records.
+class ScreenAnalysisCache
+{
+private:
+    struct Entry
+    {
+        ScreenHash hash = {};
+        std::string window_title;
+        std::string application_name;
+        int screen_width = 0;
+        int screen_height = 0;
+        cv::Mat gate_frame;
+        ScreenAnalysis analysis;
+    };
+
+    std::mutex cache_mutex;
+    ScreenCacheSettings settings;
+    std::list<Entry> entries; // Most recently used first
+    std::ofstream out;
+    size_t file_records = 0; // Records in the file, live or not
+    int64_t hits = 0;
+    int64_t misses = 0;
+
+    void load();
+    void append(const Entry &entry);
+    void rewrite();
+    void trim();
+
+public:
+    // Process-wide cache shared by every VisionProcessor
+    static ScreenAnalysisCache &instance();
+
+    // Loads (and compacts) the on-disk store when path is set
+    void configure(const ScreenCacheSettings &new_settings);
+    bool isEnabled();
+
+    bool lookup(const ScreenHash &hash, const std::string &window_title, const std::string &application_name,
+                const cv::Mat &gate_frame, int screen_width, int screen_height, double change_threshold,
+                ScreenAnalysis &analysis);
+    void insert(const ScreenHash &hash, const std::string &window_title, const std::string &application_name,
+                const cv::Mat &gate_frame, int screen_width, int screen_height, const ScreenAnalysis &analysis);
+
+    json getStats();
+};
+
+#endif // SCREEN_CACHE_H
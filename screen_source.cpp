@@ -0,0 +1,157 @@
+#include "screen_source.h"
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef _WINSOCKAPI_
+#define _WINSOCKAPI_ // Prevent inclusion of winsock.h
+#endif
+#include <windows.h>
+#endif
+
+#ifdef _WIN32
+bool DesktopScreenSource::capture(cv::Mat &frame)
+{
+    int width = GetSystemMetrics(SM_CXSCREEN);
+    int height = GetSystemMetrics(SM_CYSCREEN);
+
+    HDC hScreenDC = GetDC(NULL);
+    HDC hMemoryDC = CreateCompatibleDC(hScreenDC);
+    HBITMAP hBitmap = CreateCompatibleBitmap(hScreenDC, width, height);
+    HBITMAP hOldBitmap = (HBITMAP)SelectObject(hMemoryDC, hBitmap);
+
+    BOOL copied = BitBlt(hMemoryDC, 0, 0, width, height, hScreenDC, 0, 0, SRCCOPY);
+
+    BITMAPINFOHEADER bi = {};
+    bi.biSize = sizeof(BITMAPINFOHEADER);
+    bi.biWidth = width;
+    bi.biHeight = -height; // Negative height to indicate top-down DIB
+    bi.biPlanes = 1;
+    bi.biBitCount = 32; // 32-bit for easier OpenCV processing with alpha
+    bi.biCompression = BI_RGB;
+
+    frame.create(height, width, CV_8UC4); // 4 channels for BGRA; no reallocation at the same size
+    int lines = copied ? GetDIBits(hScreenDC, hBitmap, 0, (UINT)height, frame.data, (BITMAPINFO *)&bi, DIB_RGB_COLORS) : 0;
+
+    SelectObject(hMemoryDC, hOldBitmap);
+    DeleteObject(hBitmap);
+    DeleteDC(hMemoryDC);
+    ReleaseDC(NULL, hScreenDC);
+
+    if (lines != height)
+    {
+        std::cerr << "❌ Screen capture failed (" << lines << "/" << height << " lines)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+ForegroundWindow DesktopScreenSource::foregroundWindow() const
+{
+    ForegroundWindow window;
+    HWND hwnd = GetForegroundWindow();
+    if (!hwnd)
+    {
+        return window;
+    }
+    window.handle = reinterpret_cast<uintptr_t>(hwnd);
+
+    char buffer[256];
+    GetWindowTextA(hwnd, buffer, sizeof(buffer));
+    window.title = buffer;
+
+    window.application = "Unknown";
+    DWORD processId;
+    GetWindowThreadProcessId(hwnd, &processId);
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, processId);
+    if (hProcess)
+    {
+        char path[MAX_PATH];
+        DWORD pathSize = MAX_PATH;
+        if (QueryFullProcessImageNameA(hProcess, 0, path, &pathSize))
+        {
+            // Just the file name
+            std::string fullPath(path);
+            size_t lastSlash = fullPath.find_last_of("\\/");
+            window.application = lastSlash != std::string::npos ? fullPath.substr(lastSlash + 1) : fullPath;
+        }
+        CloseHandle(hProcess);
+    }
+    return window;
+}
+#else
+bool DesktopScreenSource::capture(cv::Mat &)
+{
+    std::cerr << "❌ Desktop capture needs Windows; set image_settings.screen_source to a screenshot file or directory" << std::endl;
+    return false;
+}
+
+ForegroundWindow DesktopScreenSource::foregroundWindow() const
+{
+    return {};
+}
+#endif
+
+std::string DesktopScreenSource::describe() const
+{
+    return "desktop";
+}
+
+FileScreenSource::FileScreenSource(const std::string &path) : path(path)
+{
+    std::error_code ec;
+    if (std::filesystem::is_directory(path, ec))
+    {
+        for (const auto &entry : std::filesystem::directory_iterator(path, ec))
+        {
+            std::string ext = entry.path().extension().string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c)
+                           { return static_cast<char>(std::tolower(c)); });
+            if (entry.is_regular_file() && (ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".bmp" || ext == ".webp"))
+            {
+                files.push_back(entry.path().string());
+            }
+        }
+        std::sort(files.begin(), files.end());
+    }
+    else if (std::filesystem::exists(path, ec))
+    {
+        files.push_back(path);
+    }
+    if (files.empty())
+    {
+        std::cerr << "❌ No screenshots to play back in " << path << std::endl;
+    }
+}
+
+bool FileScreenSource::capture(cv::Mat &frame)
+{
+    if (files.empty())
+    {
+        return false;
+    }
+    const std::string &file = files[next_file];
+    next_file = (next_file + 1) % files.size();
+
+    cv::Mat decoded = cv::imread(file, cv::IMREAD_COLOR);
+    if (decoded.empty())
+    {
+        std::cerr << "❌ Failed to read screenshot " << file << std::endl;
+        return false;
+    }
+    // Same layout as a desktop capture
+    cv::cvtColor(decoded, frame, cv::COLOR_BGR2BGRA);
+    return true;
+}
+
+std::string FileScreenSource::describe() const
+{
+    return "files from " + path + " (" + std::to_string(files.size()) + ")";
+}
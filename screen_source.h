@@ -0,0 +1,59 @@
+#ifndef SCREEN_SOURCE_H
+#define SCREEN_SOURCE_H
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The window in front of the screen a source shows
+struct ForegroundWindow
+{
+    std::string title;
+    std::string application; // Executable name, e.g. "notepad.exe"
+    uintptr_t handle = 0;    // Native handle for logs; 0 when there is none
+};
+
+// Where VisionProcessor gets its frames. The desktop source grabs the screen
+// through GDI; the file source plays back saved screenshots instead, so the
+// capture -> encode -> upload pipeline can run (and be benchmarked) headless.
+class ScreenSource
+{
+public:
+    virtual ~ScreenSource() = default;
+
+    // Fills frame with the current screen as 8-bit BGRA. frame's pixels are
+    // reused when the size has not changed. False on failure.
+    virtual bool capture(cv::Mat &frame) = 0;
+    virtual std::string describe() const = 0; // For logs
+    // Empty where the source has no windows, as for played-back files
+    virtual ForegroundWindow foregroundWindow() const { return {}; }
+};
+
+// The whole primary screen via BitBlt, and the foreground window's title and
+// process (Windows only; elsewhere capture fails and there is no window)
+class DesktopScreenSource : public ScreenSource
+{
+public:
+    bool capture(cv::Mat &frame) override;
+    std::string describe() const override;
+    ForegroundWindow foregroundWindow() const override;
+};
+
+// Image files in name order, one per capture, starting over after the last.
+// path is a single image or a directory of them (png, jpg, jpeg, bmp, webp).
+class FileScreenSource : public ScreenSource
+{
+private:
+    std::string path;
+    std::vector<std::string> files;
+    size_t next_file = 0;
+
+public:
+    explicit FileScreenSource(const std::string &path);
+
+    bool capture(cv::Mat &frame) override;
+    std::string describe() const override;
+};
+
+#endif // SCREEN_SOURCE_H
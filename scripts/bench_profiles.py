@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+"""Per-stage latency of each llm_settings profile.
+
+Sends a representative intent check, vision action step and plan request
+straight to the chat completions endpoint, once with the call site's own
+settings ("call_site") and once with each profile in config_advanced.json.
+It reports, per stage and profile:
+- median and p90 latency
+- completion tokens
+- how often the reply held usable JSON (a truncated or empty reply counts as a miss)
+
+    python scripts/bench_profiles.py --repeat 5
+    python scripts/bench_profiles.py --profiles call_site fast --stages intent vision_step
+
+Free-tier models are rate limited per model, so keep --repeat small or
+pass --pause. Use the numbers to decide what goes into
+llm_settings.call_profiles.
+"""
+
+import argparse
+import json
+import os
+import statistics
+import sys
+import time
+import urllib.error
+import urllib.request
+
+# Each stage's call site settings as ai_model.cpp sends them, with a short
+# prompt of the same kind and the JSON key a usable reply must contain.
+STAGES = {
+    "intent": {
+        "call_site": {},
+        "expect": "is_vision_task",
+        "messages": [
+            {"role": "system", "content": "Decide whether the user request needs to look at and interact with the screen. "
+                                          "Answer only with JSON: {\"is_vision_task\": true|false, \"reason\": \"...\"}"},
+            {"role": "user", "content": "Open Notepad and type hello"},
+        ],
+    },
+    "vision_step": {
+        "call_site": {"temperature": 0.0, "max_tokens": 2500},
+        "expect": "action",
+        "messages": [
+            {"role": "system", "content": "You control a Windows desktop. Pick the next action for the objective from the "
+                                          "element table. Answer only with JSON: {\"action\": \"click|type|press_key|done\", "
+                                          "\"element_id\": \"eN\", \"text\": \"...\", \"reasoning\": \"...\"}"},
+            {"role": "user", "content": "Objective: open Notepad\n"
+                                        "id|type|text|description|x,y,w,h\n"
+                                        "e1|button|Start||0,1040,48,40\n"
+                                        "e2|input_field||Search box|60,1040,300,40\n"
+                                        "e3|icon|Notepad|Notepad app|400,300,64,64\n"
+                                        "e4|icon|Recycle Bin||20,20,64,64\n"},
+        ],
+    },
+    "planning": {
+        "call_site": {},
+        "expect": "type",
+        "messages": [
+            {"role": "system", "content": "Turn the user request into a plan. Answer only with JSON: {\"type\": "
+                                          "\"powershell_script\"|\"vision_task\"|\"text\", \"script\": [\"...\"], "
+                                          "\"objective\": \"...\"}"},
+            {"role": "user", "content": "Create a folder called reports on the desktop and list its contents"},
+        ],
+    },
+}
+
+
+def load_config(path):
+    with open(path, encoding="utf-8") as f:
+        return json.load(f)
+
+
+def request_body(config, stage, profile):
+    body = {"model": config.get("ai_model", {}).get("model", ""), "messages": STAGES[stage]["messages"]}
+    body.update(STAGES[stage]["call_site"])
+    # Same precedence as LLMBackendRouter::apply(): fields a profile leaves out keep the call site's
+    if profile:
+        for field in ("model", "max_tokens"):
+            if profile.get(field):
+                body[field] = profile[field]
+        if profile.get("temperature", -1.0) >= 0.0:
+            body["temperature"] = profile["temperature"]
+        if profile.get("strip_reasoning"):
+            body["reasoning"] = {"exclude": True}
+    return body
+
+
+def usable_json(text, key):
+    start = text.find("{")
+    while start != -1:
+        try:
+            value, _ = json.JSONDecoder().raw_decode(text[start:])
+            if isinstance(value, dict) and key in value:
+                return True
+        except ValueError:
+            pass
+        start = text.find("{", start + 1)
+    return False
+
+
+def call(url, api_key, body, timeout):
+    data = json.dumps(body).encode()
+    request = urllib.request.Request(url, data=data, headers={"Content-Type": "application/json",
+                                                              "Authorization": "Bearer " + api_key})
+    started = time.perf_counter()
+    with urllib.request.urlopen(request, timeout=timeout) as response:
+        reply = json.loads(response.read().decode())
+    elapsed_ms = (time.perf_counter() - started) * 1000.0
+    message = (reply.get("choices") or [{}])[0].get("message") or {}
+    tokens = (reply.get("usage") or {}).get("completion_tokens", 0)
+    return elapsed_ms, message.get("content") or "", tokens
+
+
+def run_cell(args, config, stage, profile):
+    body = request_body(config, stage, profile)
+    latencies, tokens, usable, errors = [], [], 0, 0
+    for _ in range(args.repeat):
+        try:
+            elapsed_ms, content, completion_tokens = call(args.url, args.api_key, body, args.timeout)
+        except (urllib.error.URLError, OSError, ValueError) as error:
+            print(f"    {stage}: {error}", file=sys.stderr)
+            errors += 1
+        else:
+            latencies.append(elapsed_ms)
+            tokens.append(completion_tokens)
+            usable += usable_json(content, STAGES[stage]["expect"])
+        time.sleep(args.pause)
+    return body["model"], latencies, tokens, usable, errors
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--config", default="config_advanced.json")
+    parser.add_argument("--url", help="chat completions endpoint (default: ai_model.api_url)")
+    parser.add_argument("--api-key", help="default: OPENROUTER_API_KEY, then the config's api_key")
+    parser.add_argument("--profiles", nargs="+", help="profile names, plus call_site (default: all)")
+    parser.add_argument("--stages", nargs="+", choices=sorted(STAGES), default=list(STAGES))
+    parser.add_argument("--repeat", type=int, default=3)
+    parser.add_argument("--pause", type=float, default=0.0, help="seconds between calls")
+    parser.add_argument("--timeout", type=float, default=120.0)
+    args = parser.parse_args()
+
+    config = load_config(args.config)
+    args.url = args.url or config.get("ai_model", {}).get("api_url", "https://openrouter.ai/api/v1/chat/completions")
+    args.api_key = args.api_key or os.environ.get("OPENROUTER_API_KEY") or config.get("api_key", "")
+    profiles = {"call_site": None}
+    profiles.update(config.get("llm_settings", {}).get("profiles", {}))
+    names = args.profiles or list(profiles)
+    unknown = [name for name in names if name not in profiles]
+    if unknown:
+        parser.error("unknown profile(s): " + ", ".join(unknown))
+
+    print(f"{'stage':12s} {'profile':13s} {'median ms':>10s} {'p90 ms':>10s} {'tokens':>7s} {'usable':>7s}  model")
+    for stage in args.stages:
+        for name in names:
+            model, latencies, tokens, usable, errors = run_cell(args, config, stage, profiles[name])
+            if not latencies:
+                print(f"{stage:12s} {name:13s} {'failed':>10s} {'':>10s} {'':>7s} {'':>7s}  {model}")
+                continue
+            latencies.sort()
+            p90 = latencies[min(len(latencies) - 1, int(0.9 * len(latencies)))]
+            usable_text = f"{usable}/{len(latencies)}" + (f" ({errors} failed)" if errors else "")
+            print(f"{stage:12s} {name:13s} {statistics.median(latencies):10.0f} {p90:10.0f} "
+                  f"{statistics.median(tokens):7.0f} {usable_text:>7s}  {model}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
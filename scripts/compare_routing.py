@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""A/B comparison of fused and separate agent-mode routing.
+
+Sends the same requests to /api/execute on a running server and records, per
+request, the route taken, the wall-clock latency and the LLM calls it made
+(the change in /api/metrics by_call_type). Run it once per mode, restarting
+the server with "fused_routing" set to false and then true in
+config_advanced.json, then compare the two result files:
+
+    python scripts/compare_routing.py run --out separate.json
+    python scripts/compare_routing.py run --out fused.json
+    python scripts/compare_routing.py compare separate.json fused.json
+
+Set "intent_classifier": {"enabled": false} for both runs. Otherwise
+confident local decisions skip the LLM in both modes and hide the difference.
+Vision requests are executed on the desktop (or on image_settings.screen_source),
+so run them on a test machine, or pass --skip-vision.
+"""
+
+import argparse
+import json
+import statistics
+import sys
+import time
+import urllib.request
+
+REGULAR_REQUESTS = [
+    "What is the difference between TCP and UDP?",
+    "Explain what a PowerShell execution policy is in two sentences",
+    "Write a four line poem about autumn",
+    "List three ways to free up disk space on Windows",
+    "How do I check which process is listening on port 8080?",
+]
+
+VISION_REQUESTS = [
+    "Open Notepad",
+    "Open the Calculator app",
+    "Open the Start menu",
+]
+
+
+def http_json(url, body=None, timeout=600):
+    data = json.dumps(body).encode() if body is not None else None
+    request = urllib.request.Request(url, data=data, headers={"Content-Type": "application/json"})
+    with urllib.request.urlopen(request, timeout=timeout) as response:
+        return json.loads(response.read().decode())
+
+
+def llm_calls(server):
+    metrics = http_json(server + "/api/metrics")
+    calls = {name: stats.get("calls", 0) for name, stats in metrics.get("by_call_type", {}).items()}
+    return calls, metrics.get("routing", {}).get("mode", "unknown")
+
+
+def run(args):
+    requests = list(REGULAR_REQUESTS)
+    if not args.skip_vision:
+        requests += VISION_REQUESTS
+    if args.requests:
+        with open(args.requests, encoding="utf-8") as f:
+            requests = [line.strip() for line in f if line.strip()]
+
+    _, mode = llm_calls(args.server)
+    print(f"Routing mode on {args.server}: {mode}")
+    results = []
+    for repeat in range(args.repeat):
+        for text in requests:
+            before, _ = llm_calls(args.server)
+            started = time.perf_counter()
+            reply = http_json(args.server + "/api/execute", {"input": text, "mode": "agent"})
+            elapsed_ms = (time.perf_counter() - started) * 1000.0
+            after, _ = llm_calls(args.server)
+            calls = {name: after[name] - before.get(name, 0) for name in after if after[name] != before.get(name, 0)}
+            route = "vision" if reply.get("response_type") == "vision_task" else "regular"
+            results.append({"input": text, "route": route, "latency_ms": elapsed_ms, "llm_calls": calls})
+            print(f"  {route:8s} {elapsed_ms:9.0f} ms  {sum(calls.values()):3d} calls {calls}  {text}")
+
+    with open(args.out, "w", encoding="utf-8") as f:
+        json.dump({"mode": mode, "server": args.server, "results": results}, f, indent=2)
+    print(f"Wrote {len(results)} results to {args.out}")
+
+
+def summarize(results, route):
+    rows = [r for r in results if r["route"] == route]
+    if not rows:
+        return None
+    latencies = sorted(r["latency_ms"] for r in rows)
+    calls = [sum(r["llm_calls"].values()) for r in rows]
+    by_type = {}
+    for r in rows:
+        for name, count in r["llm_calls"].items():
+            by_type[name] = by_type.get(name, 0) + count
+    return {
+        "requests": len(rows),
+        "median_ms": statistics.median(latencies),
+        "p90_ms": latencies[min(len(latencies) - 1, int(0.9 * len(latencies)))],
+        "calls_per_request": sum(calls) / len(rows),
+        "calls_by_type": {name: count / len(rows) for name, count in sorted(by_type.items())},
+    }
+
+
+def compare(args):
+    runs = []
+    for path in args.files:
+        with open(path, encoding="utf-8") as f:
+            runs.append(json.load(f))
+
+    print(f"{'route':8s} {'mode':10s} {'requests':>8s} {'median ms':>10s} {'p90 ms':>10s} {'calls/req':>10s}  calls by type")
+    for route in ("regular", "vision"):
+        for data in runs:
+            summary = summarize(data["results"], route)
+            if summary is None:
+                continue
+            by_type = ", ".join(f"{name} {count:.2f}" for name, count in summary["calls_by_type"].items())
+            print(f"{route:8s} {data['mode']:10s} {summary['requests']:8d} {summary['median_ms']:10.0f} "
+                  f"{summary['p90_ms']:10.0f} {summary['calls_per_request']:10.2f}  {by_type}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    run_parser = commands.add_parser("run", help="send the requests to a running server")
+    run_parser.add_argument("--server", default="http://localhost:8080")
+    run_parser.add_argument("--out", required=True, help="result file to write")
+    run_parser.add_argument("--requests", help="file with one request per line instead of the built-in set")
+    run_parser.add_argument("--repeat", type=int, default=3)
+    run_parser.add_argument("--skip-vision", action="store_true", help="leave out the built-in vision requests")
+
+    compare_parser = commands.add_parser("compare", help="compare result files per route")
+    compare_parser.add_argument("files", nargs="+")
+
+    args = parser.parse_args()
+    if args.command == "run":
+        run(args)
+    else:
+        compare(args)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
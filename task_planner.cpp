@@ -178,19 +178,7 @@ void TaskPlanner::processSinglePlanStep(const json& step_json, TaskPlan& current
             return;
         }
 
-        std::cout << "TaskPlanner: Requesting content generation for prompt: " << gen_prompt << std::endl;
-        // Conceptual call: This function needs to be implemented in ai_model.cpp
-        std::string generated_content = callLLMForTextGeneration(this->api_key, gen_prompt);
-
-        if (generated_content.empty() || generated_content.rfind("Error generating text:", 0) == 0) {
-            task.status = TaskStatus::FAILED;
-            task.error_message = "Failed to generate content: " + generated_content;
-            std::cerr << "TaskPlanner::processSinglePlanStep: " << task.error_message << std::endl;
-            current_plan.tasks.push_back(task);
-            return;
-        }
-        std::cout << "TaskPlanner: Content generated: " << generated_content.substr(0, 50) << "..." << std::endl;
-
+        // Validate before spending a generation call on it
         json subsequent_action_json = step_json.value("subsequent_action", json::object());
         if (subsequent_action_json.empty() || !subsequent_action_json.contains("type")) {
             task.status = TaskStatus::FAILED;
@@ -199,49 +187,24 @@ void TaskPlanner::processSinglePlanStep(const json& step_json, TaskPlan& current
             current_plan.tasks.push_back(task);
             return;
         }
-
-        // Modify the subsequent_action JSON to include the generated content.
-        // This is crucial for the executor.
         std::string sub_action_type = subsequent_action_json["type"].get<std::string>();
-        if (sub_action_type == "vision_task") {
-            // Inject generated content, e.g., as text_to_type or part of a modified objective
-            // A common way is to have a placeholder in the objective like "{{generated_content}}"
-            // or add a specific field like "text_to_type".
-            // For this example, let's assume the vision_task can take "text_to_type".
-            subsequent_action_json["text_to_type"] = generated_content;
-            task.description = subsequent_action_json.value("objective", "Execute vision task with generated content");
-            task.commands.push_back(subsequent_action_json.dump());
-            task.metadata["task_type_for_executor"] = "vision_task";
-
-        } else if (sub_action_type == "powershell_script") {
-            // This is less common for generated text, but possible.
-            // The script itself would need to be designed to use this content.
-            // For example, `echo '${generated_content}' > file.txt`
-            // This requires careful templating of commands.
-            // For now, just pass it in metadata, executor needs to handle it.
-            task.metadata["generated_content"] = generated_content;
-            if (subsequent_action_json.contains("script") && subsequent_action_json["script"].is_array()) {
-                 for (const auto& cmd_template : subsequent_action_json["script"]) {
-                    std::string cmd = cmd_template.get<std::string>();
-                    // Basic templating, replace {{generated_content}} - more robust solution needed for production
-                    size_t pos = cmd.find("{{generated_content}}");
-                    if (pos != std::string::npos) {
-                        cmd.replace(pos, std::string("{{generated_content}}").length(), generated_content);
-                    }
-                    task.commands.push_back(cmd);
-                }
-            }
-            task.description = subsequent_action_json.value("explanation", "Execute PowerShell with generated content");
-            task.metadata["task_type_for_executor"] = "powershell_script";
-        } else {
+        if (sub_action_type != "vision_task" && sub_action_type != "powershell_script") {
             task.status = TaskStatus::FAILED;
             task.error_message = "Unsupported subsequent_action type: " + sub_action_type;
             std::cerr << "TaskPlanner::processSinglePlanStep: " << task.error_message << std::endl;
             current_plan.tasks.push_back(task);
             return;
         }
+
+        // Generation steps never consume each other's output, so every one of them is
+        // sent now and the plan keeps being built while they run. The content is picked
+        // up by resolveGeneratedContent() just before the task executes.
+        std::cout << "TaskPlanner: Requesting content generation for prompt: " << gen_prompt << std::endl;
+        task.pending_content = callLLMForTextGenerationAsync(this->api_key, gen_prompt).share();
+        task.metadata["subsequent_action"] = subsequent_action_json;
+        task.metadata["task_type_for_executor"] = sub_action_type;
         // The explanation for the task should come from the generate_content_and_execute step.
-        task.description = step_json.value("explanation", task.description);
+        task.description = step_json.value("explanation", subsequent_action_json.value("objective", "Execute action with generated content"));
     }
     else {
         task.status = TaskStatus::FAILED;
@@ -252,6 +215,56 @@ void TaskPlanner::processSinglePlanStep(const json& step_json, TaskPlan& current
 }
 
 
+void TaskPlanner::resolveGeneratedContent(Task& task) {
+    if (!task.pending_content.valid()) {
+        return;
+    }
+    std::string generated_content = task.pending_content.get();
+    task.pending_content = std::shared_future<std::string>();
+
+    if (generated_content.empty() || generated_content.rfind("Error:", 0) == 0) {
+        task.status = TaskStatus::FAILED;
+        task.error_message = "Failed to generate content: " + generated_content;
+        std::cerr << "TaskPlanner::resolveGeneratedContent: " << task.error_message << std::endl;
+        return;
+    }
+    std::cout << "TaskPlanner: Content generated: " << generated_content.substr(0, 50) << "..." << std::endl;
+    applyGeneratedContent(task, generated_content);
+}
+
+void TaskPlanner::applyGeneratedContent(Task& task, const std::string& generated_content) {
+    // Modify the subsequent_action JSON to include the generated content.
+    // This is crucial for the executor.
+    json subsequent_action_json = task.metadata.value("subsequent_action", json::object());
+    std::string sub_action_type = subsequent_action_json.value("type", "");
+    if (sub_action_type == "vision_task") {
+        // Inject generated content, e.g., as text_to_type or part of a modified objective
+        // A common way is to have a placeholder in the objective like "{{generated_content}}"
+        // or add a specific field like "text_to_type".
+        // For this example, let's assume the vision_task can take "text_to_type".
+        subsequent_action_json["text_to_type"] = generated_content;
+        task.commands.push_back(subsequent_action_json.dump());
+    } else if (sub_action_type == "powershell_script") {
+        // This is less common for generated text, but possible.
+        // The script itself would need to be designed to use this content.
+        // For example, `echo '${generated_content}' > file.txt`
+        // This requires careful templating of commands.
+        // For now, just pass it in metadata, executor needs to handle it.
+        task.metadata["generated_content"] = generated_content;
+        if (subsequent_action_json.contains("script") && subsequent_action_json["script"].is_array()) {
+             for (const auto& cmd_template : subsequent_action_json["script"]) {
+                std::string cmd = cmd_template.get<std::string>();
+                // Basic templating, replace {{generated_content}} - more robust solution needed for production
+                size_t pos = cmd.find("{{generated_content}}");
+                if (pos != std::string::npos) {
+                    cmd.replace(pos, std::string("{{generated_content}}").length(), generated_content);
+                }
+                task.commands.push_back(cmd);
+            }
+        }
+    }
+}
+
 std::vector<Task> TaskPlanner::breakDownComplexTask(const std::string& task_description) {
     std::vector<Task> subtasks;
     
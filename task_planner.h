@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <future>
 
 using json = nlohmann::json;
 
@@ -26,6 +27,9 @@ struct Task {
     std::string created_at;
     std::string completed_at;
     json metadata;
+    // Set while a generate_content_and_execute step's content is still being generated.
+    // TaskPlanner::resolveGeneratedContent() waits for it and fills in commands.
+    std::shared_future<std::string> pending_content;
 };
 
 struct TaskPlan {
@@ -46,6 +50,7 @@ private:
     std::string generatePlanId();
     TaskPlan createComplexPlan(const std::string& objective, const json& context); // This seems unused, consider removing later
     void processSinglePlanStep(const json& step_json, TaskPlan& current_plan, const std::string& original_request); // Helper declaration
+    static void applyGeneratedContent(Task& task, const std::string& generated_content);
 
 public:
     TaskPlanner(std::string key); // Modified constructor
@@ -57,6 +62,9 @@ public:
     // Execution methods
     bool executeTask(Task& task);
     bool executePlan(TaskPlan& plan);
+    // Blocks until the task's generated content (if any) arrives and turns it into commands.
+    // Call right before executing the task so later generations overlap earlier steps.
+    static void resolveGeneratedContent(Task& task);
     
     // Monitoring methods
     TaskStatus getTaskStatus(const std::string& task_id);
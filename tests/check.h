@@ -0,0 +1,53 @@
+#ifndef TESTS_CHECK_H
+#define TESTS_CHECK_H
+
+#include <iostream>
+
+// Minimal assertions for the unit tests. A failed check prints where and what,
+// the test carries on, and finishTests makes the binary exit non-zero.
+
+namespace check
+{
+    inline int &failures()
+    {
+        static int count = 0;
+        return count;
+    }
+} // namespace check
+
+#define CHECK(condition)                                                                               \
+    do                                                                                                 \
+    {                                                                                                  \
+        if (!(condition))                                                                              \
+        {                                                                                              \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+            ++check::failures();                                                                       \
+        }                                                                                              \
+    } while (0)
+
+// For values that can be streamed (numbers, strings)
+#define CHECK_EQ(actual, expected)                                                                          \
+    do                                                                                                      \
+    {                                                                                                       \
+        const auto &actual_value = (actual);                                                                \
+        const auto &expected_value = (expected);                                                            \
+        if (!(actual_value == expected_value))                                                              \
+        {                                                                                                   \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK_EQ(" #actual ", " #expected ") failed\n"   \
+                      << "  actual:   " << actual_value << "\n  expected: " << expected_value << std::endl; \
+            ++check::failures();                                                                            \
+        }                                                                                                   \
+    } while (0)
+
+inline int finishTests(const char *name)
+{
+    if (check::failures() == 0)
+    {
+        std::cout << name << ": all checks passed" << std::endl;
+        return 0;
+    }
+    std::cerr << name << ": " << check::failures() << " check(s) failed" << std::endl;
+    return 1;
+}
+
+#endif // TESTS_CHECK_H
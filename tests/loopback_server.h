@@ -0,0 +1,146 @@
+#ifndef LOOPBACK_SERVER_H
+#define LOOPBACK_SERVER_H
+
+// Minimal HTTP server on 127.0.0.1 standing in for a chat completions
+// endpoint, for tests and benchmarks that drive LLMClient without a network.
+// It reads each request in full, waits delay_ms and answers 200 with the body
+// reply(n) returns, where n counts requests from 1.
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+class LoopbackServer
+{
+private:
+#ifdef _WIN32
+    using SocketHandle = SOCKET;
+#else
+    using SocketHandle = int;
+#endif
+
+    SocketHandle listener;
+    std::thread accept_thread;
+    std::vector<std::thread> handlers;
+    std::atomic<int> requests{0};
+    int port = 0;
+    int delay_ms;
+    std::function<std::string(int)> reply;
+
+    static void closeSocket(SocketHandle socket)
+    {
+#ifdef _WIN32
+        closesocket(socket);
+#else
+        close(socket);
+#endif
+    }
+
+    void handle(SocketHandle client)
+    {
+        std::string request;
+        std::vector<char> buffer(64 * 1024);
+        size_t header_end = std::string::npos;
+        size_t content_length = 0;
+        while (true)
+        {
+            int received = recv(client, buffer.data(), static_cast<int>(buffer.size()), 0);
+            if (received <= 0)
+            {
+                break;
+            }
+            request.append(buffer.data(), static_cast<size_t>(received));
+            if (header_end == std::string::npos && (header_end = request.find("\r\n\r\n")) != std::string::npos)
+            {
+                size_t length_pos = request.find("Content-Length: ");
+                if (length_pos != std::string::npos && length_pos < header_end)
+                {
+                    content_length = std::strtoul(request.c_str() + length_pos + 16, nullptr, 10);
+                }
+            }
+            if (header_end != std::string::npos && request.size() >= header_end + 4 + content_length)
+            {
+                break;
+            }
+        }
+
+        int n = ++requests;
+        if (delay_ms > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+        }
+        std::string body = reply(n);
+        std::string response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nConnection: close\r\nContent-Length: " +
+                               std::to_string(body.size()) + "\r\n\r\n" + body;
+        send(client, response.data(), static_cast<int>(response.size()), 0);
+        closeSocket(client);
+    }
+
+public:
+    LoopbackServer(int delay_ms, std::function<std::string(int)> reply) : delay_ms(delay_ms), reply(std::move(reply))
+    {
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0; // Any free port
+        bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+        socklen_t length = sizeof(address);
+        getsockname(listener, reinterpret_cast<sockaddr *>(&address), &length);
+        port = ntohs(address.sin_port);
+        listen(listener, 16);
+        accept_thread = std::thread([this]
+                                    {
+            while (true)
+            {
+                SocketHandle client = accept(listener, nullptr, nullptr);
+#ifdef _WIN32
+                if (client == INVALID_SOCKET)
+#else
+                if (client < 0)
+#endif
+                {
+                    return;
+                }
+                handlers.emplace_back(&LoopbackServer::handle, this, client);
+            } });
+    }
+
+    ~LoopbackServer()
+    {
+#ifndef _WIN32
+        shutdown(listener, SHUT_RDWR);
+#endif
+        closeSocket(listener);
+        accept_thread.join();
+        for (std::thread &handler : handlers)
+        {
+            handler.join();
+        }
+    }
+
+    std::string url() const
+    {
+        return "http://127.0.0.1:" + std::to_string(port) + "/v1/chat/completions";
+    }
+
+    int requestCount() const
+    {
+        return requests.load();
+    }
+};
+
+#endif // LOOPBACK_SERVER_H
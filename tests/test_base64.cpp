@@ -0,0 +1,170 @@
+#include "base64.h"
+#include "check.h"
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const Base64Kernel kKernels[] = {Base64Kernel::SCALAR, Base64Kernel::SSSE3, Base64Kernel::AVX2};
+
+    std::vector<unsigned char> randomBytes(size_t length, std::mt19937 &rng)
+    {
+        std::uniform_int_distribution<int> byte(0, 255);
+        std::vector<unsigned char> bytes(length);
+        for (unsigned char &b : bytes)
+        {
+            b = static_cast<unsigned char>(byte(rng));
+        }
+        return bytes;
+    }
+
+    // Encodes into a buffer with guard bytes on both sides, so a kernel that
+    // writes past base64Length() shows up as a changed guard. The input has
+    // exactly `length` bytes, so reading past it trips AddressSanitizer.
+    std::string encoded(Base64Kernel kernel, const std::vector<unsigned char> &bytes)
+    {
+        const size_t guard = 32;
+        std::string buffer(base64Length(bytes.size()) + 2 * guard, '#');
+        encodeBase64With(kernel, bytes.data(), bytes.size(), &buffer[guard]);
+        CHECK_EQ(buffer.substr(0, guard), std::string(guard, '#'));
+        CHECK_EQ(buffer.substr(buffer.size() - guard), std::string(guard, '#'));
+        return buffer.substr(guard, buffer.size() - 2 * guard);
+    }
+
+    std::string encodedText(Base64Kernel kernel, const std::string &text)
+    {
+        return encoded(kernel, std::vector<unsigned char>(text.begin(), text.end()));
+    }
+
+    void testKnownVectors()
+    {
+        for (Base64Kernel kernel : kKernels)
+        {
+            // RFC 4648, section 10
+            CHECK_EQ(encodedText(kernel, ""), "");
+            CHECK_EQ(encodedText(kernel, "f"), "Zg==");
+            CHECK_EQ(encodedText(kernel, "fo"), "Zm8=");
+            CHECK_EQ(encodedText(kernel, "foo"), "Zm9v");
+            CHECK_EQ(encodedText(kernel, "foob"), "Zm9vYg==");
+            CHECK_EQ(encodedText(kernel, "fooba"), "Zm9vYmE=");
+            CHECK_EQ(encodedText(kernel, "foobar"), "Zm9vYmFy");
+
+            // Long enough for the vector loops, and hitting all 64 symbols including '+' and '/'
+            std::vector<unsigned char> all;
+            for (int i = 0; i < 64; ++i)
+            {
+                uint32_t triple = (uint32_t(i) << 18) | (uint32_t(63 - i) << 12) | (uint32_t(i) << 6) | uint32_t(63 - i);
+                all.push_back(static_cast<unsigned char>(triple >> 16));
+                all.push_back(static_cast<unsigned char>(triple >> 8));
+                all.push_back(static_cast<unsigned char>(triple));
+            }
+            const std::string symbols = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            std::string expected;
+            for (int i = 0; i < 64; ++i)
+            {
+                expected += symbols[i];
+                expected += symbols[63 - i];
+                expected += symbols[i];
+                expected += symbols[63 - i];
+            }
+            CHECK_EQ(encoded(kernel, all), expected);
+        }
+    }
+
+    // The SIMD loops stop while 4 spare input bytes remain (16 for SSSE3, 28 for
+    // AVX2) and hand the tail on; every length up to 100 crosses those cut-offs
+    // with each remainder mod 3, mod 12 and mod 24.
+    void testEveryShortLength()
+    {
+        std::mt19937 rng(46);
+        for (size_t length = 0; length <= 100; ++length)
+        {
+            for (int round = 0; round < 8; ++round)
+            {
+                std::vector<unsigned char> bytes = randomBytes(length, rng);
+                if (round == 1)
+                {
+                    bytes.assign(length, 0x00);
+                }
+                else if (round == 2)
+                {
+                    bytes.assign(length, 0xff);
+                }
+                std::string expected = encoded(Base64Kernel::SCALAR, bytes);
+                CHECK_EQ(expected.size(), base64Length(length));
+                for (Base64Kernel kernel : kKernels)
+                {
+                    std::string actual = encoded(kernel, bytes);
+                    if (actual != expected)
+                    {
+                        std::cerr << base64KernelName(kernel) << " differs at length " << length << std::endl;
+                    }
+                    CHECK(actual == expected);
+                }
+            }
+        }
+    }
+
+    void testLargeBuffer()
+    {
+        std::mt19937 rng(1046);
+        // Not a multiple of 3, 12 or 24, so the tail goes through every stage
+        std::vector<unsigned char> bytes = randomBytes(3 * 1024 * 1024 + 17, rng);
+        std::string expected = encoded(Base64Kernel::SCALAR, bytes);
+        for (Base64Kernel kernel : kKernels)
+        {
+            CHECK(encoded(kernel, bytes) == expected);
+
+            // Unaligned input and output
+            std::vector<unsigned char> shifted(bytes.begin() + 1, bytes.end());
+            std::string shifted_expected = encoded(Base64Kernel::SCALAR, shifted);
+            CHECK(encoded(kernel, shifted) == shifted_expected);
+        }
+
+        // encodeBase64 (whichever kernel it picked) agrees too
+        std::string picked(base64Length(bytes.size()), '#');
+        encodeBase64(bytes.data(), bytes.size(), &picked[0]);
+        CHECK(picked == expected);
+    }
+
+    // LLMClient encodes uploads chunk by chunk; every chunk but the last is a multiple of 3
+    void testChunkedEncoding()
+    {
+        std::mt19937 rng(4046);
+        std::vector<unsigned char> bytes = randomBytes(200000 + 2, rng);
+        std::string expected = encoded(Base64Kernel::SCALAR, bytes);
+        for (Base64Kernel kernel : kKernels)
+        {
+            for (size_t chunk : {3u, 12u, 24u, 27u, 48u * 1024u})
+            {
+                std::string out;
+                for (size_t offset = 0; offset < bytes.size(); offset += chunk)
+                {
+                    size_t length = std::min(chunk, bytes.size() - offset);
+                    std::string piece(base64Length(length), '#');
+                    encodeBase64With(kernel, bytes.data() + offset, length, &piece[0]);
+                    out += piece;
+                }
+                CHECK(out == expected);
+            }
+        }
+    }
+} // namespace
+
+int main()
+{
+    for (Base64Kernel kernel : kKernels)
+    {
+        std::cout << "base64 kernel " << base64KernelName(kernel) << ": "
+                  << (base64KernelAvailable(kernel) ? "tested" : "not available, scalar tested in its place") << std::endl;
+    }
+    testKnownVectors();
+    testEveryShortLength();
+    testLargeBuffer();
+    testChunkedEncoding();
+    return finishTests("base64");
+}
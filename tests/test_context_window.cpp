@@ -0,0 +1,153 @@
+#include "context_window.h"
+#include "check.h"
+#include "include/json.hpp"
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Well-formed UTF-8: every lead byte is followed by the right number of continuation bytes
+    bool validUtf8(const std::string &text)
+    {
+        for (size_t i = 0; i < text.size();)
+        {
+            unsigned char lead = static_cast<unsigned char>(text[i]);
+            size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xe ? 3 : (lead >> 3) == 0x1e ? 4 : 0;
+            if (length == 0 || i + length > text.size())
+            {
+                return false;
+            }
+            for (size_t j = 1; j < length; ++j)
+            {
+                if ((static_cast<unsigned char>(text[i + j]) & 0xc0) != 0x80)
+                {
+                    return false;
+                }
+            }
+            i += length;
+        }
+        return true;
+    }
+
+    bool serializable(const std::string &prompt)
+    {
+        try
+        {
+            nlohmann::json({{"role", "user"}, {"content", prompt}}).dump();
+            return true;
+        }
+        catch (const nlohmann::json::exception &)
+        {
+            return false;
+        }
+    }
+
+    std::vector<ContextEntry> steps(size_t count, const std::string &description)
+    {
+        std::vector<ContextEntry> history;
+        for (size_t i = 0; i < count; ++i)
+        {
+            ContextEntry entry;
+            entry.description = description;
+            entry.success = i % 3 != 2;
+            entry.error_message = entry.success ? "" : "element not found";
+            history.push_back(entry);
+        }
+        return history;
+    }
+
+    void testRecentStepsVerbatim()
+    {
+        ContextWindowSettings settings;
+        settings.recent_steps = 2;
+        ContextWindowManager manager(settings);
+
+        int tokens = 0;
+        std::string prompt = manager.buildPrompt("HEADER\n", "SCREEN\n", steps(6, "Click Send"), "FOOTER", tokens);
+        CHECK(prompt.rfind("HEADER\nSCREEN\nPREVIOUS STEPS:\n", 0) == 0);
+        CHECK(prompt.find("Steps 1-4 (summarized): 3 succeeded, 1 failed.") != std::string::npos);
+        CHECK(prompt.find("5. Click Send - SUCCESS\n6. Click Send - FAILED (element not found)\n") != std::string::npos);
+        CHECK(prompt.size() >= 6 && prompt.substr(prompt.size() - 6) == "FOOTER");
+        CHECK_EQ(tokens, ContextWindowManager::estimateTokens(prompt));
+    }
+
+    void testScreenCutAtLineBoundary()
+    {
+        ContextWindowSettings settings;
+        settings.prompt_token_budget = 40;
+        ContextWindowManager manager(settings);
+
+        std::string screen;
+        for (int i = 0; i < 20; ++i)
+        {
+            screen += "e" + std::to_string(i + 1) + "|button|Button " + std::to_string(i + 1) + "|\n";
+        }
+        int tokens = 0;
+        std::string prompt = manager.buildPrompt("H\n", screen, {}, "F", tokens);
+        CHECK(prompt.find("e1|button|Button 1|\n") != std::string::npos);
+        CHECK(prompt.find("e20|") == std::string::npos);
+        CHECK(prompt.find("|\n[...]\n") != std::string::npos); // No half rows
+    }
+
+    // Model text is often not ASCII; a cut inside a character makes the prompt unserializable
+    void testNonAsciiCuts()
+    {
+        const std::string cyrillic = "\xd0\x9d\xd0\xb0\xd0\xb6\xd0\xb0\xd1\x82\xd1\x8c"; // "Нажать", 12 bytes
+        const std::string accented = "\xc3\xa9";                                        // "é"
+
+        // Summarized descriptions are cut to 60 bytes, here inside a 2-byte character
+        ContextWindowSettings settings;
+        settings.recent_steps = 1;
+        ContextWindowManager manager(settings);
+        std::string description = "xx";
+        for (int i = 0; i < 8; ++i)
+        {
+            description += " " + cyrillic;
+        }
+        int tokens = 0;
+        std::string prompt = manager.buildPrompt("H\n", "", steps(4, description), "F", tokens);
+        CHECK(prompt.find("(summarized)") != std::string::npos);
+        CHECK(validUtf8(prompt));
+        CHECK(serializable(prompt));
+
+        // A screen section with no line break that fits is cut mid-line, at every possible byte offset
+        for (int offset = 0; offset < 4; ++offset)
+        {
+            settings = ContextWindowSettings();
+            settings.prompt_token_budget = 30;
+            manager.setSettings(settings);
+            std::string screen = std::string(offset, 'x');
+            for (int i = 0; i < 100; ++i)
+            {
+                screen += accented + cyrillic;
+            }
+            prompt = manager.buildPrompt("H\n", screen, {}, "F", tokens);
+            CHECK(prompt.find("[...]") != std::string::npos);
+            CHECK(validUtf8(prompt));
+            CHECK(serializable(prompt));
+        }
+
+        // A history that still does not fit after folding keeps whole lines only
+        settings = ContextWindowSettings();
+        settings.prompt_token_budget = 20;
+        settings.recent_steps = 1;
+        manager.setSettings(settings);
+        std::string long_step;
+        for (int i = 0; i < 50; ++i)
+        {
+            long_step += cyrillic + accented;
+        }
+        prompt = manager.buildPrompt("H\n", "", steps(1, "x" + long_step), "F", tokens);
+        CHECK(prompt.find("[...]") != std::string::npos);
+        CHECK(validUtf8(prompt));
+        CHECK(serializable(prompt));
+    }
+} // namespace
+
+int main()
+{
+    testRecentStepsVerbatim();
+    testScreenCutAtLineBoundary();
+    testNonAsciiCuts();
+    return finishTests("context_window");
+}
@@ -0,0 +1,166 @@
+#include "element_table.h"
+#include "check.h"
+#include "include/json.hpp"
+#include <string>
+#include <vector>
+
+namespace
+{
+    UIElement makeElement(const std::string &type, const std::string &text, const std::string &description = "",
+                          int x = 0, int y = 0, int width = 10, int height = 10)
+    {
+        UIElement element;
+        element.x = x;
+        element.y = y;
+        element.width = width;
+        element.height = height;
+        element.type = type;
+        element.text = text;
+        element.description = description;
+        element.confidence = 0.9;
+        return element;
+    }
+
+    void testElementIds()
+    {
+        CHECK_EQ(elementId(0), "e1");
+        CHECK_EQ(elementId(41), "e42");
+
+        CHECK_EQ(elementIndexFromId("e7", 10), 6);
+        CHECK_EQ(elementIndexFromId("E7", 10), 6);
+        CHECK_EQ(elementIndexFromId("[e7]", 10), 6);
+        CHECK_EQ(elementIndexFromId("\"e7\"", 10), 6);
+        CHECK_EQ(elementIndexFromId("e7 - Send button", 10), 6);
+        CHECK_EQ(elementIndexFromId("e10", 10), 9);
+
+        CHECK_EQ(elementIndexFromId("e11", 10), -1); // Out of range
+        CHECK_EQ(elementIndexFromId("e0", 10), -1);
+        CHECK_EQ(elementIndexFromId("e7x", 10), -1); // Start of a word, not an id
+        CHECK_EQ(elementIndexFromId("edit", 10), -1);
+        CHECK_EQ(elementIndexFromId("Send button", 10), -1);
+        CHECK_EQ(elementIndexFromId("e", 10), -1);
+        CHECK_EQ(elementIndexFromId("", 10), -1);
+    }
+
+    void testRankingOrder()
+    {
+        std::vector<UIElement> elements = {
+            makeElement("label", "Inbox"),
+            makeElement("text", "Send feedback"),
+            makeElement("button", "Send"),
+            makeElement("label", "Archive")};
+
+        // Exact text match on a button beats a text match on plain text; unmatched elements keep their order
+        std::vector<size_t> order = rankElements(elements, "click the Send button", {}, 10);
+        CHECK(order == std::vector<size_t>({2, 1, 0, 3}));
+
+        // Stop words alone match nothing: interactive elements first, then the vision model's order
+        std::vector<UIElement> plain = {
+            makeElement("label", "Title"),
+            makeElement("button", "OK"),
+            makeElement("label", "Subtitle"),
+            makeElement("input_field", "")};
+        order = rankElements(plain, "please do it for me", {}, 10);
+        CHECK(order == std::vector<size_t>({1, 3, 0, 2}));
+
+        // Words that appear on fewer elements weigh more
+        std::vector<UIElement> chats = {
+            makeElement("text", "Alice chat"),
+            makeElement("text", "Bob chat"),
+            makeElement("text", "Carol chat")};
+        order = rankElements(chats, "open the chat with Bob", {}, 10);
+        CHECK_EQ(order.front(), 1u);
+
+        // Prefixes of at least four characters count: "messag" finds "Messages"
+        std::vector<UIElement> tabs = {
+            makeElement("tab", "Calls"),
+            makeElement("tab", "Messages")};
+        order = rankElements(tabs, "go to messag", {}, 10);
+        CHECK_EQ(order.front(), 1u);
+    }
+
+    void testFailedTargetsAreDemoted()
+    {
+        std::vector<UIElement> elements = {
+            makeElement("button", "Send"),
+            makeElement("icon", "", "send arrow")};
+
+        std::vector<size_t> order = rankElements(elements, "click send", {}, 10);
+        CHECK(order == std::vector<size_t>({0, 1}));
+
+        // After clicking "Send" failed, the alternative surfaces first
+        order = rankElements(elements, "click send", {"Send"}, 10);
+        CHECK(order == std::vector<size_t>({1, 0}));
+    }
+
+    void testTopKTruncation()
+    {
+        std::vector<UIElement> elements;
+        for (int i = 0; i < 30; ++i)
+        {
+            elements.push_back(makeElement("label", "Item " + std::to_string(i)));
+        }
+        elements[17].text = "Settings";
+
+        std::vector<size_t> order = rankElements(elements, "open settings", {}, 5);
+        CHECK_EQ(order.size(), 5u);
+        CHECK_EQ(order.front(), 17u);
+        CHECK(std::vector<size_t>(order.begin() + 1, order.end()) == std::vector<size_t>({0, 1, 2, 3}));
+
+        CHECK_EQ(rankElements(elements, "open settings", {}, 100).size(), 30u);
+        CHECK(rankElements(elements, "open settings", {}, 0).empty());
+        CHECK(rankElements({}, "open settings", {}, 5).empty());
+    }
+
+    void testTableEncoding()
+    {
+        std::vector<UIElement> elements = {
+            makeElement("button", "Send", "send", 10, 20, 30, 40),
+            makeElement("input_field", "", "Message box", 5, 6, 7, 8),
+            makeElement("text", "a|b\nc   d", "Line\twith  tabs"),
+            makeElement("label", std::string(50, 'x'))};
+
+        // Rows follow the given order; ids stay tied to the original index
+        std::string table = renderElementTable(elements, {1, 0}, true);
+        CHECK_EQ(table,
+                 "id|type|text|description|x,y,w,h\n"
+                 "e2|input_field||Message box|5,6,7,8\n"
+                 "e1|button|Send||10,20,30,40\n"); // Description repeating the text is left out
+
+        table = renderElementTable(elements, {0}, false);
+        CHECK_EQ(table, "id|type|text|description\ne1|button|Send|\n");
+
+        // Separators and runs of whitespace inside fields collapse to one space
+        table = renderElementTable(elements, {2}, false);
+        CHECK_EQ(table, "id|type|text|description\ne3|text|a b c d|Line with tabs\n");
+
+        // Long text is cut to 40 characters, ending in "..."
+        table = renderElementTable(elements, {3}, false);
+        CHECK_EQ(table, "id|type|text|description\ne4|label|" + std::string(37, 'x') + "...|\n");
+
+        // The cut backs up to a character boundary: 36 ASCII bytes then "é" (2 bytes) would split it at 37
+        std::vector<UIElement> accented = {makeElement("label", std::string(36, 'x') + "\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9")};
+        table = renderElementTable(accented, {0}, false);
+        CHECK_EQ(table, "id|type|text|description\ne1|label|" + std::string(36, 'x') + "...|\n");
+        CHECK_EQ(nlohmann::json(table).dump().size(), table.size() + 4); // Serializable; two quotes and two escaped newlines
+
+        std::vector<UIElement> cyrillic = {makeElement("label", "\xd0\x9f\xd0\xb0\xd0\xbf\xd0\xba\xd0\xb0 " + std::string(40, 'x'))};
+        table = renderElementTable(cyrillic, {0}, false);
+        CHECK_EQ(table, "id|type|text|description\ne1|label|\xd0\x9f\xd0\xb0\xd0\xbf\xd0\xba\xd0\xb0 " + std::string(26, 'x') + "...|\n");
+
+        // Indices past the end are skipped
+        table = renderElementTable(elements, {9, 0}, false);
+        CHECK_EQ(table, "id|type|text|description\ne1|button|Send|\n");
+        CHECK_EQ(renderElementTable(elements, {}, false), "id|type|text|description\n");
+    }
+} // namespace
+
+int main()
+{
+    testElementIds();
+    testRankingOrder();
+    testFailedTargetsAreDemoted();
+    testTopKTruncation();
+    testTableEncoding();
+    return finishTests("element_table");
+}
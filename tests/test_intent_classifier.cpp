@@ -0,0 +1,135 @@
+#include "intent_classifier.h"
+#include "check.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace
+{
+    const char *kLog = "test_intent_training.jsonl";
+
+    int logLines()
+    {
+        std::ifstream log(kLog);
+        int lines = 0;
+        std::string line;
+        while (std::getline(log, line))
+        {
+            ++lines;
+        }
+        return lines;
+    }
+
+    std::shared_ptr<IntentClassifier> makeClassifier(const IntentClassifierSettings &settings)
+    {
+        std::remove(kLog);
+        auto classifier = std::make_shared<IntentClassifier>();
+        classifier->configure(settings);
+        return classifier;
+    }
+
+    IntentClassifierSettings untrainedSettings()
+    {
+        IntentClassifierSettings settings;
+        settings.min_training_examples = 50; // Never confident in these tests
+        settings.audit_rate = 0.0;
+        settings.training_log = kLog;
+        return settings;
+    }
+
+    // Unsure requests ask the intent LLM, and its answer is learned and logged
+    void testIntentAnswersAreLearned()
+    {
+        auto classifier = makeClassifier(untrainedSettings());
+        int intent_calls = 0;
+        IntentOracle ask_intent = [&](const std::string &, bool &is_vision)
+        {
+            ++intent_calls;
+            is_vision = true;
+            return true;
+        };
+        bool is_vision = false;
+        CHECK(classifier->route("Open Notepad", ask_intent, is_vision));
+        CHECK(is_vision);
+        CHECK_EQ(intent_calls, 1);
+        CHECK_EQ(classifier->getStats().value("training_examples", -1L), 1L);
+        CHECK_EQ(classifier->getStats().value("llm_decisions", -1L), 1L);
+        CHECK_EQ(logLines(), 1);
+    }
+
+    // Under fused routing the plan type decides, but it is neither learned nor logged
+    void testPlanAnswersAreNotLearned()
+    {
+        auto classifier = makeClassifier(untrainedSettings());
+        int intent_calls = 0, plan_calls = 0;
+        IntentOracle ask_intent = [&](const std::string &, bool &)
+        {
+            ++intent_calls;
+            return false;
+        };
+        IntentOracle ask_plan = [&](const std::string &, bool &is_vision)
+        {
+            ++plan_calls;
+            is_vision = true;
+            return true;
+        };
+        bool is_vision = false;
+        CHECK(classifier->route("Open Notepad", ask_intent, is_vision, ask_plan));
+        CHECK(is_vision);
+        CHECK_EQ(plan_calls, 1);
+        CHECK_EQ(intent_calls, 0);
+        json stats = classifier->getStats();
+        CHECK_EQ(stats.value("plan_decisions", -1L), 1L);
+        CHECK_EQ(stats.value("llm_decisions", -1L), 0L);
+        CHECK_EQ(stats.value("training_examples", -1L), 0L);
+        CHECK_EQ(logLines(), 0);
+    }
+
+    // Audits of confident local decisions ask the intent LLM, never for a plan
+    void testAuditsAskForIntent()
+    {
+        IntentClassifierSettings settings = untrainedSettings();
+        settings.min_training_examples = 0;
+        settings.confidence_threshold = 0.5; // Every prediction is confident
+        settings.audit_rate = 1.0;
+        auto classifier = makeClassifier(settings);
+
+        std::atomic<int> intent_calls{0}, plan_calls{0};
+        IntentOracle ask_intent = [&](const std::string &, bool &is_vision)
+        {
+            is_vision = false;
+            ++intent_calls;
+            return true;
+        };
+        IntentOracle ask_plan = [&](const std::string &, bool &)
+        {
+            ++plan_calls;
+            return false;
+        };
+        bool is_vision = false;
+        CHECK(classifier->route("What is the capital of France?", ask_intent, is_vision, ask_plan));
+
+        // The audit runs on a background thread
+        for (int i = 0; i < 200 && classifier->getStats().value("training_examples", 0L) == 0; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        CHECK_EQ(intent_calls.load(), 1);
+        CHECK_EQ(plan_calls.load(), 0);
+        CHECK_EQ(classifier->getStats().value("audits", -1L), 1L);
+        CHECK_EQ(classifier->getStats().value("training_examples", -1L), 1L);
+    }
+} // namespace
+
+int main()
+{
+    testIntentAnswersAreLearned();
+    testPlanAnswersAreNotLearned();
+    testAuditsAskForIntent();
+    std::remove(kLog);
+    return finishTests("intent_classifier");
+}
@@ -0,0 +1,247 @@
+#include "json_repair.h"
+#include "llm_response.h"
+#include "check.h"
+#include <iostream>
+#include <string>
+
+namespace
+{
+    // repairJson output for text, or "<none>" when nothing could be recovered
+    std::string repaired(const std::string &text, bool *truncated = nullptr)
+    {
+        std::string out;
+        if (!repairJson(text, out, truncated))
+        {
+            return "<none>";
+        }
+        if (!json::accept(out))
+        {
+            return "<invalid: " + out + ">";
+        }
+        return out;
+    }
+
+    // extractEmbeddedJson result dumped, or "<none>"
+    std::string extracted(const std::string &text, bool *was_repaired = nullptr)
+    {
+        json out;
+        auto parse = [](const char *begin, const char *end, json &parsed)
+        {
+            parsed = json::parse(begin, end, nullptr, false);
+            return !parsed.is_discarded();
+        };
+        std::streambuf *log = std::cerr.rdbuf(nullptr); // Failures are logged; here they are expected
+        bool found = extractEmbeddedJson(text, out, parse, was_repaired);
+        std::cerr.rdbuf(log);
+        return found ? out.dump() : "<none>";
+    }
+
+    // Every member of partial is in full with the same value, except that
+    // objects may miss members and arrays may miss trailing elements. This is
+    // what a reply cut off part way and then repaired must look like.
+    bool isPrefixOf(const json &partial, const json &full)
+    {
+        if (partial.is_object())
+        {
+            if (!full.is_object())
+            {
+                return false;
+            }
+            for (auto it = partial.begin(); it != partial.end(); ++it)
+            {
+                if (!full.contains(it.key()) || !isPrefixOf(it.value(), full[it.key()]))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        if (partial.is_array())
+        {
+            // Array elements are kept only when they arrived in full
+            if (!full.is_array() || partial.size() > full.size())
+            {
+                return false;
+            }
+            for (size_t i = 0; i < partial.size(); ++i)
+            {
+                if (partial[i] != full[i])
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        return partial == full;
+    }
+
+    void testTrailingAndMissingCommas()
+    {
+        CHECK_EQ(repaired(R"({"type": "text", "content": "hi",})"), R"({"type":"text","content":"hi"})");
+        CHECK_EQ(repaired(R"([1, 2, 3,])"), "[1,2,3]");
+        CHECK_EQ(repaired(R"({"a": [1, 2,], "b": {"c": 1,},})"), R"({"a":[1,2],"b":{"c":1}})");
+        CHECK_EQ(repaired(R"([1,,2])"), "[1,2]");
+        CHECK_EQ(repaired(R"({"a": 1 "b": 2})"), R"({"a":1,"b":2})");
+        CHECK_EQ(repaired(R"([{"a": 1} {"b": 2}])"), R"([{"a":1},{"b":2}])");
+    }
+
+    void testLooseSyntax()
+    {
+        CHECK_EQ(repaired(R"({a: 'single', b: True, c: None, d: +1, e: .5})"),
+                 R"({"a":"single","b":true,"c":null,"d":1,"e":0.5})");
+        CHECK_EQ(repaired("{\"a\": 1, // comment\n /* block */ \"b\": 2}"), R"({"a":1,"b":2})");
+        CHECK_EQ(repaired("{\"text\": \"line one\nline two\", \"bad\": \"\\q\"}"), R"({"text":"line one\nline two","bad":"q"})");
+        CHECK_EQ(repaired(R"({"a": "\u00e9\ud83d\ude00"})"), "{\"a\":\"\xc3\xa9\xf0\x9f\x98\x80\"}");
+        CHECK_EQ(repaired(R"({"a":})"), "{}");
+        CHECK_EQ(repaired(R"({"a": [1, 2}})"), R"({"a":[1,2]})"); // Wrong closer closes what is open
+        CHECK_EQ(repaired("no json here"), "<none>");
+    }
+
+    void testTruncatedObjectsAndArrays()
+    {
+        bool truncated = false;
+
+        // A partly written array element is dropped whole
+        CHECK_EQ(repaired(R"({"elements": [{"type": "button", "text": "OK", "bbox": [1, 2, 3, 4]}, {"type": "text", "text": "Can)", &truncated),
+                 R"({"elements":[{"type":"button","text":"OK","bbox":[1,2,3,4]}]})");
+        CHECK(truncated);
+        CHECK_EQ(repaired(R"({"elements": [{"type": "button", "text": "OK", "bbox": [1, 2, 3, 4]}, {"type": "te)"),
+                 R"({"elements":[{"type":"button","text":"OK","bbox":[1,2,3,4]}]})");
+        CHECK_EQ(repaired(R"([{"a": 1}, {"b": 2)"), R"([{"a":1}])");
+        CHECK_EQ(repaired(R"({"elements": [)"), R"({"elements":[]})");
+
+        // An object keeps the members that arrived; a number may have been cut short
+        CHECK_EQ(repaired(R"({"action": "click", "target": "Send", "confidence": 0.9)", &truncated), R"({"action":"click","target":"Send"})");
+        CHECK(truncated);
+        CHECK_EQ(repaired(R"({"action": "click", "target": "Send", "confidence": 0.)"), R"({"action":"click","target":"Send"})");
+        CHECK_EQ(repaired(R"({"key")"), "{}");
+
+        // Complete input is not reported as truncated
+        CHECK_EQ(repaired(R"({"a": 1})", &truncated), R"({"a":1})");
+        CHECK(!truncated);
+    }
+
+    void testUnterminatedStrings()
+    {
+        bool truncated = false;
+        CHECK_EQ(repaired(R"({"action": "click", "target": "Send", "reason": "The send butt)", &truncated),
+                 R"({"action":"click","target":"Send"})");
+        CHECK(truncated);
+        CHECK_EQ(repaired(R"({"key": "val)"), "{}");
+        CHECK_EQ(repaired(R"(["one", "two", "thr)"), R"(["one","two"])");
+        CHECK_EQ(repaired(R"({"a": "ends in an escape \)"), "{}");
+        CHECK_EQ(repaired(R"({"a": "x", "b": "\u00)"), R"({"a":"x"})");
+    }
+
+    void testEmbeddedJson()
+    {
+        bool was_repaired = true;
+
+        // Fenced
+        CHECK_EQ(extracted("```json\n{\"type\": \"text\", \"content\": \"a\"}\n```", &was_repaired), R"({"content":"a","type":"text"})");
+        CHECK(!was_repaired);
+        CHECK_EQ(extracted("```json\n[{\"a\":1}]```"), R"([{"a":1}])");
+
+        // Prose around it, and brackets in the prose before it
+        CHECK_EQ(extracted("Sure! Here is the plan: {\"type\": \"text\", \"content\": \"done\"} Hope that helps."),
+                 R"({"content":"done","type":"text"})");
+        CHECK_EQ(extracted("Use {x} to refer to it. The answer is {\"a\": 1}."), R"({"a":1})");
+        CHECK_EQ(extracted("I think [the answer] is {\"a\": [1,2]} ok"), R"({"a":[1,2]})");
+        CHECK_EQ(extracted("The reply is {\"text\": \"a } inside a string\"}."), R"({"text":"a } inside a string"})");
+
+        // Only valid after repair
+        CHECK_EQ(extracted("Here:\n```json\n{\"steps\": [1, 2,],}\n```\nDone.", &was_repaired), R"({"steps":[1,2]})");
+        CHECK(was_repaired);
+
+        // Cut off: the outer value is repaired instead of returning a complete inner piece
+        CHECK_EQ(extracted("The plan:\n{\"steps\": [{\"n\": 1}, {\"n\": 2}, {\"n\"", &was_repaired), R"({"steps":[{"n":1},{"n":2}]})");
+        CHECK(was_repaired);
+
+        CHECK_EQ(extracted("nothing"), "<none>");
+        CHECK_EQ(extracted("{x}"), "<none>"); // A repair that keeps nothing is not a recovery
+    }
+
+    // Cuts a valid reply at every length and checks that what comes back is
+    // strict JSON holding only members and elements that arrived in full
+    void sweepCutOffs(const std::string &name, const std::string &reply, const std::string &prose_before)
+    {
+        json full = json::parse(reply);
+        size_t first_bracket = reply.find_first_of("{[");
+        int failures_before = check::failures();
+        size_t last_kept = 0;
+        for (size_t length = 0; length <= reply.size(); ++length)
+        {
+            std::string prefix = reply.substr(0, length);
+            std::string out;
+            bool truncated = false;
+            bool ok = repairJson(prefix, out, &truncated);
+            if (length <= first_bracket)
+            {
+                CHECK(!ok);
+                continue;
+            }
+            json value = json::parse(out, nullptr, false);
+            CHECK(ok);
+            CHECK(!value.is_discarded());
+            CHECK(isPrefixOf(value, full));
+            CHECK_EQ(truncated, length < reply.size());
+
+            // More text never loses what was recovered from less
+            size_t kept = value.dump().size();
+            CHECK(kept >= last_kept);
+            last_kept = kept;
+
+            // Through extractEmbeddedJson, behind prose: the outer value or nothing
+            std::string embedded = extracted(prose_before + prefix);
+            if (embedded != "<none>")
+            {
+                json embedded_value = json::parse(embedded);
+                CHECK(embedded_value.type() == full.type());
+                CHECK(isPrefixOf(embedded_value, full));
+            }
+            if (check::failures() > failures_before)
+            {
+                std::cerr << "  " << name << " cut at " << length << ": " << prefix << std::endl;
+                return;
+            }
+        }
+        CHECK(json::parse(repaired(reply)) == full);
+    }
+
+    void testCutOffSweeps()
+    {
+        // Screen analysis element list, as the vision model writes it
+        sweepCutOffs("elements", R"([
+  {"type": "button", "text": "Send", "bbox": [1180, 940, 1240, 972]},
+  {"type": "input_field", "text": "Type a message", "bbox": [320, 940, 1160, 972]},
+  {"type": "text", "text": "Quote \"this\" \\ and \u00e9", "bbox": [10, -5, 20.5, 30]},
+  {"type": "icon", "text": "", "bbox": []}
+])", "");
+
+        // Agent plan, pretty-printed, behind prose
+        json plan = {
+            {"type", "multi_step_plan"},
+            {"objective", "Write a note"},
+            {"steps", {{{"action", "open"}, {"target", "Notepad"}, {"wait_ms", 500}},
+                       {{"action", "type"}, {"text", "hello, world {not json}"}, {"enter", true}},
+                       {{"action", "save"}, {"path", nullptr}}}},
+            {"confidence", 0.85},
+            {"nested", {{"depth", {{"level", 2}, {"items", {1, 2, 3}}}}}}};
+        sweepCutOffs("plan", plan.dump(2), "Here is the plan you asked for:\n");
+
+        // Vision action with the model's usual style
+        sweepCutOffs("action", R"({"action": "click", "target": "e12", "value": "", "reasoning": "The Send button [e12] sends it", "confidence": 0.92})",
+                     "```json\n");
+    }
+} // namespace
+
+int main()
+{
+    testTrailingAndMissingCommas();
+    testLooseSyntax();
+    testTruncatedObjectsAndArrays();
+    testUnterminatedStrings();
+    testEmbeddedJson();
+    testCutOffSweeps();
+    return finishTests("json_repair");
+}
@@ -0,0 +1,80 @@
+#include "llm_client.h"
+#include "llm_cassette.h"
+#include "check.h"
+#include "loopback_server.h"
+#include <cstdio>
+#include <string>
+
+namespace
+{
+    // Answers every POST after a delay, so calls submitted together are still
+    // in flight when the next one arrives. Each response body carries the
+    // request counter: {"n": 1}, {"n": 2}, ...
+    class SlowServer : public LoopbackServer
+    {
+    public:
+        SlowServer() : LoopbackServer(300, [](int n)
+                                      { return "{\"n\": " + std::to_string(n) + "}"; })
+        {
+        }
+    };
+
+    LLMRequest makeRequest(const std::string &url, const std::string &prompt)
+    {
+        LLMRequest request;
+        request.url = url;
+        request.call_type = LLMCallType::CONTENT_GENERATION;
+        request.body = "{\"model\": \"test\", \"messages\": [{\"role\": \"user\", \"content\": \"" + prompt + "\"}]}";
+        return request;
+    }
+
+    // Identical calls coalesced while recording must each find a record on replay,
+    // without taking the record of a later call of the same type.
+    void testCoalescedCallsReplay(SlowServer &server, const std::string &path)
+    {
+        std::string same, same_again, other;
+        {
+            LLMClient client;
+            CHECK(client.getCassette().open(CassetteMode::RECORD, path, false));
+            std::future<LLMResponse> first = client.submit(makeRequest(server.url(), "same"));
+            std::future<LLMResponse> second = client.submit(makeRequest(server.url(), "same"));
+            same = first.get().body;
+            same_again = second.get().body;
+            other = client.submit(makeRequest(server.url(), "other")).get().body;
+        }
+        CHECK_EQ(server.requestCount(), 2); // The identical pair went out once
+        CHECK_EQ(same, "{\"n\": 1}");
+        CHECK_EQ(same_again, same);
+        CHECK_EQ(other, "{\"n\": 2}");
+
+        for (bool replay_latency : {false, true})
+        {
+            LLMClient client;
+            CHECK(client.getCassette().open(CassetteMode::REPLAY, path, replay_latency));
+            std::future<LLMResponse> first = client.submit(makeRequest(server.url(), "same"));
+            std::future<LLMResponse> second = client.submit(makeRequest(server.url(), "same"));
+            std::future<LLMResponse> third = client.submit(makeRequest(server.url(), "other"));
+            LLMResponse replayed_other = third.get();
+            CHECK_EQ(first.get().body, same);
+            CHECK_EQ(second.get().body, same);
+            CHECK_EQ(replayed_other.body, other);
+            CHECK(replayed_other.error.empty());
+        }
+        CHECK_EQ(server.requestCount(), 2); // Nothing went over the network on replay
+    }
+} // namespace
+
+int main()
+{
+#ifdef _WIN32
+    WSADATA wsa;
+    WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+    const std::string path = "test_llm_cassette.cassette";
+    {
+        SlowServer server;
+        testCoalescedCallsReplay(server, path);
+    }
+    std::remove(path.c_str());
+    return finishTests("llm_cassette");
+}
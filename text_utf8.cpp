@@ -0,0 +1,21 @@
+#include "text_utf8.h"
+
+size_t utf8CutPosition(const std::string &text, size_t max_bytes)
+{
+    if (max_bytes >= text.size())
+    {
+        return text.size();
+    }
+    // Continuation bytes are 10xxxxxx; a character starts at any other byte
+    size_t cut = max_bytes;
+    while (cut > 0 && (static_cast<unsigned char>(text[cut]) & 0xc0) == 0x80)
+    {
+        --cut;
+    }
+    return cut;
+}
+
+std::string utf8Prefix(const std::string &text, size_t max_bytes)
+{
+    return text.substr(0, utf8CutPosition(text, max_bytes));
+}
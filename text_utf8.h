@@ -0,0 +1,17 @@
+#ifndef TEXT_UTF8_H
+#define TEXT_UTF8_H
+
+#include <cstddef>
+#include <string>
+
+// Byte-limited cuts of model and screen text that never split a UTF-8
+// character. A prompt holding half a character cannot be serialized by
+// json::dump, so every cut of text that goes into a request uses these.
+
+// Largest cut position <= max_bytes that is not inside a multi-byte character
+size_t utf8CutPosition(const std::string &text, size_t max_bytes);
+
+// The first max_bytes bytes of text, backed up to a character boundary
+std::string utf8Prefix(const std::string &text, size_t max_bytes);
+
+#endif // TEXT_UTF8_H
@@ -1,5 +1,6 @@
 #include "vision_guided_executor.h"
 #include "ai_model.h"
+#include "element_table.h"
 #include <iostream>
 #include <chrono>
 #include <fstream>
@@ -16,6 +17,49 @@
 #endif
 #include <windows.h>
 
+namespace
+{
+    // A screen analysis this recent stands in for a new capture. Covers the gap
+    // between a step's after-state and the next step's planning, not a recovery wait.
+    const long kScreenReuseMs = 1500;
+
+    const size_t kPromptElements = 15; // Rows of the element table in a planning prompt
+
+    // What failed steps were aimed at, with element ids resolved against the screen they were planned on
+    std::vector<std::string> failedTargets(const std::vector<VisionTaskStep> &steps)
+    {
+        std::vector<std::string> targets;
+        for (const auto &step : steps)
+        {
+            const std::string &target = step.action.target_description;
+            if (step.success || target.empty())
+            {
+                continue;
+            }
+            int index = elementIndexFromId(target, step.before_state.elements.size());
+            if (index < 0)
+            {
+                targets.push_back(target);
+                continue;
+            }
+            const UIElement &element = step.before_state.elements[index];
+            targets.push_back(element.text.empty() ? element.description : element.text);
+        }
+        return targets;
+    }
+
+    std::vector<ContextEntry> toContextEntries(const std::vector<VisionTaskStep> &steps)
+    {
+        std::vector<ContextEntry> entries;
+        entries.reserve(steps.size());
+        for (const auto &step : steps)
+        {
+            entries.push_back({step.description, step.success, step.error_message});
+        }
+        return entries;
+    }
+} // namespace
+
 VisionGuidedExecutor::VisionGuidedExecutor(const std::string &api_key)
     : ai_api_key(api_key), temp_directory("temp/vision_tasks"),
       max_steps(20), verification_attempts(3)
@@ -33,7 +77,20 @@ VisionGuidedExecutor::~VisionGuidedExecutor()
     // Cleanup handled by smart pointers
 }
 
-VisionTaskExecution VisionGuidedExecutor::executeVisionTask(const std::string &task)
+ScreenAnalysis VisionGuidedExecutor::observeScreen(ExecutionContext &context)
+{
+    ScreenAnalysis state;
+    if (context.getFreshScreen(kScreenReuseMs, state))
+    {
+        return state;
+    }
+    state = vision_processor->analyzeCurrentScreen();
+    context.setScreen(state);
+    return state;
+}
+
+VisionTaskExecution VisionGuidedExecutor::executeVisionTask(const std::string &task,
+                                                            std::shared_ptr<ExecutionContext> context)
 {
     auto start_time = std::chrono::high_resolution_clock::now();
 
@@ -42,11 +99,16 @@ VisionTaskExecution VisionGuidedExecutor::executeVisionTask(const std::string &t
     execution.overall_success = false;
 
     std::cout << "🎯 Starting vision task: " << task << std::endl;
+    if (!context)
+    {
+        context = std::make_shared<ExecutionContext>(task);
+    }
+    json analyses_before = vision_processor->getAnalysisStats();
 
     try
     {
         // Initial screen analysis
-        ScreenAnalysis initial_state = vision_processor->analyzeCurrentScreen();
+        ScreenAnalysis initial_state = observeScreen(*context);
         std::cout << "📸 Initial screen captured: " << initial_state.application_name << std::endl;
 
         // Execute steps iteratively
@@ -54,8 +116,8 @@ VisionTaskExecution VisionGuidedExecutor::executeVisionTask(const std::string &t
         {
             std::cout << "📋 Planning step " << (step_count + 1) << "..." << std::endl;
 
-            // Get current screen state
-            ScreenAnalysis current_state = vision_processor->analyzeCurrentScreen();
+            // Get current screen state (the initial or previous after-state while still fresh)
+            ScreenAnalysis current_state = observeScreen(*context);
 
             // Plan next action
             VisionAction action = planNextAction(task, current_state, execution.steps);
@@ -72,6 +134,7 @@ VisionTaskExecution VisionGuidedExecutor::executeVisionTask(const std::string &t
             step.description = action.explanation;
             step.action = action;
             step.before_state = current_state;
+            step.prompt_tokens = action.metadata.value("prompt_tokens", 0);
 
             std::cout << "⚡ Executing: " << action.explanation << std::endl;
 
@@ -84,6 +147,7 @@ VisionTaskExecution VisionGuidedExecutor::executeVisionTask(const std::string &t
             // Capture after state
             std::this_thread::sleep_for(std::chrono::milliseconds(500)); // Wait for UI to update
             step.after_state = vision_processor->analyzeCurrentScreen();
+            context->setScreen(step.after_state);
 
             // Verify action success
             if (step.success)
@@ -144,6 +208,22 @@ VisionTaskExecution VisionGuidedExecutor::executeVisionTask(const std::string &t
                                  std::to_string(execution.steps.size()) + " steps";
     }
 
+    execution.metadata["context"] = context->getStats();
+
+    json analyses_after = vision_processor->getAnalysisStats();
+    int model_calls = analyses_after["model_calls"].get<int>() - analyses_before["model_calls"].get<int>();
+    int reused = analyses_after["reused"].get<int>() - analyses_before["reused"].get<int>();
+    int cached = analyses_after["cached"].get<int>() - analyses_before["cached"].get<int>();
+    int cropped = analyses_after["cropped"].get<int>() - analyses_before["cropped"].get<int>();
+    execution.metadata["screen_analyses"] = {
+        {"model_calls", model_calls}, {"model_calls_avoided", reused + cached}, {"reused", reused}, {"cached", cached},
+        {"cropped", cropped}};
+    if (reused + cached + cropped > 0)
+    {
+        std::cout << "♻️ Screen analyses: " << model_calls << " sent to the model (" << cropped << " as a changed region only), "
+                  << reused << " reused (screen unchanged), " << cached << " from the screen cache" << std::endl;
+    }
+
     std::cout << "📊 Task execution completed in " << execution.total_time << " seconds" << std::endl;
     return execution;
 }
@@ -190,37 +270,27 @@ VisionAction VisionGuidedExecutor::planNextAction(const std::string &task,
     try
     {
         // Build context for DeepSeek R1
-        std::string context = "TASK: " + task + "\n\n";
-        context += "CURRENT SCREEN STATE:\n";
-        context += "Application: " + current_state.application_name + "\n";
-        context += "Window Title: " + current_state.window_title + "\n";
-        context += "Description: " + current_state.overall_description + "\n\n";
-
-        // Add available UI elements
-        context += "AVAILABLE UI ELEMENTS:\n";
-        for (size_t i = 0; i < current_state.elements.size() && i < 15; i++)
-        {
-            const auto &element = current_state.elements[i];
-            context += std::to_string(i + 1) + ". " + element.description;
-            if (!element.text.empty())
-            {
-                context += " (text: \"" + element.text + "\")";
-            }
-            context += " [" + element.type + "]\n";
-        }
+        std::string header = "TASK: " + task + "\n\n";
 
-        // Add previous steps context
-        if (!previous_steps.empty())
-        {
-            context += "\nPREVIOUS STEPS:\n";
-            for (size_t i = 0; i < previous_steps.size(); i++)
-            {
-                context += std::to_string(i + 1) + ". " + previous_steps[i].description;
-                context += " - " + std::string(previous_steps[i].success ? "SUCCESS" : "FAILED") + "\n";
-            }
-        }
+        std::string screen_section = "CURRENT SCREEN STATE:\n";
+        screen_section += "Application: " + current_state.application_name + "\n";
+        screen_section += "Window Title: " + current_state.window_title + "\n";
+        screen_section += "Description: " + current_state.overall_description + "\n\n";
 
-        context += "\nDetermine the next action to accomplish the task. Focus on the main content area of the application.";
+        // Most relevant elements first, so the budget trim in buildPrompt drops the least useful rows
+        std::vector<size_t> ranked = rankElements(current_state.elements, task, failedTargets(previous_steps), kPromptElements);
+        screen_section += "AVAILABLE UI ELEMENTS (" + std::to_string(ranked.size()) + " of " +
+                          std::to_string(current_state.elements.size()) + ", most relevant first):\n";
+        screen_section += renderElementTable(current_state.elements, ranked, false);
+        screen_section += "\n";
+
+        std::string footer = "Determine the next action to accomplish the task. Focus on the main content area of the application. "
+                             "Set target_description to the element's id (e.g. \"e3\") when it is in the table.";
+
+        // Older steps are folded into a summary so the prompt stays within budget
+        int prompt_tokens = 0;
+        std::string context = context_window.buildPrompt(header, screen_section, toContextEntries(previous_steps), footer, prompt_tokens);
+        std::cout << "🧮 Planning prompt: ~" << prompt_tokens << " tokens (" << previous_steps.size() << " previous steps)" << std::endl;
 
         // Call AI Model for vision guidance. This now returns a direct JSON object (the action itself)
         // or a fallback JSON action from callVisionAIModel if it failed.
@@ -241,6 +311,7 @@ VisionAction VisionGuidedExecutor::planNextAction(const std::string &task,
             action.confidence = 0.1;
             action.wait_time = 2000; // Increased wait time for such errors
         }
+        action.metadata["prompt_tokens"] = prompt_tokens;
     }
     catch (const std::exception &e)
     {
@@ -258,7 +329,8 @@ VisionAction VisionGuidedExecutor::planNextAction(const std::string &task,
 // Intelligent task analyzer that combines NLP parsing with vision guidance
 VisionAction VisionGuidedExecutor::analyzeTaskIntelligently(const std::string &task,
                                                             const ScreenAnalysis &current_state,
-                                                            const std::vector<VisionTaskStep> &previous_steps)
+                                                            const std::vector<VisionTaskStep> &previous_steps,
+                                                            std::shared_ptr<ExecutionContext> context)
 {
     VisionAction action;
     std::string lower_task = task;
@@ -267,7 +339,7 @@ VisionAction VisionGuidedExecutor::analyzeTaskIntelligently(const std::string &t
     std::cout << "🧠 Intelligently analyzing task: " << task << std::endl;
 
     // Parse task components using NLP-like analysis
-    TaskComponents components = parseTaskComponents(task);
+    TaskComponents components = parseTaskComponents(task, context);
 
     // Analyze current progress
     TaskProgress progress = analyzeTaskProgress(components, previous_steps, current_state);
@@ -339,14 +411,16 @@ VisionAction VisionGuidedExecutor::analyzeTaskIntelligently(const std::string &t
 
 // TODO: Unit Test: Add tests for parseTaskComponents, mocking callIntentAI and checking correct TaskComponents creation.
 // Parse task into actionable components using NLP techniques
-TaskComponents VisionGuidedExecutor::parseTaskComponents(const std::string &task)
+TaskComponents VisionGuidedExecutor::parseTaskComponents(const std::string &task, std::shared_ptr<ExecutionContext> context)
 {
     TaskComponents components;
 
-    // Use AI to dynamically analyze the task instead of hardcoded parsing
+    // Use AI to dynamically analyze the task instead of hardcoded parsing. The
+    // request's intent is usually known already from routing it.
     try
     {
-        json intent = callIntentAI(ai_api_key, task);
+        json intent = context && context->getRequest() == task ? context->getOrComputeIntent(ai_api_key)
+                                                               : callIntentAI(ai_api_key, task);
 
         if (!intent.empty())
         {
@@ -745,33 +819,13 @@ std::string VisionGuidedExecutor::createVisionPrompt(const std::string &task,
                                                      const std::string &screen_description,
                                                      const std::vector<VisionTaskStep> &previous_steps)
 {
-    std::stringstream prompt;
+    std::stringstream header;
+    header << "You are an AI assistant that helps automate Windows tasks by controlling the mouse and keyboard.\n\n";
+    header << "CURRENT TASK: " << task << "\n\n";
 
-    prompt << "You are an AI assistant that helps automate Windows tasks by controlling the mouse and keyboard.\n\n";
-    prompt << "CURRENT TASK: " << task << "\n\n";
-    prompt << "CURRENT SCREEN DESCRIPTION:\n";
-    prompt << screen_description << "\n\n";
-
-    if (!previous_steps.empty())
-    {
-        prompt << "PREVIOUS ACTIONS TAKEN:\n";
-        for (size_t i = 0; i < previous_steps.size(); ++i)
-        {
-            const auto &step = previous_steps[i];
-            prompt << (i + 1) << ". " << step.description;
-            if (step.success)
-            {
-                prompt << " ✅";
-            }
-            else
-            {
-                prompt << " ❌ (" << step.error_message << ")";
-            }
-            prompt << "\n";
-        }
-        prompt << "\n";
-    }
+    std::string screen_section = "CURRENT SCREEN DESCRIPTION:\n" + screen_description + "\n\n";
 
+    std::stringstream prompt;
     prompt << "Based on the current screen and task, determine the NEXT SINGLE ACTION to take.\n\n";
     prompt << "YOU MUST respond with ONLY a JSON object in this EXACT format:\n\n";
     prompt << "```json\n";
@@ -804,7 +858,8 @@ std::string VisionGuidedExecutor::createVisionPrompt(const std::string &task,
     prompt << "- Only use 'complete' when the entire task is 100% finished\n";
     prompt << "- Respond ONLY with the JSON, no other text\n";
 
-    return prompt.str();
+    int prompt_tokens = 0;
+    return context_window.buildPrompt(header.str(), screen_section, toContextEntries(previous_steps), prompt.str(), prompt_tokens);
 }
 
 VisionAction VisionGuidedExecutor::parseGeminiResponse(const json &response, const std::string &task, const ScreenAnalysis &current_state)
@@ -945,6 +1000,15 @@ bool VisionGuidedExecutor::executeClick(const std::string &target, const ScreenA
         return true;
     }
 
+    // An id from the planning prompt's element table names the element outright
+    int id_index = elementIndexFromId(target, state.elements.size());
+    if (id_index >= 0)
+    {
+        const UIElement &element = state.elements[id_index];
+        std::cout << "✅ Found element " << elementId(id_index) << ": " << element.text << " (type: " << element.type << ")" << std::endl;
+        return vision_processor->clickElement(element);
+    }
+
     // First, try to find element by exact text match
     UIElement target_element = vision_processor->findElementByText(target, state);
 
@@ -1102,6 +1166,15 @@ bool VisionGuidedExecutor::executeType(const std::string &target, const std::str
 {
     std::cout << "⌨️ Looking for text input: " << target << " to type: " << text << std::endl;
 
+    // The planner picked a specific element by id; trust it over the heuristics below
+    int id_index = elementIndexFromId(target, state.elements.size());
+    if (id_index >= 0)
+    {
+        const UIElement &element = state.elements[id_index];
+        std::cout << "✅ Typing into element " << elementId(id_index) << ": " << element.text << " (type: " << element.type << ")" << std::endl;
+        return vision_processor->typeAtElement(element, text);
+    }
+
     // Always try to use smart text element detection first to avoid search boxes
     std::cout << "🔍 Using intelligent text input detection..." << std::endl;
     UIElement bestTextArea = findBestTextInputElement(state);
@@ -1423,6 +1496,16 @@ void VisionGuidedExecutor::setMaxSteps(int max)
     max_steps = max;
 }
 
+void VisionGuidedExecutor::setContextWindowSettings(const ContextWindowSettings &settings)
+{
+    context_window.setSettings(settings);
+}
+
+void VisionGuidedExecutor::setVisionCaptureSettings(const VisionCaptureSettings &settings)
+{
+    vision_processor->setCaptureSettings(settings);
+}
+
 void VisionGuidedExecutor::setTempDirectory(const std::string &path)
 {
     temp_directory = path;
@@ -3,6 +3,8 @@
 
 #include "vision_processor.h"
 #include "ai_model.h"
+#include "context_window.h"
+#include "execution_context.h"
 #include "include/json.hpp"
 #include <opencv2/opencv.hpp>
 #include <string>
@@ -73,6 +75,7 @@ struct VisionTaskStep
     bool success;
     std::string error_message;
     double execution_time;
+    int prompt_tokens = 0; // Estimated size of the planning prompt for this step
 };
 
 struct VisionTaskExecution
@@ -116,6 +119,11 @@ private:
     std::string temp_directory;
     int max_steps;
     int verification_attempts;
+    ContextWindowManager context_window; // Bounds planning prompt size as steps accumulate
+
+    // Screen analysis for the current step: reuses the request context's if it is still fresh.
+    // The context is passed down rather than kept on the executor, which serves concurrent requests.
+    ScreenAnalysis observeScreen(ExecutionContext &context);
 
     // Dynamic AI-powered intent analysis
     UserIntent analyzeUserIntent(const std::string &command);
@@ -173,6 +181,8 @@ public:
     void setMaxSteps(int max);
     void setTempDirectory(const std::string &path);
     void setAIApiKey(const std::string &key);
+    void setContextWindowSettings(const ContextWindowSettings &settings);
+    void setVisionCaptureSettings(const VisionCaptureSettings &settings);
 
     // Access methods
     ScreenAnalysis getCurrentScreenState();
@@ -196,8 +206,10 @@ public:
     // Intelligent task analysis methods
     VisionAction analyzeTaskIntelligently(const std::string &task,
                                           const ScreenAnalysis &current_state,
-                                          const std::vector<VisionTaskStep> &previous_steps);
-    TaskComponents parseTaskComponents(const std::string &task);
+                                          const std::vector<VisionTaskStep> &previous_steps,
+                                          std::shared_ptr<ExecutionContext> context = nullptr);
+    // Reuses the context's intent when it is for this task, otherwise asks the intent model
+    TaskComponents parseTaskComponents(const std::string &task, std::shared_ptr<ExecutionContext> context = nullptr);
     TaskProgress analyzeTaskProgress(const TaskComponents &components,
                                      const std::vector<VisionTaskStep> &previous_steps,
                                      const ScreenAnalysis &current_state);
@@ -241,7 +253,8 @@ public:
     bool attemptRecovery(const VisionTaskStep &failed_step);
 
     // Main execution interface
-    VisionTaskExecution executeVisionTask(const std::string &task);
+    VisionTaskExecution executeVisionTask(const std::string &task,
+                                          std::shared_ptr<ExecutionContext> context = nullptr);
     VisionTaskExecution executeVisionTaskWithContext(const std::string &task,
                                                      const json &context);
 
@@ -6,83 +6,39 @@
 #include <iomanip>
 #include <algorithm>
 #include <cmath>
-#include <psapi.h> // Windows API
 #include <opencv2/opencv.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/imgcodecs.hpp>
-#include <curl/curl.h> // Added for network requests
 #include <cstdlib>     // For std::getenv
+#include <future>
 
 #include "vision_processor.h" // Project-specific header
+#include "llm_client.h"
+#include "llm_backend.h"
+#include "element_table.h"
+#include "llm_metrics.h"
+#include "json_repair.h"
+#include "llm_response.h"
+#include "screen_cache.h"
+#include "text_utf8.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef _WINSOCKAPI_
+#define _WINSOCKAPI_ // Prevent inclusion of winsock.h
+#endif
+#include <windows.h> // Mouse and keyboard input
+#endif
 
 namespace { // Anonymous namespace for utility functions
-    std::string base64_encode(const std::string& file_path) {
-        std::ifstream image_file(file_path, std::ios::binary);
-        if (!image_file.is_open()) {
-            std::cerr << "Error opening image file for base64 encoding: " << file_path << std::endl;
-            return "";
-        }
-        std::ostringstream os;
-        os << image_file.rdbuf();
-        std::string file_content = os.str();
-
-        const std::string base64_chars =
-                    "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-                    "abcdefghijklmnopqrstuvwxyz"
-                    "0123456789+/";
-
-        std::string ret;
-        int i = 0;
-        int j = 0;
-        unsigned char char_array_3[3];
-        unsigned char char_array_4[4];
-
-        for (char const& c : file_content) {
-            char_array_3[i++] = c;
-            if (i == 3) {
-                char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-                char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-                char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-                char_array_4[3] = char_array_3[2] & 0x3f;
-
-                for (i = 0; (i < 4); i++)
-                    ret += base64_chars[char_array_4[i]];
-                i = 0;
-            }
-        }
-
-        if (i) {
-            for (j = i; j < 3; j++)
-                char_array_3[j] = '\0'; // Use '\0' for padding
-
-            char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-            char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-            char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-            // char_array_4[3] should not be assigned if char_array_3[2] is padding.
-            // The original code had char_array_4[3] = char_array_3[2] & 0x3f; which might be problematic with padding.
-            // Let's adhere to the provided code for now, but this is a common spot for base64 bugs.
-
-            for (j = 0; (j < i + 1); j++)
-                ret += base64_chars[char_array_4[j]];
-
-            while ((i++ < 3))
-                ret += '=';
-        }
-        return ret;
-    }
-
-    // libcurl write callback function
-    size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* s) {
-        size_t newLength = size * nmemb;
-        try {
-            s->append((char*)contents, newLength);
-        } catch (std::bad_alloc& e) {
-            // Handle memory problem
-            std::cerr << "Failed to allocate memory in WriteCallback: " << e.what() << std::endl;
-            return 0;
-        }
-        return newLength;
-    }
+    // Stands in for the image data URL in the JSON envelope; the real bytes are streamed
+    const char* kImageUrlPlaceholder = "__STREAMED_IMAGE_DATA_URL__";
+    const size_t kLogPreviewChars = 200; // Of an error body, so a large reply does not flood the log
+    const size_t kDescriptionElements = 10; // Rows listed by generateScreenDescription
+    const int kGateWidth = 480;             // Width of the grayscale frame compared by frameChanged and the screen cache
+    const int kMinDirtyArea = 64;           // Dilated gate pixels; smaller changes (a caret blink) do not widen the crop
 } // end anonymous namespace
 
 VisionProcessor::VisionProcessor() : temp_directory("temp/vision"), opencv_available(true)
@@ -93,7 +49,11 @@ VisionProcessor::VisionProcessor() : temp_directory("temp/vision"), opencv_avail
 
 VisionProcessor::~VisionProcessor()
 {
-    // Cleanup if needed
+    // Let the last background save finish
+    if (pending_save.valid())
+    {
+        pending_save.wait();
+    }
 }
 
 // Removed captureWindowScreenshot - unused
@@ -101,168 +61,213 @@ VisionProcessor::~VisionProcessor()
 // Removed findTextFields - unused
 // Removed findTemplateMatches - unused
 
-std::string VisionProcessor::captureScreenshot()
+ScreenSource &VisionProcessor::screenSource()
 {
-    auto now = std::chrono::system_clock::now();
-    auto time_point = std::chrono::system_clock::to_time_t(now);
-    std::tm tm_struct = *std::localtime(&time_point); // Use std::tm for formatting
-
-    std::stringstream ss_filename;
-    // Format timestamp for filename to avoid issues with special characters in default std::time_t string
-    ss_filename << temp_directory << "/screenshot_"
-                << std::put_time(&tm_struct, "%Y%m%d_%H%M%S")
-                << ".png"; // Default to PNG
-    std::string filename = ss_filename.str();
-
-    int width = GetSystemMetrics(SM_CXSCREEN);
-    int height = GetSystemMetrics(SM_CYSCREEN);
-
-    if (opencv_available)
+    if (!screen_source)
     {
-        HDC hScreenDC = GetDC(NULL);
-        HDC hMemoryDC = CreateCompatibleDC(hScreenDC);
-        HBITMAP hBitmap = CreateCompatibleBitmap(hScreenDC, width, height);
-        HBITMAP hOldBitmap = (HBITMAP)SelectObject(hMemoryDC, hBitmap);
-
-        BitBlt(hMemoryDC, 0, 0, width, height, hScreenDC, 0, 0, SRCCOPY);
-
-        BITMAPINFOHEADER bi;
-        bi.biSize = sizeof(BITMAPINFOHEADER);
-        bi.biWidth = width;
-        bi.biHeight = -height; // Negative height to indicate top-down DIB
-        bi.biPlanes = 1;
-        bi.biBitCount = 32; // 32-bit for easier OpenCV processing with alpha
-        bi.biCompression = BI_RGB;
-        bi.biSizeImage = 0;
-        bi.biXPelsPerMeter = 0;
-        bi.biYPelsPerMeter = 0;
-        bi.biClrUsed = 0;
-        bi.biClrImportant = 0;
-
-        cv::Mat mat(height, width, CV_8UC4); // 4 channels for BGRA
-
-        GetDIBits(hScreenDC, hBitmap, 0, (UINT)height, mat.data, (BITMAPINFO *)&bi, DIB_RGB_COLORS);
+        screen_source = std::make_unique<DesktopScreenSource>();
+    }
+    return *screen_source;
+}
 
-        try
-        {
-            if (cv::imwrite(filename, mat))
-            {
-                std::cout << "📸 Screenshot saved as PNG: " << filename << std::endl;
-            }
-            else
-            {
-                std::cerr << "❌ Failed to save screenshot as PNG using OpenCV: " << filename << std::endl;
-                // Potentially fallback to BMP if PNG fails, or just return empty
-                filename = "";
-            }
-        }
-        catch (const cv::Exception &ex)
+bool VisionProcessor::captureFrame()
+{
+    try
+    {
+        if (screenSource().capture(frame))
         {
-            std::cerr << "❌ OpenCV exception when saving PNG: " << ex.what() << std::endl;
-            filename = "";
+            return true;
         }
+    }
+    catch (const cv::Exception &ex)
+    {
+        std::cerr << "❌ OpenCV exception while capturing the screen: " << ex.what() << std::endl;
+    }
+    std::cerr << "❌ No frame from screen source: " << screen_source->describe() << std::endl;
+    return false;
+}
 
-        SelectObject(hMemoryDC, hOldBitmap);
-        DeleteObject(hBitmap);
-        DeleteDC(hMemoryDC);
-        ReleaseDC(NULL, hScreenDC);
-
-        return filename;
+bool VisionProcessor::encodeFrame(EncodedFrame &encoded, const cv::Rect &region)
+{
+    auto started = std::chrono::steady_clock::now();
+    // Reuse the buffer unless an upload or a background save still holds it
+    if (!encoded_frame || encoded_frame.use_count() > 1)
+    {
+        encoded_frame = std::make_shared<std::vector<unsigned char>>();
     }
-    else
+    try
     {
-        // Fallback to BMP saving if OpenCV is not available
-        // This is a basic GDI capture.
-        std::stringstream ss_bmp_filename;
-        ss_bmp_filename << temp_directory << "/screenshot_"
-                        << std::put_time(&tm_struct, "%Y%m%d_%H%M%S")
-                        << ".bmp";
-        filename = ss_bmp_filename.str();
-        std::cout << "📸 OpenCV not available, attempting to save screenshot as BMP: " << filename << std::endl;
-
-        HDC hScreenDC = GetDC(NULL);
-        HDC hMemoryDC = CreateCompatibleDC(hScreenDC);
-        HBITMAP hBitmap = CreateCompatibleBitmap(hScreenDC, width, height);
-        HBITMAP hOldBitmap = (HBITMAP)SelectObject(hMemoryDC, hBitmap);
-        BitBlt(hMemoryDC, 0, 0, width, height, hScreenDC, 0, 0, SRCCOPY);
-
-        BITMAPFILEHEADER bmfHeader;
-        BITMAPINFOHEADER bi;
-        bi.biSize = sizeof(BITMAPINFOHEADER);
-        bi.biWidth = width;
-        bi.biHeight = height;
-        bi.biPlanes = 1;
-        bi.biBitCount = 24; // BMP typically 24-bit
-        bi.biCompression = BI_RGB;
-        bi.biSizeImage = 0; // Can be 0 for BI_RGB
-        bi.biXPelsPerMeter = 0;
-        bi.biYPelsPerMeter = 0;
-        bi.biClrUsed = 0;
-        bi.biClrImportant = 0;
-
-        DWORD dwBmpSize = ((width * bi.biBitCount + 31) / 32) * 4 * height;
-        HANDLE hDIB = GlobalAlloc(GHND, dwBmpSize);
-        if (!hDIB)
+        // No encoder wants the alpha channel, and a GDI capture's is meaningless anyway
+        cv::cvtColor(frame(region), bgr_frame, cv::COLOR_BGRA2BGR);
+        const cv::Mat *source = &bgr_frame;
+        int long_edge = std::max(region.width, region.height);
+        if (capture_settings.max_long_edge > 0 && long_edge > capture_settings.max_long_edge)
         {
-            std::cerr << "❌ GlobalAlloc failed for BMP DIB" << std::endl;
-            DeleteDC(hMemoryDC);
-            ReleaseDC(NULL, hScreenDC);
-            return "";
+            double scale = static_cast<double>(capture_settings.max_long_edge) / long_edge;
+            cv::Size size(std::max(1, static_cast<int>(std::lround(region.width * scale))),
+                          std::max(1, static_cast<int>(std::lround(region.height * scale))));
+            cv::resize(bgr_frame, upload_frame, size, 0, 0, cv::INTER_AREA); // Area averaging keeps small text legible
+            source = &upload_frame;
         }
-        char *lpbitmap = (char *)GlobalLock(hDIB);
-        if (!lpbitmap)
+
+        std::vector<int> params;
+        if (capture_settings.format == "jpeg")
         {
-            std::cerr << "❌ GlobalLock failed for BMP DIB" << std::endl;
-            GlobalFree(hDIB);
-            DeleteDC(hMemoryDC);
-            ReleaseDC(NULL, hScreenDC);
-            return "";
+            params = {cv::IMWRITE_JPEG_QUALITY, capture_settings.quality};
+            encoded.mime_type = "image/jpeg";
+            encoded.extension = ".jpg";
         }
-
-        GetDIBits(hScreenDC, hBitmap, 0, (UINT)height, lpbitmap, (BITMAPINFO *)&bi, DIB_RGB_COLORS);
-
-        std::ofstream file(filename, std::ios::binary);
-        if (file.is_open())
+        else if (capture_settings.format == "webp")
         {
-            DWORD dwSizeofDIB = dwBmpSize + sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
-            bmfHeader.bfOffBits = (DWORD)sizeof(BITMAPFILEHEADER) + (DWORD)sizeof(BITMAPINFOHEADER);
-            bmfHeader.bfSize = dwSizeofDIB;
-            bmfHeader.bfType = 0x4D42; // 'BM'
-
-            file.write((char *)&bmfHeader, sizeof(BITMAPFILEHEADER));
-            file.write((char *)&bi, sizeof(BITMAPINFOHEADER));
-            file.write(lpbitmap, dwBmpSize);
-            file.close();
-            std::cout << "📸 Screenshot saved as BMP: " << filename << std::endl;
+            params = {cv::IMWRITE_WEBP_QUALITY, capture_settings.quality};
+            encoded.mime_type = "image/webp";
+            encoded.extension = ".webp";
         }
         else
         {
-            std::cerr << "❌ Failed to open file to save BMP: " << filename << std::endl;
-            filename = "";
+            if (capture_settings.png_compression >= 0)
+            {
+                params = {cv::IMWRITE_PNG_COMPRESSION, capture_settings.png_compression};
+            }
+            encoded.mime_type = "image/png";
+            encoded.extension = ".png";
+        }
+        if (!cv::imencode(encoded.extension, *source, *encoded_frame, params))
+        {
+            std::cerr << "❌ Failed to encode screenshot as " << capture_settings.format << std::endl;
+            return false;
         }
+        encoded.bytes = encoded_frame;
+        encoded.width = source->cols;
+        encoded.height = source->rows;
+        encoded.cropped = region.width < frame.cols || region.height < frame.rows;
+        encoded.offset_x = region.x;
+        encoded.offset_y = region.y;
+        encoded.scale_x = static_cast<double>(source->cols) / region.width;
+        encoded.scale_y = static_cast<double>(source->rows) / region.height;
+        encoded.encode_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        return true;
+    }
+    catch (const cv::Exception &ex)
+    {
+        std::cerr << "❌ OpenCV exception when encoding screenshot: " << ex.what() << std::endl;
+    }
+    return false;
+}
 
-        GlobalUnlock(hDIB);
-        GlobalFree(hDIB);
-        SelectObject(hMemoryDC, hOldBitmap);
-        DeleteObject(hBitmap);
-        DeleteDC(hMemoryDC);
-        ReleaseDC(NULL, hScreenDC);
+std::string VisionProcessor::newScreenshotPath(const std::string &extension) const
+{
+    auto now = std::chrono::system_clock::now();
+    auto time_point = std::chrono::system_clock::to_time_t(now);
+    std::tm tm_struct = *std::localtime(&time_point); // Use std::tm for formatting
+    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000;
+
+    std::stringstream ss_filename;
+    // Format timestamp for filename to avoid issues with special characters in default std::time_t string
+    ss_filename << temp_directory << "/screenshot_"
+                << std::put_time(&tm_struct, "%Y%m%d_%H%M%S") << "_" << std::setw(3) << std::setfill('0') << millis
+                << extension;
+    return ss_filename.str();
+}
 
-        return filename;
+std::string VisionProcessor::saveFrameAsync(std::shared_ptr<const std::vector<unsigned char>> image, const std::string &extension)
+{
+    std::string filename = newScreenshotPath(extension);
+    // Wait for the previous write so a slow disk can't pile up frames in memory
+    if (pending_save.valid())
+    {
+        pending_save.wait();
+    }
+    pending_save = std::async(std::launch::async, [image, filename]()
+                              {
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.write(reinterpret_cast<const char *>(image->data()), static_cast<std::streamsize>(image->size()))) {
+            std::cerr << "❌ Failed to save screenshot: " << filename << std::endl;
+        } });
+    return filename;
+}
+
+std::string VisionProcessor::captureScreenshot()
+{
+    EncodedFrame image;
+    if (!captureFrame() || !encodeFrame(image, cv::Rect(0, 0, frame.cols, frame.rows)))
+    {
+        return "";
+    }
+    std::string filename = newScreenshotPath(image.extension);
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.write(reinterpret_cast<const char *>(image.bytes->data()), static_cast<std::streamsize>(image.bytes->size())))
+    {
+        std::cerr << "❌ Failed to save screenshot: " << filename << std::endl;
+        return "";
     }
+    std::cout << "📸 Screenshot saved: " << filename << std::endl;
+    return filename;
 }
 
 ScreenAnalysis VisionProcessor::analyzeCurrentScreen()
 {
     ScreenAnalysis analysis;
-
-    // Capture screenshot
-    analysis.screenshot_path = captureScreenshot();
+    auto started = std::chrono::steady_clock::now();
 
     // Get active window info
-    HWND activeWindow = getActiveWindow();
-    analysis.window_title = getWindowTitle(activeWindow);
-    analysis.application_name = getApplicationName(activeWindow);
+    ForegroundWindow window = screenSource().foregroundWindow();
+    analysis.window_title = window.title;
+    analysis.application_name = window.application;
+
+    bool captured = captureFrame();
+    bool gated = captured && makeGateFrame();
+    if (gated && !frameChanged(analysis.window_title, analysis.application_name))
+    {
+        // Nothing visible changed since the last analysis; asking the model again would return the same
+        ++reused_analyses;
+        ScreenAnalysis reused = last_analysis;
+        reused.metadata["timestamp"] = std::time(nullptr);
+        reused.metadata["reused"] = true;
+        reused.metadata.erase("upload");
+        std::cout << "♻️ Screen unchanged, reusing the last analysis" << std::endl;
+        return reused;
+    }
+
+    // A screen seen before, in this task or an earlier one
+    ScreenAnalysisCache &cache = ScreenAnalysisCache::instance();
+    ScreenHash hash = {};
+    if (gated && cache.isEnabled())
+    {
+        hash = computeScreenHash(gate_frame);
+        ScreenAnalysis cached;
+        if (cache.lookup(hash, analysis.window_title, analysis.application_name, gate_frame, frame.cols, frame.rows,
+                         std::max(capture_settings.change_threshold, 0.0), cached))
+        {
+            ++cached_analyses;
+            cached.metadata = {
+                {"timestamp", std::time(nullptr)},
+                {"window_handle", window.handle},
+                {"screen_resolution", {frame.cols, frame.rows}},
+                {"element_count", cached.elements.size()},
+                {"cached", true}};
+            last_analysis = cached;
+            has_last_analysis = true;
+            full_description = cached.overall_description;
+            std::swap(analyzed_gate_frame, gate_frame);
+            std::cout << "🗂️ Screen seen before, using its cached analysis" << std::endl;
+            return cached;
+        }
+    }
+
+    // Same window with part of it changed: send only that part and merge it into the last analysis
+    cv::Rect region(0, 0, frame.cols, frame.rows);
+    bool cropped = gated && capture_settings.crop_changes && has_last_analysis &&
+                   analysis.window_title == last_analysis.window_title &&
+                   analysis.application_name == last_analysis.application_name && dirtyRegion(region);
+
+    // Encode in memory; the file, if kept at all, is written off the critical path
+    EncodedFrame image;
+    bool encoded = captured && encodeFrame(image, region);
+    if (encoded && capture_settings.save_screenshots)
+    {
+        analysis.screenshot_path = saveFrameAsync(image.bytes, image.extension);
+    }
 
     // Detect UI elements
     // analysis.elements = detectUIElements(analysis.screenshot_path); // Removed
@@ -270,20 +275,177 @@ ScreenAnalysis VisionProcessor::analyzeCurrentScreen()
     // analysis.overall_description = generateScreenDescription(analysis); // Removed
 
     // Call Qwen analysis
-    ScreenAnalysis qwen_analysis = analyzeImageWithQwen(analysis.screenshot_path);
-    analysis.overall_description = qwen_analysis.overall_description;
-    analysis.elements = qwen_analysis.elements; // If Qwen provides elements
+    ScreenAnalysis qwen_analysis;
+    json upload;
+    if (encoded)
+    {
+        upload = {
+            {"format", capture_settings.format},
+            {"width", image.width},
+            {"height", image.height},
+            {"bytes", image.bytes->size()},
+            {"encode_ms", image.encode_ms}};
+        if (cropped)
+        {
+            upload["region"] = {region.x, region.y, region.width, region.height};
+            std::cout << "✂️ Changed region " << region.width << "x" << region.height << " at " << region.x << "," << region.y
+                      << " of the screen" << std::endl;
+        }
+        std::cout << "🖼️ Frame " << frame.cols << "x" << frame.rows << " sent as " << image.width << "x" << image.height
+                  << " " << capture_settings.format << ", " << image.bytes->size() / 1024 << " KB, encoded in "
+                  << std::fixed << std::setprecision(1) << image.encode_ms << " ms" << std::endl;
+        qwen_analysis = analyzeImageWithQwen(std::move(image));
+        ++model_analyses;
+        cropped_analyses += cropped ? 1 : 0;
+    }
+    else
+    {
+        qwen_analysis.overall_description = "Error: Failed to capture the screen.";
+    }
+    // Only an answered analysis can stand in for later frames; a failed one is retried next time
+    bool answered = qwen_analysis.metadata.is_object() && qwen_analysis.metadata.value("answered", false);
+    if (cropped && answered)
+    {
+        // Elements overlapping the region were re-detected, or cut in half by it; everything else is still on screen.
+        // A point-sized element still counts as one pixel.
+        for (const UIElement &element : last_analysis.elements)
+        {
+            cv::Rect bounds(element.x, element.y, std::max(element.width, 1), std::max(element.height, 1));
+            if ((bounds & region).area() == 0)
+            {
+                analysis.elements.push_back(element);
+            }
+        }
+        analysis.elements.insert(analysis.elements.end(), qwen_analysis.elements.begin(), qwen_analysis.elements.end());
+        analysis.overall_description = full_description + "\n\nChanged since then, in the region at (" + std::to_string(region.x) +
+                                       ", " + std::to_string(region.y) + ") size " + std::to_string(region.width) + "x" +
+                                       std::to_string(region.height) + ": " + qwen_analysis.overall_description;
+    }
+    else
+    {
+        analysis.overall_description = qwen_analysis.overall_description;
+        analysis.elements = qwen_analysis.elements; // If Qwen provides elements
+        if (answered)
+        {
+            full_description = analysis.overall_description;
+        }
+    }
 
     // Add metadata
     analysis.metadata = {
         {"timestamp", std::time(nullptr)},
-        {"window_handle", reinterpret_cast<uintptr_t>(activeWindow)},
-        {"screen_resolution", {GetSystemMetrics(SM_CXSCREEN), GetSystemMetrics(SM_CYSCREEN)}},
+        {"window_handle", window.handle},
+        {"screen_resolution", {frame.cols, frame.rows}},
         {"element_count", analysis.elements.size()}};
+    if (!upload.is_null())
+    {
+        upload["step_ms"] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        analysis.metadata["upload"] = upload;
+    }
 
+    has_last_analysis = answered;
+    if (has_last_analysis)
+    {
+        last_analysis = analysis;
+        if (gated)
+        {
+            if (cache.isEnabled())
+            {
+                cache.insert(hash, analysis.window_title, analysis.application_name, gate_frame, frame.cols, frame.rows, analysis);
+            }
+            std::swap(analyzed_gate_frame, gate_frame);
+        }
+        else
+        {
+            analyzed_gate_frame.release();
+        }
+    }
     return analysis;
 }
 
+bool VisionProcessor::makeGateFrame()
+{
+    try
+    {
+        // Small enough to compare cheaply, large enough that a word of new text shows
+        int gate_height = std::max(1, static_cast<int>(std::lround(frame.rows * static_cast<double>(kGateWidth) / frame.cols)));
+        cv::cvtColor(frame, gate_gray, cv::COLOR_BGRA2GRAY); // Before scaling: one channel is cheaper to average
+        cv::resize(gate_gray, gate_frame, cv::Size(kGateWidth, gate_height), 0, 0, cv::INTER_AREA);
+        return true;
+    }
+    catch (const cv::Exception &ex)
+    {
+        std::cerr << "❌ OpenCV exception while downscaling the frame: " << ex.what() << std::endl;
+        gate_frame.release();
+        return false;
+    }
+}
+
+bool VisionProcessor::frameChanged(const std::string &window_title, const std::string &application_name)
+{
+    if (capture_settings.change_threshold < 0 || !has_last_analysis || window_title != last_analysis.window_title ||
+        application_name != last_analysis.application_name)
+    {
+        return true;
+    }
+    return frameChangeFraction(gate_frame, analyzed_gate_frame) > capture_settings.change_threshold;
+}
+
+bool VisionProcessor::dirtyRegion(cv::Rect &region)
+{
+    if (gate_frame.empty() || gate_frame.size() != analyzed_gate_frame.size())
+    {
+        return false;
+    }
+    cv::Rect dirty;
+    try
+    {
+        changedPixelMask(gate_frame, analyzed_gate_frame, dirty_mask);
+        // Merge the glyphs of a word, or the items of a menu, into one component
+        cv::dilate(dirty_mask, dirty_mask, cv::Mat(), cv::Point(-1, -1), 2);
+        int components = cv::connectedComponentsWithStats(dirty_mask, dirty_labels, dirty_stats, dirty_centroids);
+        for (int i = 1; i < components; ++i) // 0 is the unchanged background
+        {
+            if (dirty_stats.at<int>(i, cv::CC_STAT_AREA) < kMinDirtyArea)
+            {
+                continue;
+            }
+            cv::Rect part(dirty_stats.at<int>(i, cv::CC_STAT_LEFT), dirty_stats.at<int>(i, cv::CC_STAT_TOP),
+                          dirty_stats.at<int>(i, cv::CC_STAT_WIDTH), dirty_stats.at<int>(i, cv::CC_STAT_HEIGHT));
+            dirty = dirty.empty() ? part : (dirty | part);
+        }
+    }
+    catch (const cv::Exception &ex)
+    {
+        std::cerr << "❌ OpenCV exception while finding the changed region: " << ex.what() << std::endl;
+        return false;
+    }
+    if (dirty.empty())
+    {
+        return false;
+    }
+
+    double scale_x = static_cast<double>(frame.cols) / gate_frame.cols;
+    double scale_y = static_cast<double>(frame.rows) / gate_frame.rows;
+    int margin = std::max(0, capture_settings.crop_margin);
+    int left = static_cast<int>(std::floor(dirty.x * scale_x)) - margin;
+    int top = static_cast<int>(std::floor(dirty.y * scale_y)) - margin;
+    int right = static_cast<int>(std::ceil((dirty.x + dirty.width) * scale_x)) + margin;
+    int bottom = static_cast<int>(std::ceil((dirty.y + dirty.height) * scale_y)) + margin;
+    cv::Rect screen_region = cv::Rect(left, top, right - left, bottom - top) & cv::Rect(0, 0, frame.cols, frame.rows);
+    if (screen_region.empty() || screen_region.area() > capture_settings.max_crop_fraction * frame.cols * frame.rows)
+    {
+        return false;
+    }
+    region = screen_region;
+    return true;
+}
+
+json VisionProcessor::getAnalysisStats() const
+{
+    return {{"model_calls", model_analyses}, {"reused", reused_analyses}, {"cached", cached_analyses}, {"cropped", cropped_analyses}};
+}
+
 std::vector<UIElement> VisionProcessor::detectUIElements(const std::string &image_path)
 {
     std::cout << "INFO: VisionProcessor::detectUIElements - UI element detection is now primarily handled by the Qwen model via analyzeImageWithQwen." << std::endl;
@@ -294,10 +456,17 @@ std::vector<UIElement> VisionProcessor::detectUIElements(const std::string &imag
 
 void VisionProcessor::addCommonWindowsElements(std::vector<UIElement> &elements)
 {
+#ifdef _WIN32
+    int screen_width = GetSystemMetrics(SM_CXSCREEN);
+    int screen_height = GetSystemMetrics(SM_CYSCREEN);
+#else
+    int screen_width = frame.cols; // The last captured frame stands in for the screen
+    int screen_height = frame.rows;
+#endif
     // Add Start button (bottom-left corner)
     UIElement start_button;
     start_button.x = 0;
-    start_button.y = GetSystemMetrics(SM_CYSCREEN) - 40;
+    start_button.y = screen_height - 40;
     start_button.width = 50;
     start_button.height = 40;
     start_button.type = "button";
@@ -310,7 +479,7 @@ void VisionProcessor::addCommonWindowsElements(std::vector<UIElement> &elements)
     // Add Search box (next to start button)
     UIElement search_box;
     search_box.x = 60;
-    search_box.y = GetSystemMetrics(SM_CYSCREEN) - 35;
+    search_box.y = screen_height - 35;
     search_box.width = 300;
     search_box.height = 30;
     search_box.type = "text_field";
@@ -323,8 +492,8 @@ void VisionProcessor::addCommonWindowsElements(std::vector<UIElement> &elements)
     // Add entire taskbar
     UIElement taskbar;
     taskbar.x = 0;
-    taskbar.y = GetSystemMetrics(SM_CYSCREEN) - 40;
-    taskbar.width = GetSystemMetrics(SM_CXSCREEN);
+    taskbar.y = screen_height - 40;
+    taskbar.width = screen_width;
     taskbar.height = 40;
     taskbar.type = "container";
     taskbar.text = "Taskbar";
@@ -374,6 +543,7 @@ UIElement VisionProcessor::findElementByType(const std::string &type, const Scre
     return empty_element;
 }
 
+#ifdef _WIN32
 bool VisionProcessor::clickElement(const UIElement &element)
 {
     if (element.confidence == 0.0)
@@ -484,55 +654,21 @@ bool VisionProcessor::typeAtElement(const UIElement &element, const std::string
     }
     return true;
 }
-
-HWND VisionProcessor::getActiveWindow()
+#else
+bool VisionProcessor::clickElement(const UIElement &)
 {
-    return GetForegroundWindow();
+    std::cerr << "❌ Clicking needs Windows input APIs" << std::endl;
+    return false;
 }
 
-std::string VisionProcessor::getWindowTitle(HWND window)
+bool VisionProcessor::typeAtElement(const UIElement &, const std::string &)
 {
-    if (!window)
-        return "";
-
-    char buffer[256];
-    GetWindowTextA(window, buffer, sizeof(buffer));
-    return std::string(buffer);
+    std::cerr << "❌ Typing needs Windows input APIs" << std::endl;
+    return false;
 }
+#endif
 
-std::string VisionProcessor::getApplicationName(HWND window)
-{
-    if (!window)
-        return "";
-
-    DWORD processId;
-    GetWindowThreadProcessId(window, &processId);
-
-    HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, processId);
-    if (hProcess)
-    {
-        char buffer[MAX_PATH];
-        DWORD bufferSize = MAX_PATH;
-        if (QueryFullProcessImageNameA(hProcess, 0, buffer, &bufferSize))
-        {
-            std::string fullPath(buffer);
-            // Extract just the filename
-            size_t lastSlash = fullPath.find_last_of("\\/");
-            if (lastSlash != std::string::npos)
-            {
-                CloseHandle(hProcess);
-                return fullPath.substr(lastSlash + 1);
-            }
-            CloseHandle(hProcess);
-            return fullPath;
-        }
-        CloseHandle(hProcess);
-    }
-
-    return "Unknown";
-}
-
-std::string VisionProcessor::generateScreenDescription(const ScreenAnalysis &analysis)
+std::string VisionProcessor::generateScreenDescription(const ScreenAnalysis &analysis, const std::string &task)
 {
     std::stringstream description;
 
@@ -541,22 +677,14 @@ std::string VisionProcessor::generateScreenDescription(const ScreenAnalysis &ana
     description << "Window Title: " << analysis.window_title << "\n";
     description << "UI Elements Found: " << analysis.elements.size() << "\n\n";
 
+    // Without a task only the element kind orders them (controls before labels)
+    std::vector<size_t> ranked = rankElements(analysis.elements, task, {}, kDescriptionElements);
     description << "Detected Elements:\n";
-    for (size_t i = 0; i < analysis.elements.size() && i < 10; ++i)
-    {
-        const auto &element = analysis.elements[i];
-        description << "- " << element.type << " at (" << element.x << "," << element.y
-                    << ") size " << element.width << "x" << element.height;
-        if (!element.text.empty())
-        {
-            description << " text: \"" << element.text << "\"";
-        }
-        description << "\n";
-    }
+    description << renderElementTable(analysis.elements, ranked, true);
 
-    if (analysis.elements.size() > 10)
+    if (analysis.elements.size() > ranked.size())
     {
-        description << "... and " << (analysis.elements.size() - 10) << " more elements\n";
+        description << "... and " << (analysis.elements.size() - ranked.size()) << " more elements\n";
     }
 
     return description.str();
@@ -568,6 +696,49 @@ void VisionProcessor::setTempDirectory(const std::string &path)
     std::filesystem::create_directories(temp_directory);
 }
 
+bool applyScreenshotQuality(const std::string &preset, VisionCaptureSettings &settings)
+{
+    if (preset == "high") // Lossless at screen size
+    {
+        settings.format = "png";
+        settings.max_long_edge = 0;
+    }
+    else if (preset == "medium")
+    {
+        settings.format = "jpeg";
+        settings.quality = 85;
+        settings.max_long_edge = 1600;
+    }
+    else if (preset == "low")
+    {
+        settings.format = "jpeg";
+        settings.quality = 75;
+        settings.max_long_edge = 1280;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+void VisionProcessor::setCaptureSettings(const VisionCaptureSettings &settings)
+{
+    if (!screen_source || settings.screen_source != capture_settings.screen_source)
+    {
+        if (settings.screen_source.empty())
+        {
+            screen_source = std::make_unique<DesktopScreenSource>();
+        }
+        else
+        {
+            screen_source = std::make_unique<FileScreenSource>(settings.screen_source);
+            std::cout << "🖼️ Vision frames come from " << screen_source->describe() << std::endl;
+        }
+    }
+    capture_settings = settings;
+}
+
 bool VisionProcessor::isOpenCVAvailable() const
 {
     return opencv_available;
@@ -606,46 +777,28 @@ std::vector<UIElement> VisionProcessor::findElementsContaining(const std::string
 // Removed compareScreenshots - unused
 // Removed createElementsJson - unused
 
-ScreenAnalysis VisionProcessor::analyzeImageWithQwen(const std::string& image_path) {
+ScreenAnalysis VisionProcessor::analyzeImageWithQwen(EncodedFrame image) {
     ScreenAnalysis analysis;
     analysis.overall_description = "Failed to analyze image with Qwen."; // Default error message
-    CURL* curl;
-    CURLcode res;
-    std::string readBuffer;
 
     // Get API Key from environment variable
+    // (not needed when screen analysis is routed to a local backend)
     const char* api_key_env = std::getenv("OPENROUTER_API_KEY");
-    if (!api_key_env) {
+    if (!api_key_env && !LLMBackendRouter::instance().isRouted(LLMCallType::SCREEN_ANALYSIS)) {
         std::cerr << "Error: OPENROUTER_API_KEY environment variable not set." << std::endl;
         analysis.overall_description = "Error: OPENROUTER_API_KEY not set.";
         return analysis;
     }
-    std::string api_key = api_key_env;
+    std::string api_key = api_key_env ? api_key_env : "";
 
-    std::string base64_image = base64_encode(image_path);
-    if (base64_image.empty()) {
+    if (!image.bytes || image.bytes->empty()) {
+        std::cerr << "Error: no encoded image to send for analysis" << std::endl;
         analysis.overall_description = "Error: Failed to encode image to base64.";
         return analysis;
     }
 
-    // Determine image type from path (simple check)
-    std::string image_type = "image/png"; // Default
-    if (image_path.size() > 4) {
-        std::string ext = image_path.substr(image_path.size() - 4);
-        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower); // Convert extension to lowercase
-        if (ext == ".jpg" || ext == "jpeg") image_type = "image/jpeg";
-        else if (ext == ".bmp") image_type = "image/bmp";
-        // Add more types if necessary, e.g., gif, webp
-    }
-
-    std::string image_data_url = "data:" + image_type + ";base64," + base64_image;
-
-    curl_global_init(CURL_GLOBAL_ALL); // Should ideally be called once per program
-    curl = curl_easy_init();
-
-    if (curl) {
+    {
         std::string url = "https://openrouter.ai/api/v1/chat/completions";
-
         // Construct JSON payload
         json payload = {
             {"model", "qwen/qwen2.5-vl-32b-instruct:free"}, // Corrected model name
@@ -653,7 +806,7 @@ ScreenAnalysis VisionProcessor::analyzeImageWithQwen(const std::string& image_pa
                 {
                     {"role", "user"},
                     {"content", json::array({
-                        {{"type", "text"}, {"text", R"(Describe this image.
+                        {{"type", "text"}, {"text", "The image is " + std::to_string(image.width) + "x" + std::to_string(image.height) + " pixels" + (image.cropped ? ", a part of a larger screen; give coordinates within this image. " : ". ") + R"(Describe this image.
 In addition, identify all significant UI elements visible in the image, such as buttons, input fields, text areas, labels, and icons.
 For each element, provide its type (e.g., "button", "input_field", "text", "icon"), the text it contains (if any), and its bounding box coordinates.
 The bounding box should be an array of four integers: [x_min, y_min, x_max, y_max], representing the pixel coordinates of the top-left and bottom-right corners of the element.
@@ -669,181 +822,152 @@ If no specific UI elements are identifiable, provide an empty array:
 ELEMENTS_JSON_START
 []
 ELEMENTS_JSON_END)"}},
-                        {{"type": "image_url"}, {"image_url", {{"url", image_data_url}}}}
+                        {{"type", "image_url"}, {"image_url", {{"url", kImageUrlPlaceholder}}}}
                     })}
                 }
             })},
             {"max_tokens", 1024} // Optional: limit response size
         };
-        std::string json_payload_str = payload.dump();
-
-        struct curl_slist* headers = NULL;
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        std::string auth_header = "Authorization: Bearer " + api_key;
-        headers = curl_slist_append(headers, auth_header.c_str());
-        // headers = curl_slist_append(headers, "HTTP-Referer: your-app-url"); // Optional: Recommended by OpenRouter
-        // headers = curl_slist_append(headers, "X-Title: Your App Name"); // Optional: Recommended by OpenRouter
-
 
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_payload_str.c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, 30000L); // 30 seconds
-        // curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L); // Enable for debugging cURL verbosity
-
-        res = curl_easy_perform(curl);
-
-        if (res != CURLE_OK) {
-            std::cerr << "curl_easy_perform() failed: " << curl_easy_strerror(res) << std::endl;
-            analysis.overall_description = std::string("Qwen API call failed: ") + curl_easy_strerror(res);
+        // Only the small envelope is serialized; the encoded frame is base64-encoded from memory while uploading
+        LLMRequest request;
+        request.url = url;
+        request.api_key = api_key;
+        request.call_type = LLMCallType::SCREEN_ANALYSIS; // Deadline and retries come from its call policy
+        LLMBackendRouter::instance().apply(payload, request);
+        buildStreamedBody(payload.dump(), kImageUrlPlaceholder, "data:" + image.mime_type + ";base64,",
+                          LLMBodySegment::fromBuffer(std::move(image.bytes)), request.body_segments);
+
+        LLMResponse llm_response = LLMBackendRouter::instance().perform(std::move(request));
+        const std::string &readBuffer = llm_response.body;
+
+        if (!llm_response.transport_ok) {
+            std::cerr << "Qwen API request failed: " << llm_response.error << std::endl;
+            analysis.overall_description = "Qwen API call failed: " + llm_response.error;
         } else {
-            long http_code = 0;
-            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+            long http_code = llm_response.http_status;
             std::cout << "Qwen API HTTP Response Code: " << http_code << std::endl;
             // std::cout << "Qwen API Response: " << readBuffer << std::endl; // For debugging
 
-            if (http_code == 200) {
-                try {
-                    json response_json = json::parse(readBuffer);
-                    if (response_json.contains("choices") && response_json["choices"].is_array() && !response_json["choices"].empty()) {
-                        const auto& first_choice = response_json["choices"][0];
-                        if (first_choice.contains("message") && first_choice["message"].contains("content")) {
-                            // Qwen-VL models typically return content as a string directly
-                            const auto& content = first_choice["message"]["content"];
-                            std::string full_response_text;
-
-                            if (content.is_string()) {
-                                full_response_text = content.get<std::string>();
-                            }
-                            // Handling for older/different Qwen models that might return content as an array
-                            else if (content.is_array() && !content.empty() && content[0].is_object() && content[0].contains("text")) {
-                                full_response_text = content[0]["text"].get<std::string>();
-                            } else {
-                                analysis.overall_description = "Qwen response format error: Could not extract text from content.";
-                                std::cerr << "Qwen response format error: 'content' is not a direct string or an array with text." << std::endl;
-                                std::cerr << "Content received: " << content.dump(2) << std::endl;
-                                // Early exit or skip UI element parsing if content structure is wrong
-                            }
+            // Only the content and error message are pulled out of the body; no json DOM is built
+            CompletionResult completion;
+            bool parsed = parseCompletion(readBuffer, completion);
+            if (http_code != 200) {
+                std::cerr << "Qwen API returned HTTP " << http_code << std::endl;
+                std::cerr << "Response (" << readBuffer.size() << " bytes): " << utf8Prefix(readBuffer, kLogPreviewChars)
+                          << (readBuffer.size() > kLogPreviewChars ? "..." : "") << std::endl;
+                analysis.overall_description = "Qwen API Error: HTTP " + std::to_string(http_code);
+                if (parsed && !completion.error_message.empty()) {
+                    analysis.overall_description += ": " + completion.error_message;
+                }
+            } else if (!parsed) {
+                std::cerr << "Failed to parse the Qwen API response (" << readBuffer.size() << " bytes)" << std::endl;
+                analysis.overall_description = "Failed to parse Qwen API response.";
+            } else if (!completion.has_content) {
+                if (!completion.error_message.empty()) {
+                    std::cerr << "Qwen API Error: " << completion.error_message << std::endl;
+                    analysis.overall_description = "Qwen API Error: " + completion.error_message;
+                } else {
+                    std::cerr << "Qwen response format error: 'message' or 'content' field missing in choice." << std::endl;
+                    analysis.overall_description = "Qwen response format error: 'message' or 'content' field missing.";
+                }
+            } else {
+                if (LLMBackendRouter::instance().profileFor(LLMCallType::SCREEN_ANALYSIS).strip_reasoning) {
+                    stripReasoningBlocks(completion.content); // <think> blocks would be taken for the description
+                }
+                const std::string &full_response_text = completion.content;
+                if (!full_response_text.empty()) {
+                    analysis.metadata["answered"] = true;
+                    const std::string elements_json_start_marker = "ELEMENTS_JSON_START";
+                    const std::string elements_json_end_marker = "ELEMENTS_JSON_END";
+
+                    size_t json_block_start_pos = full_response_text.find(elements_json_start_marker);
+                    size_t json_block_end_pos = full_response_text.find(elements_json_end_marker);
+
+                    // A reply cut off by max_tokens has no end marker; keep whatever elements arrived in full
+                    if (json_block_start_pos != std::string::npos && json_block_end_pos == std::string::npos) {
+                        std::cerr << "⚠️ ELEMENTS_JSON_END missing (response truncated?), recovering the elements block" << std::endl;
+                        json_block_end_pos = full_response_text.size();
+                    }
 
-                            if (!full_response_text.empty()) {
-                                const std::string elements_json_start_marker = "ELEMENTS_JSON_START";
-                                const std::string elements_json_end_marker = "ELEMENTS_JSON_END";
+                    if (json_block_start_pos != std::string::npos && json_block_end_pos != std::string::npos && json_block_start_pos < json_block_end_pos) {
+                        analysis.overall_description = full_response_text.substr(0, json_block_start_pos);
+                        // Trim whitespace (simple trim for trailing newlines/spaces before marker)
+                        size_t last_char = analysis.overall_description.find_last_not_of(" \n\r\t");
+                        if (std::string::npos != last_char) {
+                            analysis.overall_description.erase(last_char + 1);
+                        }
 
-                                size_t json_block_start_pos = full_response_text.find(elements_json_start_marker);
-                                size_t json_block_end_pos = full_response_text.find(elements_json_end_marker);
+                        size_t actual_json_start = json_block_start_pos + elements_json_start_marker.length();
+                        std::string json_str_block = full_response_text.substr(actual_json_start, json_block_end_pos - actual_json_start);
 
-                                if (json_block_start_pos != std::string::npos && json_block_end_pos != std::string::npos && json_block_start_pos < json_block_end_pos) {
-                                    analysis.overall_description = full_response_text.substr(0, json_block_start_pos);
-                                    // Trim whitespace (simple trim for trailing newlines/spaces before marker)
-                                    size_t last_char = analysis.overall_description.find_last_not_of(" \n\r\t");
-                                    if (std::string::npos != last_char) {
-                                        analysis.overall_description.erase(last_char + 1);
-                                    }
+                        std::string repaired_block;
+                        bool truncated_block = false;
+                        if (!json::accept(json_str_block) && repairJson(json_str_block, repaired_block, &truncated_block)) {
+                            std::cout << "🩹 Repaired malformed UI elements JSON" << (truncated_block ? " (truncated)" : "") << std::endl;
+                            json_str_block = repaired_block;
+                            LLMMetrics::instance().recordJsonRepair(LLMCallType::SCREEN_ANALYSIS);
+                        }
 
-                                    size_t actual_json_start = json_block_start_pos + elements_json_start_marker.length();
-                                    std::string json_str_block = full_response_text.substr(actual_json_start, json_block_end_pos - actual_json_start);
-
-                                    try {
-                                        json parsed_elements_json = json::parse(json_str_block);
-                                        if (parsed_elements_json.is_array()) {
-                                            for (const auto& elem_item : parsed_elements_json) {
-                                                UIElement ui_el;
-                                                ui_el.type = elem_item.value("type", "unknown");
-                                                ui_el.text = elem_item.value("text", "");
-                                                // Description for individual elements could be added if model provides it
-                                                // ui_el.description = elem_item.value("description", "");
-
-                                                if (elem_item.contains("bbox") && elem_item["bbox"].is_array() && elem_item["bbox"].size() == 4) {
-                                                    const auto& bbox_arr = elem_item["bbox"];
-                                                    try {
-                                                        int x_min = bbox_arr[0].get<int>();
-                                                        int y_min = bbox_arr[1].get<int>();
-                                                        int x_max = bbox_arr[2].get<int>();
-                                                        int y_max = bbox_arr[3].get<int>();
-
-                                                        ui_el.x = x_min;
-                                                        ui_el.y = y_min;
-                                                        ui_el.width = x_max - x_min;
-                                                        ui_el.height = y_max - y_min;
-                                                        ui_el.confidence = 0.9; // Default confidence for Qwen identified elements
-
-                                                        if (ui_el.width < 0) ui_el.width = 0;
-                                                        if (ui_el.height < 0) ui_el.height = 0;
-
-                                                        analysis.elements.push_back(ui_el);
-                                                    } catch (const json::type_error& te) {
-                                                        std::cerr << "Error parsing bbox array element: " << te.what()
-                                                                  << " for element: " << elem_item.dump(2) << std::endl;
-                                                    }
-                                                } else {
-                                                    std::cerr << "Warning: UI element missing valid bbox: " << elem_item.dump(2) << std::endl;
-                                                }
-                                            }
-                                        } else {
-                                             std::cerr << "Error: ELEMENTS_JSON_START/END block found, but content is not a JSON array. Content: " << json_str_block << std::endl;
-                                             // Fallback: use the text before the block as description.
-                                             // analysis.overall_description is already set to this.
+                        try {
+                            json parsed_elements_json = json::parse(json_str_block);
+                            if (parsed_elements_json.is_array()) {
+                                for (const auto& elem_item : parsed_elements_json) {
+                                    UIElement ui_el;
+                                    ui_el.type = elem_item.value("type", "unknown");
+                                    ui_el.text = elem_item.value("text", "");
+                                    // Description for individual elements could be added if model provides it
+                                    // ui_el.description = elem_item.value("description", "");
+
+                                    if (elem_item.contains("bbox") && elem_item["bbox"].is_array() && elem_item["bbox"].size() == 4) {
+                                        const auto& bbox_arr = elem_item["bbox"];
+                                        try {
+                                            int x_min = bbox_arr[0].get<int>();
+                                            int y_min = bbox_arr[1].get<int>();
+                                            int x_max = bbox_arr[2].get<int>();
+                                            int y_max = bbox_arr[3].get<int>();
+
+                                            // From encoded-image pixels back to screen pixels
+                                            ui_el.x = image.offset_x + static_cast<int>(std::lround(x_min / image.scale_x));
+                                            ui_el.y = image.offset_y + static_cast<int>(std::lround(y_min / image.scale_y));
+                                            ui_el.width = image.offset_x + static_cast<int>(std::lround(x_max / image.scale_x)) - ui_el.x;
+                                            ui_el.height = image.offset_y + static_cast<int>(std::lround(y_max / image.scale_y)) - ui_el.y;
+                                            ui_el.confidence = 0.9; // Default confidence for Qwen identified elements
+
+                                            if (ui_el.width < 0) ui_el.width = 0;
+                                            if (ui_el.height < 0) ui_el.height = 0;
+
+                                            analysis.elements.push_back(ui_el);
+                                        } catch (const json::type_error& te) {
+                                            std::cerr << "Error parsing bbox array element: " << te.what()
+                                                      << " for element: " << elem_item.dump(2) << std::endl;
                                         }
-                                    } catch (const json::parse_error& e) {
-                                        std::cerr << "Error parsing UI elements JSON block: " << e.what() << ". Block content: " << json_str_block << std::endl;
-                                        // Fallback: use the text before the block as description.
-                                        // analysis.overall_description is already set to this part.
-                                        // If we prefer the full text in this case:
-                                        // analysis.overall_description = full_response_text;
+                                    } else {
+                                        std::cerr << "Warning: UI element missing valid bbox: " << elem_item.dump(2) << std::endl;
                                     }
-                                } else {
-                                    // Markers not found, or in wrong order, treat the whole response as description
-                                    analysis.overall_description = full_response_text;
                                 }
-                            } else if (analysis.overall_description.empty()) {
-                                // This case means full_response_text was empty and overall_description wasn't set by an error message already.
-                                analysis.overall_description = "Qwen response format error: Content was empty or in unexpected format.";
-                                std::cerr << "Qwen response format error: Content was empty or in unexpected format after checking string/array." << std::endl;
-                            }
-                            // If full_response_text is empty but analysis.overall_description was set by "Could not extract text from content", it will retain that error message.
-
-                        } else {
-                            analysis.overall_description = "Qwen response format error: 'message' or 'content' field missing.";
-                            std::cerr << "Qwen response format error: 'message' or 'content' field missing in choice." << std::endl;
-                        }
-                    } else {
-                        analysis.overall_description = "Qwen response format error: 'choices' array missing or empty.";
-                        std::cerr << "Qwen response format error: 'choices' array missing or empty in response." << std::endl;
-                        if(response_json.contains("error")) {
-                            std::cerr << "Qwen API Error: " << response_json["error"].dump(2) << std::endl;
-                            if (response_json["error"].contains("message")) {
-                                analysis.overall_description = "Qwen API Error: " + response_json["error"]["message"].get<std::string>();
                             } else {
-                                analysis.overall_description = "Qwen API Error: Unknown error structure.";
+                                 std::cerr << "Error: ELEMENTS_JSON_START/END block found, but content is not a JSON array. Content: " << json_str_block << std::endl;
+                                 // Fallback: use the text before the block as description.
+                                 // analysis.overall_description is already set to this.
                             }
+                        } catch (const json::parse_error& e) {
+                            std::cerr << "Error parsing UI elements JSON block: " << e.what() << ". Block content: " << json_str_block << std::endl;
+                            // Fallback: use the text before the block as description.
+                            // analysis.overall_description is already set to this part.
+                            // If we prefer the full text in this case:
+                            // analysis.overall_description = full_response_text;
                         }
+                    } else {
+                        // Markers not found, or in wrong order, treat the whole response as description
+                        analysis.overall_description = full_response_text;
                     }
-                } catch (const json::parse_error& e) {
-                    std::cerr << "JSON parsing error: " << e.what() << std::endl;
-                    analysis.overall_description = "Failed to parse Qwen API response.";
-                }
-            } else {
-                std::cerr << "Qwen API returned HTTP " << http_code << std::endl;
-                std::cerr << "Response: " << readBuffer << std::endl;
-                analysis.overall_description = "Qwen API Error: HTTP " + std::to_string(http_code);
-                 try {
-                    json error_json = json::parse(readBuffer);
-                    if(error_json.contains("error") && error_json["error"].contains("message")) {
-                        analysis.overall_description += ": " + error_json["error"]["message"].get<std::string>();
-                    }
-                } catch (const json::parse_error& e) {
-                    // Ignore if parsing error message fails, keep the HTTP code message
+                } else {
+                    analysis.overall_description = "Qwen response format error: Content was empty.";
+                    std::cerr << "Qwen response format error: Content was empty." << std::endl;
                 }
             }
         }
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
-    } else {
-        std::cerr << "curl_easy_init() failed." << std::endl;
-        analysis.overall_description = "Failed to initialize cURL for Qwen API.";
     }
-    curl_global_cleanup(); // Should ideally be called once per program
     return analysis;
 }
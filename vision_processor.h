@@ -2,38 +2,55 @@
 #define VISION_PROCESSOR_H
 
 #include "include/json.hpp"
+#include "screen_analysis.h"
+#include "screen_source.h"
+#include <opencv2/core.hpp>
 #include <string>
 #include <vector>
 #include <memory>
-
-#ifndef WIN32_LEAN_AND_MEAN
-#define WIN32_LEAN_AND_MEAN
-#endif
-#ifndef _WINSOCKAPI_
-#define _WINSOCKAPI_ // Prevent inclusion of winsock.h
-#endif
-#include <windows.h>
+#include <future>
 
 using json = nlohmann::json;
 
-struct UIElement
+// How frames are captured, encoded for the vision model and kept (config: image_settings)
+struct VisionCaptureSettings
 {
-    int x, y, width, height;
-    std::string type;        // button, text_field, image, label, etc.
-    std::string text;        // OCR extracted text
-    std::string description; // AI generated description
-    double confidence;       // Detection confidence
-    std::string id;          // Unique identifier
+    std::string screen_source;     // Empty: the desktop. Otherwise a screenshot file or directory played back instead
+    bool save_screenshots = false; // Also write each analyzed frame to the temp directory, in the background
+    std::string format = "png";    // Upload encoding: "png", "jpeg" or "webp"
+    int quality = 85;              // JPEG/WebP quality, 1-100
+    int png_compression = -1;      // zlib level for PNG, 0-9; -1 keeps OpenCV's default, its fastest setting
+    int max_long_edge = 0;         // Downscale so the longer side is at most this many pixels; 0 keeps the screen size
+    // Fraction of pixels (of a 480-pixel-wide grayscale copy) that must change before
+    // a frame is analyzed again; otherwise the last analysis is reused. Negative
+    // analyzes every frame.
+    double change_threshold = 0.0001;
+    // When only part of the window changed since the last analysis, send just
+    // that part (plus crop_margin pixels around it) and merge the result in.
+    // Falls back to the whole frame when the part exceeds max_crop_fraction.
+    bool crop_changes = true;
+    int crop_margin = 32;
+    double max_crop_fraction = 0.5;
 };
 
-struct ScreenAnalysis
+// Sets format, quality and max_long_edge from a screenshot_quality preset
+// ("high", "medium" or "low"). Returns false for an unknown name.
+bool applyScreenshotQuality(const std::string &preset, VisionCaptureSettings &settings);
+
+// One frame as sent to the vision model
+struct EncodedFrame
 {
-    std::string screenshot_path;
-    std::vector<UIElement> elements;
-    std::string overall_description;
-    std::string window_title;
-    std::string application_name;
-    json metadata;
+    std::shared_ptr<const std::vector<unsigned char>> bytes;
+    std::string mime_type;
+    std::string extension; // For saved copies, e.g. ".jpg"
+    int width = 0;         // Size of the encoded image; bboxes the model returns are in these pixels
+    int height = 0;
+    int offset_x = 0; // Screen position of the encoded region's top-left corner
+    int offset_y = 0;
+    double scale_x = 1.0; // Encoded size over region size
+    double scale_y = 1.0;
+    double encode_ms = 0.0; // Color conversion, resize and compression
+    bool cropped = false;   // Only part of the screen
 };
 
 class VisionProcessor
@@ -41,9 +58,52 @@ class VisionProcessor
 private:
     std::string temp_directory;
     bool opencv_available;
+    VisionCaptureSettings capture_settings;
+    std::unique_ptr<ScreenSource> screen_source;
+
+    // Frames never touch the disk on their way to the model: each capture lands
+    // in frame, is converted to BGR and scaled into upload_frame, and is encoded
+    // in memory into encoded_frame, which the upload streams from. All three
+    // buffers are reused from one step to the next.
+    cv::Mat frame;
+    cv::Mat bgr_frame;
+    cv::Mat upload_frame;
+    std::shared_ptr<std::vector<unsigned char>> encoded_frame; // Shared with an upload or a background save while in use
+    std::future<void> pending_save;                             // At most one background write at a time
+
+    // Frame-difference gate: the last answered analysis and a small grayscale
+    // copy of the frame it was made from
+    ScreenAnalysis last_analysis;
+    bool has_last_analysis = false;
+    std::string full_description; // From the last analysis of the whole frame; crops only add to it
+    cv::Mat analyzed_gate_frame;
+    cv::Mat gate_gray;
+    cv::Mat gate_frame; // The current frame, grayscale and 480 pixels wide
+    cv::Mat dirty_mask;
+    cv::Mat dirty_labels;
+    cv::Mat dirty_stats;
+    cv::Mat dirty_centroids;
+    int model_analyses = 0;
+    int reused_analyses = 0;
+    int cached_analyses = 0;  // Answered from ScreenAnalysisCache
+    int cropped_analyses = 0; // Model calls that sent only the changed region
+
+    ScreenSource &screenSource(); // The desktop unless capture_settings name files
+    bool captureFrame();
+    // Encodes region of the current frame as capture_settings say; false if encoding failed
+    bool encodeFrame(EncodedFrame &encoded, const cv::Rect &region);
+    bool makeGateFrame();
+    // False when gate_frame and the window match the last analysis closely enough to reuse it
+    bool frameChanged(const std::string &window_title, const std::string &application_name);
+    // Screen rectangle around everything that changed since the last analysis, margin included;
+    // false when there is no usable previous frame or the change is too large to be worth cropping
+    bool dirtyRegion(cv::Rect &region);
+    // Writes encoded bytes under temp_directory on a background thread; returns the file name
+    std::string saveFrameAsync(std::shared_ptr<const std::vector<unsigned char>> image, const std::string &extension);
+    std::string newScreenshotPath(const std::string &extension) const;
 
     // Screen capture methods
-    std::string captureScreenshot(); // Retained
+    std::string captureScreenshot(); // Captures and writes the encoded frame synchronously (explicit saves only)
     // std::string captureWindowScreenshot(HWND window); // Removed - unused
     // Image processing methods
     std::vector<UIElement> detectUIElements(const std::string &image_path); // Retained
@@ -57,12 +117,8 @@ private:
     //                                            const std::string &template_path,
     //                                            double threshold = 0.8);
 
-    // Windows API helpers
-    HWND getActiveWindow(); // Retained
-    std::string getWindowTitle(HWND window);
-    std::string getApplicationName(HWND window);
-
-    ScreenAnalysis analyzeImageWithQwen(const std::string& image_path);
+    // Element bboxes are mapped from the encoded image back to screen pixels
+    ScreenAnalysis analyzeImageWithQwen(EncodedFrame image);
 
 public:
     VisionProcessor();
@@ -70,8 +126,10 @@ public:
 
     // Main analysis methods
     ScreenAnalysis analyzeCurrentScreen();
-    ScreenAnalysis analyzeWindow(HWND window);
     ScreenAnalysis analyzeScreenshot(const std::string &image_path);
+    // {"model_calls": analyses sent to the model, "reused": skipped because the screen had not changed,
+    //  "cached": answered from the screen cache, "cropped": model calls that sent only the changed region}
+    json getAnalysisStats() const;
 
     // Element finding methods
     UIElement findElementByText(const std::string &text, const ScreenAnalysis &analysis);
@@ -88,11 +146,13 @@ public:
     // bool compareScreenshots(const std::string &before, const std::string &after, double threshold = 0.95); // Removed - unused
 
     // Description generation for Gemini
-    std::string generateScreenDescription(const ScreenAnalysis &analysis); // Retained
+    // Element table ranked by relevance to task when one is given (see element_table.h)
+    std::string generateScreenDescription(const ScreenAnalysis &analysis, const std::string &task = ""); // Retained
     // json createElementsJson(const std::vector<UIElement> &elements); // Removed - unused
 
     // Configuration
     void setTempDirectory(const std::string &path); // Retained
+    void setCaptureSettings(const VisionCaptureSettings &settings);
     void enableOpenCV(bool enable);
     bool isOpenCVAvailable() const;
 };